@@ -0,0 +1,278 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: audit.c
+ *
+ * Paper root audit report implementation.
+ */
+
+/* ANSI C header files */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/* OSLib header files */
+
+#include "oslib/osfile.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/msgs.h"
+#include "sflib/string.h"
+
+/* Application header files */
+
+#include "audit.h"
+
+#include "fields.h"
+#include "paper.h"
+
+/**
+ * The length of the buffer used to build report lines.
+ */
+
+#define AUDIT_LINE_LEN 256
+
+/**
+ * The length of the buffers used to format numbers.
+ */
+
+#define AUDIT_NUMBER_LEN 16
+
+/**
+ * The snippet and size counts for a root.
+ */
+
+struct audit_counts {
+	unsigned		correct;			/**< The number of correct snippets.				*/
+	unsigned		incorrect;			/**< The number of incorrect snippets.				*/
+	unsigned		missing;			/**< The number of missing snippets.				*/
+	unsigned		unknown;			/**< The number of unrecognised snippets.			*/
+	unsigned		ambiguous;			/**< The number of ambiguous paper sizes.			*/
+	unsigned		orphans;			/**< The number of orphaned snippet files.			*/
+};
+
+static void	audit_write_root(FILE *out, int root, struct audit_counts *counts, unsigned *files_read, unsigned *files_parsed);
+static void	audit_write_line(FILE *out, osbool indent, char *token, char *a, char *b, char *c, char *d);
+
+
+/**
+ * Write a text report on the state of each of the paper roots, as found
+ * by the last load, showing which roots share identical definition files.
+ *
+ * \param *filename		The name of the file to be written.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool audit_write_report(char *filename)
+{
+	FILE			*out;
+	struct audit_counts	*counts;
+	struct paper_size	*papers;
+	struct paper_orphan	*orphans;
+	size_t			root_count, paper_count, orphan_count, i, checked, parsed;
+	unsigned		files_read = 0, files_parsed = 0;
+	int			root;
+	char			number[4][AUDIT_NUMBER_LEN];
+	osbool			success;
+
+	root_count = paper_get_root_count();
+
+	counts = malloc(((root_count > 0) ? root_count : 1) * sizeof(struct audit_counts));
+	if (counts == NULL)
+		return FALSE;
+
+	memset(counts, 0, ((root_count > 0) ? root_count : 1) * sizeof(struct audit_counts));
+
+	/* Count up the snippet states for each root, in a single pass over the
+	 * definitions and the orphans.
+	 */
+
+	paper_count = paper_get_definition_count();
+	papers = paper_get_definitions();
+
+	for (i = 0; i < paper_count; i++) {
+		if (papers[i].root < 0 || papers[i].root >= root_count)
+			continue;
+
+		switch (papers[i].ps2_file_status) {
+		case PAPER_FILE_STATUS_CORRECT:
+			counts[papers[i].root].correct++;
+			break;
+		case PAPER_FILE_STATUS_INCORRECT:
+			counts[papers[i].root].incorrect++;
+			break;
+		case PAPER_FILE_STATUS_MISSING:
+			counts[papers[i].root].missing++;
+			break;
+		default:
+			counts[papers[i].root].unknown++;
+			break;
+		}
+
+		if (papers[i].size_status == PAPER_SIZE_STATUS_AMBIGUOUS)
+			counts[papers[i].root].ambiguous++;
+	}
+
+	orphan_count = paper_get_orphan_count();
+	orphans = paper_get_orphans();
+
+	for (i = 0; i < orphan_count; i++) {
+		if (orphans[i].root >= 0 && orphans[i].root < root_count)
+			counts[orphans[i].root].orphans++;
+	}
+
+	/* Write the report. */
+
+	out = fopen(filename, "w");
+	if (out == NULL) {
+		free(counts);
+		return FALSE;
+	}
+
+	audit_write_line(out, FALSE, "AuditTitle", NULL, NULL, NULL, NULL);
+
+	for (root = 0; root < root_count; root++)
+		audit_write_root(out, root, counts + root, &files_read, &files_parsed);
+
+	paper_get_snippet_statistics(&checked, &parsed);
+
+	fputc('\n', out);
+
+	string_printf(number[0], AUDIT_NUMBER_LEN, "%u", files_read);
+	string_printf(number[1], AUDIT_NUMBER_LEN, "%u", files_parsed);
+	string_printf(number[2], AUDIT_NUMBER_LEN, "%u", (unsigned) checked);
+	string_printf(number[3], AUDIT_NUMBER_LEN, "%u", (unsigned) parsed);
+
+	audit_write_line(out, FALSE, "AuditSummary", number[0], number[1], number[2], number[3]);
+
+	if (fields_get_rejected_count() > 0) {
+		string_printf(number[0], AUDIT_NUMBER_LEN, "%d", fields_get_rejected_count());
+		audit_write_line(out, FALSE, "AuditFields", number[0], NULL, NULL, NULL);
+	}
+
+	success = (ferror(out) == 0) ? TRUE : FALSE;
+
+	if (fclose(out) != 0)
+		success = FALSE;
+
+	free(counts);
+
+	osfile_set_type(filename, osfile_TYPE_TEXT);
+
+	return success;
+}
+
+
+/**
+ * Write the section of the report for a single root.
+ *
+ * \param *out			The file to write to.
+ * \param root			The index of the root.
+ * \param *counts		The snippet and size counts for the root.
+ * \param *files_read		Pointer to a count of source files read, to update.
+ * \param *files_parsed		Pointer to a count of source files parsed, to update.
+ */
+
+static void audit_write_root(FILE *out, int root, struct audit_counts *counts, unsigned *files_read, unsigned *files_parsed)
+{
+	struct paper_source_record	*record;
+	int				file, file_count;
+	char				number[4][AUDIT_NUMBER_LEN];
+
+	fputc('\n', out);
+	audit_write_line(out, FALSE, "AuditRoot", paper_get_root_name(root), NULL, NULL, NULL);
+
+	/* Report on each of the definition source files, pointing to the
+	 * root whose results were shared if the contents were identical.
+	 */
+
+	file_count = paper_get_source_file_count();
+
+	for (file = 0; file < file_count; file++) {
+		record = paper_get_source_record(root, file);
+
+		if (record == NULL || !record->present) {
+			audit_write_line(out, TRUE, "AuditMissing", paper_get_source_file_name(file), NULL, NULL, NULL);
+			continue;
+		}
+
+		(*files_read)++;
+
+		string_printf(number[0], AUDIT_NUMBER_LEN, "%d", record->size);
+		string_printf(number[1], AUDIT_NUMBER_LEN, "%08X", record->hash);
+		string_printf(number[2], AUDIT_NUMBER_LEN, "%u", (unsigned) record->definitions);
+
+		if (record->shared_root != -1) {
+			audit_write_line(out, TRUE, "AuditShared", paper_get_source_file_name(file), number[0], number[1],
+					paper_get_root_name(record->shared_root));
+		} else {
+			(*files_parsed)++;
+			audit_write_line(out, TRUE, "AuditFile", paper_get_source_file_name(file), number[0], number[1], number[2]);
+		}
+	}
+
+	/* Report on the snippets. */
+
+	string_printf(number[0], AUDIT_NUMBER_LEN, "%u", counts->correct);
+	string_printf(number[1], AUDIT_NUMBER_LEN, "%u", counts->incorrect);
+	string_printf(number[2], AUDIT_NUMBER_LEN, "%u", counts->missing);
+	string_printf(number[3], AUDIT_NUMBER_LEN, "%u", counts->unknown);
+
+	audit_write_line(out, TRUE, "AuditSnippets", number[0], number[1], number[2], number[3]);
+
+	string_printf(number[0], AUDIT_NUMBER_LEN, "%u", counts->ambiguous);
+	string_printf(number[1], AUDIT_NUMBER_LEN, "%u", counts->orphans);
+
+	audit_write_line(out, TRUE, "AuditOther", number[0], number[1], NULL, NULL);
+}
+
+
+/**
+ * Look up a report line from the messages file and write it out.
+ *
+ * \param *out			The file to write to.
+ * \param indent		TRUE to indent the line; FALSE to start at the margin.
+ * \param *token		The token for the line.
+ * \param *a			The first parameter, or NULL.
+ * \param *b			The second parameter, or NULL.
+ * \param *c			The third parameter, or NULL.
+ * \param *d			The fourth parameter, or NULL.
+ */
+
+static void audit_write_line(FILE *out, osbool indent, char *token, char *a, char *b, char *c, char *d)
+{
+	char	line[AUDIT_LINE_LEN];
+
+	msgs_param_lookup(token, line, AUDIT_LINE_LEN, a, b, c, d);
+	line[AUDIT_LINE_LEN - 1] = '\0';
+
+	if (indent)
+		fputs("  ", out);
+
+	fputs(line, out);
+	fputc('\n', out);
+}
@@ -0,0 +1,46 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: audit.h
+ *
+ * Paper root audit report interface.
+ */
+
+#ifndef PS2PAPER_AUDIT
+#define PS2PAPER_AUDIT
+
+#include "oslib/types.h"
+
+
+/**
+ * Write a text report on the state of each of the paper roots, as found
+ * by the last load, showing which roots share identical definition files.
+ *
+ * \param *filename		The name of the file to be written.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool audit_write_report(char *filename);
+
+#endif
@@ -29,7 +29,7 @@
 
 /* ANSI C header files */
 
-//#include <string.h>
+#include <string.h>
 #include <stdlib.h>
 //#include <stdio.h>
 
@@ -41,6 +41,7 @@
 
 //#include "oslib/osspriteop.h"
 #include "oslib/wimp.h"
+#include "oslib/wimptextop.h"
 
 /* SF-Lib header files. */
 
@@ -56,6 +57,49 @@
 
 #include "columns.h"
 
+/**
+ * The granularity, in OS units, with which text widths are tracked.
+ */
+
+#define COLUMNS_WIDTH_STEP 4
+
+/**
+ * The minimum number of width steps tracked for each column. More are used
+ * if needed to reach the maximum width of any column, and wider texts are
+ * counted in the last step.
+ */
+
+#define COLUMNS_WIDTH_BUCKETS 256
+
+/**
+ * The space, in OS units, to allow around column headings when fitting.
+ */
+
+#define COLUMNS_HEADING_MARGIN 24
+
+/**
+ * The initial number of entries in the text width cache, which must be
+ * a power of two.
+ */
+
+#define COLUMNS_CACHE_INITIAL_SIZE 256
+
+/**
+ * The allocation step for the text width cache's string pool.
+ */
+
+#define COLUMNS_POOL_ALLOCATION 4096
+
+/**
+ * An entry in the text width cache.
+ */
+
+struct columns_text {
+	unsigned			hash;			/**< The hash of the text.						*/
+	size_t				offset;			/**< The offset of the text in the string pool.				*/
+	int				width;			/**< The width of the text, in OS units, or -1 if the entry is empty.	*/
+};
+
 
 /**
  * Column block structure, defining one column window instance.
@@ -71,8 +115,23 @@ struct columns_block {
 	size_t				column_count;		/**< The number of columns defined in the window.			*/
 	struct columns_definition	*columns;		/**< An array of column definitions for the window.			*/
 	int				*column_locations;	/**< An array of left-hand positions of the columns in the window.	*/
+
+	unsigned			*width_counts;		/**< The number of tracked texts of each width, for each column.	*/
+	int				width_buckets;		/**< The number of width steps tracked for each column.			*/
+	int				*widest;		/**< The widest width step in use for each column, or -1.		*/
+
+	struct columns_text		*cache;			/**< The text width cache, or NULL.					*/
+	unsigned			cache_size;		/**< The number of entries in the cache.				*/
+	unsigned			cache_count;		/**< The number of entries in use in the cache.				*/
+	char				*pool;			/**< The pool holding the cached texts.					*/
+	size_t				pool_size;		/**< The size of the string pool.					*/
+	size_t				pool_used;		/**< The amount of the string pool in use.				*/
 };
 
+static int		columns_measure_text(struct columns_block *handle, char *text);
+static osbool		columns_cache_text(struct columns_block *handle, char *text, unsigned hash, int width);
+static unsigned		columns_hash_text(char *text);
+
 
 /**
  * Create a new column definition instance, and return a handle for the instance
@@ -88,6 +147,7 @@ struct columns_block {
 struct columns_block *columns_create_window(wimp_window *window_def, wimp_window *toolbar_def, struct columns_definition columns[], size_t column_count)
 {
 	struct columns_block	*new;
+	int			column, buckets;
 
 	new = malloc(sizeof(struct columns_block));
 	if (new == NULL)
@@ -103,6 +163,38 @@ struct columns_block *columns_create_window(wimp_window *window_def, wimp_window
 	new->column_locations = malloc(sizeof(int) * column_count);
 	new->column_count = column_count;
 
+	/* Track enough width steps to reach the widest column's maximum, so
+	 * that only texts which would be clipped anyway share the last step.
+	 */
+
+	new->width_buckets = COLUMNS_WIDTH_BUCKETS;
+
+	for (column = 0; column < column_count; column++) {
+		buckets = (columns[column].max_width + COLUMNS_WIDTH_STEP - 1) / COLUMNS_WIDTH_STEP + 1;
+		if (buckets > new->width_buckets)
+			new->width_buckets = buckets;
+	}
+
+	new->width_counts = malloc(sizeof(unsigned) * new->width_buckets * column_count);
+	new->widest = malloc(sizeof(int) * column_count);
+
+	new->cache = NULL;
+	new->cache_size = 0;
+	new->cache_count = 0;
+	new->pool = NULL;
+	new->pool_size = 0;
+	new->pool_used = 0;
+
+	if (new->column_locations == NULL || new->width_counts == NULL || new->widest == NULL) {
+		free(new->column_locations);
+		free(new->width_counts);
+		free(new->widest);
+		free(new);
+		return NULL;
+	}
+
+	columns_reset_widths(new);
+
 	return new;
 }
 
@@ -153,7 +245,10 @@ void columns_adjust_icons(struct columns_block *handle)
 	if (handle == NULL)
 		return;
 
-	/* \TODO -- This won't handle grouped columns, or already-created windows at present. */
+	/* \TODO -- This won't handle grouped columns at present. The main window
+	 * icons are only used for plotting, so only the toolbar headings need
+	 * to be resized if the windows already exist.
+	 */
 
 	xpos = 0;
 
@@ -166,6 +261,11 @@ void columns_adjust_icons(struct columns_block *handle)
 		handle->toolbar_def->icons[icon].extent.x0 = xpos;
 		handle->toolbar_def->icons[icon].extent.x1 = xpos + handle->columns[column].width;
 
+		if (handle->toolbar != NULL)
+			xwimp_resize_icon(handle->toolbar, icon,
+					handle->toolbar_def->icons[icon].extent.x0, handle->toolbar_def->icons[icon].extent.y0,
+					handle->toolbar_def->icons[icon].extent.x1, handle->toolbar_def->icons[icon].extent.y1);
+
 		handle->column_locations[column] = xpos;
 
 		xpos += handle->columns[column].width;
@@ -215,3 +315,314 @@ int columns_find_pointer(struct columns_block *handle, int xpos)
 
 	return column;
 }
+
+
+/**
+ * Identify which columns overlap a horizontal range of the window, such as
+ * the clip rectangle of a redraw. No more than 32 columns are reported.
+ *
+ * \param *handle		The handle of the column instance to interrogate.
+ * \param x0			The inclusive left-hand edge of the range, in work area coordinates.
+ * \param x1			The exclusive right-hand edge of the range, in work area coordinates.
+ * \return			A mask of the overlapping columns, built with COLUMNS_MASK().
+ */
+
+unsigned columns_find_visible(struct columns_block *handle, int x0, int x1)
+{
+	int		column;
+	unsigned	mask = 0;
+
+	if (handle == NULL)
+		return 0;
+
+	/* The columns run from left to right, so stop at the first one which
+	 * starts beyond the range.
+	 */
+
+	for (column = 0; column < handle->column_count && column < 32 && handle->column_locations[column] < x1; column++) {
+		if (handle->column_locations[column] + handle->columns[column].width > x0)
+			mask |= COLUMNS_MASK(column);
+	}
+
+	return mask;
+}
+
+
+/**
+ * Forget all of the text widths tracked for the auto-fit columns in an
+ * instance, ready for the contents to be added again. Measured widths
+ * remain cached.
+ *
+ * \param *handle		The handle of the column instance to reset.
+ */
+
+void columns_reset_widths(struct columns_block *handle)
+{
+	int	column;
+
+	if (handle == NULL)
+		return;
+
+	memset(handle->width_counts, 0, sizeof(unsigned) * handle->width_buckets * handle->column_count);
+
+	for (column = 0; column < handle->column_count; column++)
+		handle->widest[column] = -1;
+}
+
+
+/**
+ * Track the width of a piece of text displayed in an auto-fit column.
+ * The text is measured once, and then its width is cached.
+ *
+ * \param *handle		The handle of the column instance to update.
+ * \param column		The column holding the text.
+ * \param *text			The text being displayed.
+ */
+
+void columns_add_text(struct columns_block *handle, int column, char *text)
+{
+	int	step;
+
+	if (handle == NULL || column < 0 || column >= handle->column_count || text == NULL ||
+			!(handle->columns[column].flags & COLUMNS_FLAGS_AUTO_FIT))
+		return;
+
+	step = (columns_measure_text(handle, text) + COLUMNS_WIDTH_STEP - 1) / COLUMNS_WIDTH_STEP;
+	if (step >= handle->width_buckets)
+		step = handle->width_buckets - 1;
+
+	handle->width_counts[column * handle->width_buckets + step]++;
+
+	if (step > handle->widest[column])
+		handle->widest[column] = step;
+}
+
+
+/**
+ * Stop tracking the width of a piece of text previously added to an
+ * auto-fit column.
+ *
+ * \param *handle		The handle of the column instance to update.
+ * \param column		The column holding the text.
+ * \param *text			The text being removed.
+ */
+
+void columns_remove_text(struct columns_block *handle, int column, char *text)
+{
+	int		step;
+	unsigned	*counts;
+
+	if (handle == NULL || column < 0 || column >= handle->column_count || text == NULL ||
+			!(handle->columns[column].flags & COLUMNS_FLAGS_AUTO_FIT))
+		return;
+
+	step = (columns_measure_text(handle, text) + COLUMNS_WIDTH_STEP - 1) / COLUMNS_WIDTH_STEP;
+	if (step >= handle->width_buckets)
+		step = handle->width_buckets - 1;
+
+	counts = handle->width_counts + column * handle->width_buckets;
+
+	if (counts[step] == 0)
+		return;
+
+	counts[step]--;
+
+	/* If that was the last of the widest texts, step down to the next
+	 * widest; this is bounded by the number of steps, not the number
+	 * of texts being tracked.
+	 */
+
+	while (handle->widest[column] >= 0 && counts[handle->widest[column]] == 0)
+		handle->widest[column]--;
+}
+
+
+/**
+ * Fit the widths of the auto-fit columns in an instance to the widest text
+ * tracked in each, and update the icon positions if anything changes.
+ *
+ * \param *handle		The handle of the column instance to update.
+ * \return			TRUE if any column widths changed; else FALSE.
+ */
+
+osbool columns_fit_widths(struct columns_block *handle)
+{
+	int			column, width, minimum;
+	osbool			changed = FALSE;
+	wimp_icon		*heading;
+
+	if (handle == NULL)
+		return FALSE;
+
+	for (column = 0; column < handle->column_count; column++) {
+		if (!(handle->columns[column].flags & COLUMNS_FLAGS_AUTO_FIT) || handle->widest[column] < 0)
+			continue;
+
+		width = handle->widest[column] * COLUMNS_WIDTH_STEP + handle->columns[column].left_margin +
+				handle->columns[column].right_margin;
+
+		/* Don't let the column get narrower than its heading. */
+
+		minimum = handle->columns[column].min_width;
+
+		heading = handle->toolbar_def->icons + handle->columns[column].heading_icon;
+
+		if ((heading->flags & wimp_ICON_TEXT) && (heading->flags & wimp_ICON_INDIRECTED) &&
+				columns_measure_text(handle, heading->data.indirected_text.text) + COLUMNS_HEADING_MARGIN > minimum)
+			minimum = columns_measure_text(handle, heading->data.indirected_text.text) + COLUMNS_HEADING_MARGIN;
+
+		if (width < minimum)
+			width = minimum;
+
+		if (handle->columns[column].max_width >= 0 && width > handle->columns[column].max_width)
+			width = handle->columns[column].max_width;
+
+		if (width != handle->columns[column].width) {
+			handle->columns[column].width = width;
+			changed = TRUE;
+		}
+	}
+
+	if (changed)
+		columns_adjust_icons(handle);
+
+	return changed;
+}
+
+
+/**
+ * Find the width of a piece of text in the desktop font, using the cache
+ * if it has been measured before.
+ *
+ * \param *handle		The handle of the column instance holding the cache.
+ * \param *text			The text to measure.
+ * \return			The width of the text, in OS units.
+ */
+
+static int columns_measure_text(struct columns_block *handle, char *text)
+{
+	unsigned	hash, slot;
+	int		width;
+
+	hash = columns_hash_text(text);
+
+	if (handle->cache != NULL) {
+		slot = hash & (handle->cache_size - 1);
+
+		while (handle->cache[slot].width != -1) {
+			if (handle->cache[slot].hash == hash && strcmp(handle->pool + handle->cache[slot].offset, text) == 0)
+				return handle->cache[slot].width;
+
+			slot = (slot + 1) & (handle->cache_size - 1);
+		}
+	}
+
+	if (xwimptextop_string_width(text, 0, &width) != NULL)
+		width = 0;
+
+	columns_cache_text(handle, text, hash, width);
+
+	return width;
+}
+
+
+/**
+ * Add a piece of text and its width to the text width cache, growing the
+ * cache if required.
+ *
+ * \param *handle		The handle of the column instance holding the cache.
+ * \param *text			The text to be added.
+ * \param hash			The hash of the text.
+ * \param width			The width of the text, in OS units.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool columns_cache_text(struct columns_block *handle, char *text, unsigned hash, int width)
+{
+	struct columns_text	*new_cache, *old_cache;
+	unsigned		new_size, old_size, slot, entry;
+	size_t			length, new_allocation;
+	char			*new_pool;
+
+	/* Keep the cache no more than half full, doubling it when required. */
+
+	if (handle->cache == NULL || handle->cache_count >= handle->cache_size / 2) {
+		new_size = (handle->cache == NULL) ? COLUMNS_CACHE_INITIAL_SIZE : handle->cache_size * 2;
+
+		new_cache = malloc(new_size * sizeof(struct columns_text));
+		if (new_cache == NULL)
+			return FALSE;
+
+		for (slot = 0; slot < new_size; slot++)
+			new_cache[slot].width = -1;
+
+		old_cache = handle->cache;
+		old_size = handle->cache_size;
+
+		for (entry = 0; entry < old_size; entry++) {
+			if (old_cache[entry].width == -1)
+				continue;
+
+			slot = old_cache[entry].hash & (new_size - 1);
+
+			while (new_cache[slot].width != -1)
+				slot = (slot + 1) & (new_size - 1);
+
+			new_cache[slot] = old_cache[entry];
+		}
+
+		free(old_cache);
+
+		handle->cache = new_cache;
+		handle->cache_size = new_size;
+	}
+
+	/* Copy the text into the string pool. */
+
+	length = strlen(text) + 1;
+
+	if (handle->pool_used + length > handle->pool_size) {
+		new_allocation = ((handle->pool_used + length) / COLUMNS_POOL_ALLOCATION + 1) * COLUMNS_POOL_ALLOCATION;
+
+		new_pool = realloc(handle->pool, new_allocation);
+		if (new_pool == NULL)
+			return FALSE;
+
+		handle->pool = new_pool;
+		handle->pool_size = new_allocation;
+	}
+
+	memcpy(handle->pool + handle->pool_used, text, length);
+
+	slot = hash & (handle->cache_size - 1);
+
+	while (handle->cache[slot].width != -1)
+		slot = (slot + 1) & (handle->cache_size - 1);
+
+	handle->cache[slot].hash = hash;
+	handle->cache[slot].offset = handle->pool_used;
+	handle->cache[slot].width = width;
+
+	handle->pool_used += length;
+	handle->cache_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Calculate the hash of a piece of text, for the text width cache.
+ *
+ * \param *text			The text to hash.
+ * \return			The hash value.
+ */
+
+static unsigned columns_hash_text(char *text)
+{
+	unsigned	hash = 5381;
+
+	while (*text != '\0')
+		hash = (hash * 33) ^ (unsigned char) *text++;
+
+	return hash;
+}
@@ -44,9 +44,16 @@ struct columns_block;
  */
 
 enum columns_flags {
-	COLUMNS_FLAGS_NONE = 0				/**< No flags are set.		*/
+	COLUMNS_FLAGS_NONE = 0,				/**< No flags are set.						*/
+	COLUMNS_FLAGS_AUTO_FIT = 1			/**< The column width is fitted to the widest text added.	*/
 };
 
+/**
+ * Convert a column number into a bit in a column mask.
+ */
+
+#define COLUMNS_MASK(column) (1u << (column))
+
 /**
  * A column, to be defined by the client.
  */
@@ -128,4 +135,63 @@ int columns_get_full_width(struct columns_block *handle);
 
 int columns_find_pointer(struct columns_block *handle, int xpos);
 
+
+/**
+ * Identify which columns overlap a horizontal range of the window, such as
+ * the clip rectangle of a redraw. No more than 32 columns are reported.
+ *
+ * \param *handle		The handle of the column instance to interrogate.
+ * \param x0			The inclusive left-hand edge of the range, in work area coordinates.
+ * \param x1			The exclusive right-hand edge of the range, in work area coordinates.
+ * \return			A mask of the overlapping columns, built with COLUMNS_MASK().
+ */
+
+unsigned columns_find_visible(struct columns_block *handle, int x0, int x1);
+
+
+/**
+ * Forget all of the text widths tracked for the auto-fit columns in an
+ * instance, ready for the contents to be added again. Measured widths
+ * remain cached.
+ *
+ * \param *handle		The handle of the column instance to reset.
+ */
+
+void columns_reset_widths(struct columns_block *handle);
+
+
+/**
+ * Track the width of a piece of text displayed in an auto-fit column.
+ * The text is measured once, and then its width is cached.
+ *
+ * \param *handle		The handle of the column instance to update.
+ * \param column		The column holding the text.
+ * \param *text			The text being displayed.
+ */
+
+void columns_add_text(struct columns_block *handle, int column, char *text);
+
+
+/**
+ * Stop tracking the width of a piece of text previously added to an
+ * auto-fit column.
+ *
+ * \param *handle		The handle of the column instance to update.
+ * \param column		The column holding the text.
+ * \param *text			The text being removed.
+ */
+
+void columns_remove_text(struct columns_block *handle, int column, char *text);
+
+
+/**
+ * Fit the widths of the auto-fit columns in an instance to the widest text
+ * tracked in each, and update the icon positions if anything changes.
+ *
+ * \param *handle		The handle of the column instance to update.
+ * \return			TRUE if any column widths changed; else FALSE.
+ */
+
+osbool columns_fit_widths(struct columns_block *handle);
+
 #endif
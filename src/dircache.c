@@ -0,0 +1,637 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: dircache.c
+ *
+ * Snippet folder catalogue implementation.
+ *
+ * Rather than reading the details of each snippet file in turn, which is
+ * slow on network filing systems, the folders are read in a few calls to
+ * OS_GBPB 10 and the files held in a hash table for the rest of the scan.
+ *
+ * OS_GBPB 10 only reads the first element of a path such as Choices:, so
+ * folders on path variables are expanded here and each element is read as
+ * a folder in its own right; lookups then search the elements in order, as
+ * the filing system would.
+ */
+
+/* ANSI C header files */
+
+#include <ctype.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* OSLib header files */
+
+#include "oslib/fileswitch.h"
+#include "oslib/os.h"
+#include "oslib/osgbpb.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/string.h"
+
+/* Application header files */
+
+#include "dircache.h"
+
+/**
+ * The size of the buffer used to read folder entries.
+ */
+
+#define DIRCACHE_BUFFER_LEN 2048
+
+/**
+ * The initial number of hash buckets; this is always a power of two.
+ */
+
+#define DIRCACHE_INITIAL_BUCKETS 64
+
+/**
+ * The step by which the name pool is extended.
+ */
+
+#define DIRCACHE_POOL_ALLOCATION 1024
+
+/**
+ * The end of a hash chain.
+ */
+
+#define DIRCACHE_NONE (-1)
+
+/**
+ * The maximum length of a folder name, once path variables are expanded.
+ */
+
+#define DIRCACHE_PATH_LEN 1024
+
+/**
+ * The maximum length of the name of a path variable.
+ */
+
+#define DIRCACHE_VARIABLE_LEN 64
+
+/**
+ * The deepest that path variables will be expanded within each other.
+ */
+
+#define DIRCACHE_MAX_DEPTH 4
+
+/**
+ * The number of path elements which are remembered while enumerating a
+ * folder, so that files hidden by earlier elements can be skipped.
+ */
+
+#define DIRCACHE_MAX_ELEMENTS 16
+
+/**
+ * A callback to be called for each folder in an expanded path.
+ *
+ * \param index			The index of the catalogued folder.
+ * \param *data			The client data passed to dircache_expand_path().
+ * \return			TRUE to stop the expansion; FALSE to continue.
+ */
+
+typedef osbool (*dircache_folder_callback)(int index, void *data);
+
+/**
+ * The details of a file lookup across the elements of a path.
+ */
+
+struct dircache_lookup {
+	char			*leaf;				/**< The leafname of the file to look up.			*/
+	struct dircache_file	*file;				/**< Pointer to a block to take the file details, or NULL.	*/
+};
+
+/**
+ * The details of an enumeration across the elements of a path.
+ */
+
+struct dircache_enumeration {
+	dircache_callback	callback;			/**< The function to call for each file.			*/
+	void			*data;				/**< The client data to pass to the callback.			*/
+	int			elements[DIRCACHE_MAX_ELEMENTS];/**< The folders of the elements enumerated so far.		*/
+	int			count;				/**< The number of elements enumerated so far.			*/
+};
+
+/**
+ * A catalogued folder.
+ */
+
+struct dircache_folder {
+	char			*path;				/**< The name of the folder.					*/
+	int			first;				/**< The index of the folder's first file entry.		*/
+	int			count;				/**< The number of file entries in the folder.			*/
+};
+
+/**
+ * A catalogued file.
+ */
+
+struct dircache_entry {
+	int			folder;				/**< The index of the folder holding the file.			*/
+	size_t			name;				/**< The offset of the leafname in the name pool.		*/
+	unsigned		hash;				/**< The hash of the leafname.					*/
+	int			next;				/**< The next entry in the hash chain, or DIRCACHE_NONE.	*/
+	struct dircache_file	file;				/**< The details of the file.					*/
+};
+
+static struct dircache_folder	*dircache_folders = NULL;	/**< The catalogued folders.					*/
+static int			dircache_folder_count = 0;	/**< The number of catalogued folders.				*/
+
+static struct dircache_entry	*dircache_entries = NULL;	/**< The catalogued files.					*/
+static int			dircache_entry_count = 0;	/**< The number of catalogued files.				*/
+static int			dircache_entry_allocation = 0;	/**< The number of spaces allocated for files.			*/
+
+static int			*dircache_buckets = NULL;	/**< The hash buckets, holding the first entry in each chain.	*/
+static unsigned			dircache_bucket_count = 0;	/**< The number of hash buckets.				*/
+
+static char			*dircache_pool = NULL;		/**< The pool of leafnames.					*/
+static size_t			dircache_pool_used = 0;		/**< The amount of the name pool in use.			*/
+static size_t			dircache_pool_allocation = 0;	/**< The size of the name pool.					*/
+
+static osbool	dircache_expand_path(char *folder, int depth, dircache_folder_callback callback, void *data);
+static osbool	dircache_lookup_folder(int index, void *data);
+static osbool	dircache_enumerate_folder(int index, void *data);
+static int	dircache_find_entry(int index, char *leaf);
+static int	dircache_find_folder(char *folder);
+static int	dircache_add_folder(char *folder);
+static osbool	dircache_add_entry(int folder, char *leaf, struct dircache_file *file);
+static osbool	dircache_rehash(unsigned buckets);
+
+
+/**
+ * Forget all of the folders which have been catalogued, so that they will
+ * be read again when next required. This should be called at the start
+ * of each scan of the snippet files.
+ */
+
+void dircache_reset(void)
+{
+	int	folder;
+
+	for (folder = 0; folder < dircache_folder_count; folder++)
+		free(dircache_folders[folder].path);
+
+	free(dircache_folders);
+	dircache_folders = NULL;
+	dircache_folder_count = 0;
+
+	free(dircache_entries);
+	dircache_entries = NULL;
+	dircache_entry_count = 0;
+	dircache_entry_allocation = 0;
+
+	free(dircache_buckets);
+	dircache_buckets = NULL;
+	dircache_bucket_count = 0;
+
+	free(dircache_pool);
+	dircache_pool = NULL;
+	dircache_pool_used = 0;
+	dircache_pool_allocation = 0;
+}
+
+
+/**
+ * Look up a file in a folder. The first lookup in each folder following a
+ * reset reads the whole folder into memory, and all subsequent lookups are
+ * answered from there. If the folder is on a path variable, each element
+ * of the path is searched in turn.
+ *
+ * \param *folder		The name of the folder to look in.
+ * \param *leaf			The leafname of the file to look up.
+ * \param *file			Pointer to a block to take the file details, or NULL.
+ * \return			TRUE if the file exists; FALSE if not.
+ */
+
+osbool dircache_find_file(char *folder, char *leaf, struct dircache_file *file)
+{
+	struct dircache_lookup	lookup;
+
+	if (folder == NULL || leaf == NULL)
+		return FALSE;
+
+	lookup.leaf = leaf;
+	lookup.file = file;
+
+	return dircache_expand_path(folder, 0, dircache_lookup_folder, &lookup);
+}
+
+
+/**
+ * Call a function for each of the files in a folder, reading the folder
+ * into the catalogue first if it hasn't already been seen since the last
+ * reset. If the folder is on a path variable, the files in each element of
+ * the path are passed in turn, skipping any which are hidden by a file of
+ * the same name in an earlier element.
+ *
+ * \param *folder		The name of the folder to enumerate.
+ * \param callback		The function to call for each file.
+ * \param *data			Client data to pass to the callback.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool dircache_enumerate(char *folder, dircache_callback callback, void *data)
+{
+	struct dircache_enumeration	enumeration;
+
+	if (folder == NULL || callback == NULL)
+		return FALSE;
+
+	enumeration.callback = callback;
+	enumeration.data = data;
+	enumeration.count = 0;
+
+	dircache_expand_path(folder, 0, dircache_enumerate_folder, &enumeration);
+
+	return (enumeration.count > 0) ? TRUE : FALSE;
+}
+
+
+/**
+ * Calculate the hash of a filename. Filenames are not case sensitive, so
+ * neither is the hash.
+ *
+ * \param *name			The name to hash.
+ * \return			The hash value.
+ */
+
+unsigned dircache_hash_name(char *name)
+{
+	unsigned	hash = 5381u;
+
+	while (*name != '\0')
+		hash = (hash * 33u) ^ (unsigned) tolower((unsigned char) *name++);
+
+	return hash;
+}
+
+
+/**
+ * Expand a folder on a path variable into the folders for each element of
+ * the path, in order, and pass each in turn to a callback. Elements which
+ * are themselves on path variables are expanded in the same way. A folder
+ * which isn't on a path variable is passed to the callback unchanged.
+ *
+ * \param *folder		The name of the folder to expand.
+ * \param depth			The current depth of expansion.
+ * \param callback		The function to call for each folder.
+ * \param *data			Client data to pass to the callback.
+ * \return			TRUE if the callback stopped the expansion; else FALSE.
+ */
+
+static osbool dircache_expand_path(char *folder, int depth, dircache_folder_callback callback, void *data)
+{
+	char	variable[DIRCACHE_VARIABLE_LEN], value[DIRCACHE_PATH_LEN], element[DIRCACHE_PATH_LEN], *rest, *start, *end;
+	int	index, used;
+	size_t	length;
+
+	/* A path variable prefix comes before any dots or system variables. */
+
+	rest = strchr(folder, ':');
+	length = (rest == NULL) ? 0 : rest - folder;
+
+	if (depth < DIRCACHE_MAX_DEPTH && length > 0 && strcspn(folder, ".<") > length && length + 6 <= DIRCACHE_VARIABLE_LEN) {
+		string_printf(variable, DIRCACHE_VARIABLE_LEN, "%.*s$Path", (int) length, folder);
+
+		if (xos_read_var_val(variable, value, DIRCACHE_PATH_LEN - 1, 0, os_VARTYPE_EXPANDED, &used, NULL, NULL) == NULL) {
+			value[used] = '\0';
+
+			for (start = value; *start != '\0'; start = (*end == ',') ? end + 1 : end) {
+				while (*start == ' ')
+					start++;
+
+				for (end = start; *end != '\0' && *end != ','; end++);
+
+				string_printf(element, DIRCACHE_PATH_LEN, "%.*s%s", (int) (end - start), start, rest + 1);
+
+				if (dircache_expand_path(element, depth + 1, callback, data))
+					return TRUE;
+			}
+
+			return FALSE;
+		}
+	}
+
+	index = dircache_find_folder(folder);
+
+	return (index != DIRCACHE_NONE && callback(index, data)) ? TRUE : FALSE;
+}
+
+
+/**
+ * Look a file up in a catalogued folder, as part of a search through the
+ * elements of a path.
+ *
+ * \param index			The index of the folder to look in.
+ * \param *data			The lookup details.
+ * \return			TRUE if the file was found; else FALSE.
+ */
+
+static osbool dircache_lookup_folder(int index, void *data)
+{
+	struct dircache_lookup	*lookup = data;
+	int			entry;
+
+	entry = dircache_find_entry(index, lookup->leaf);
+	if (entry == DIRCACHE_NONE)
+		return FALSE;
+
+	if (lookup->file != NULL)
+		*(lookup->file) = dircache_entries[entry].file;
+
+	return TRUE;
+}
+
+
+/**
+ * Pass the files in a catalogued folder to an enumeration callback, as
+ * part of an enumeration through the elements of a path.
+ *
+ * \param index			The index of the folder to enumerate.
+ * \param *data			The enumeration details.
+ * \return			FALSE, so that the enumeration continues.
+ */
+
+static osbool dircache_enumerate_folder(int index, void *data)
+{
+	struct dircache_enumeration	*enumeration = data;
+	int				entry, end, element;
+	char				*leaf;
+
+	/* A folder which appears twice in the path has already been seen. */
+
+	for (element = 0; element < enumeration->count && element < DIRCACHE_MAX_ELEMENTS; element++) {
+		if (enumeration->elements[element] == index)
+			return FALSE;
+	}
+
+	/* The entries for a folder are always added in a single block. */
+
+	end = dircache_folders[index].first + dircache_folders[index].count;
+
+	for (entry = dircache_folders[index].first; entry < end; entry++) {
+		leaf = dircache_pool + dircache_entries[entry].name;
+
+		for (element = 0; element < enumeration->count && element < DIRCACHE_MAX_ELEMENTS; element++) {
+			if (dircache_find_entry(enumeration->elements[element], leaf) != DIRCACHE_NONE)
+				break;
+		}
+
+		if (element >= enumeration->count || element >= DIRCACHE_MAX_ELEMENTS)
+			enumeration->callback(leaf, &(dircache_entries[entry].file), enumeration->data);
+	}
+
+	if (enumeration->count < DIRCACHE_MAX_ELEMENTS)
+		enumeration->elements[enumeration->count] = index;
+
+	enumeration->count++;
+
+	return FALSE;
+}
+
+
+/**
+ * Look a file up in the hash table.
+ *
+ * \param index			The index of the folder holding the file.
+ * \param *leaf			The leafname of the file.
+ * \return			The index of the file entry, or DIRCACHE_NONE.
+ */
+
+static int dircache_find_entry(int index, char *leaf)
+{
+	int		entry;
+	unsigned	hash;
+
+	if (dircache_buckets == NULL)
+		return DIRCACHE_NONE;
+
+	hash = dircache_hash_name(leaf);
+
+	for (entry = dircache_buckets[hash & (dircache_bucket_count - 1)]; entry != DIRCACHE_NONE; entry = dircache_entries[entry].next) {
+		if (dircache_entries[entry].hash == hash && dircache_entries[entry].folder == index &&
+				string_nocase_strcmp(dircache_pool + dircache_entries[entry].name, leaf) == 0)
+			return entry;
+	}
+
+	return DIRCACHE_NONE;
+}
+
+
+/**
+ * Find a folder in the catalogue, reading it in if it hasn't been seen
+ * since the last reset. There are only ever a few folders, so a linear
+ * search is fine.
+ *
+ * \param *folder		The name of the folder to find.
+ * \return			The index of the folder, or DIRCACHE_NONE.
+ */
+
+static int dircache_find_folder(char *folder)
+{
+	int	index;
+
+	for (index = 0; index < dircache_folder_count; index++) {
+		if (string_nocase_strcmp(dircache_folders[index].path, folder) == 0)
+			return index;
+	}
+
+	return dircache_add_folder(folder);
+}
+
+
+/**
+ * Read the contents of a folder into the catalogue. A folder which can't
+ * be read is still recorded, so that it isn't tried again; it will simply
+ * appear to be empty.
+ *
+ * \param *folder		The name of the folder to read.
+ * \return			The index of the new folder, or DIRCACHE_NONE.
+ */
+
+static int dircache_add_folder(char *folder)
+{
+	struct dircache_folder	*new_folders;
+	osgbpb_info		*info;
+	struct dircache_file	file;
+	int			index, context, read, i;
+	char			*buffer, *entry;
+	os_error		*error;
+
+	new_folders = realloc(dircache_folders, (dircache_folder_count + 1) * sizeof(struct dircache_folder));
+	if (new_folders == NULL)
+		return DIRCACHE_NONE;
+
+	dircache_folders = new_folders;
+
+	dircache_folders[dircache_folder_count].path = malloc(strlen(folder) + 1);
+	if (dircache_folders[dircache_folder_count].path == NULL)
+		return DIRCACHE_NONE;
+
+	strcpy(dircache_folders[dircache_folder_count].path, folder);
+	dircache_folders[dircache_folder_count].first = dircache_entry_count;
+	dircache_folders[dircache_folder_count].count = 0;
+	index = dircache_folder_count++;
+
+	if (dircache_buckets == NULL && !dircache_rehash(DIRCACHE_INITIAL_BUCKETS))
+		return DIRCACHE_NONE;
+
+	/* Read the folder in batches, until the context comes back as -1. */
+
+	buffer = malloc(DIRCACHE_BUFFER_LEN);
+	if (buffer == NULL)
+		return index;
+
+	context = 0;
+
+	while (context != -1) {
+		error = xosgbpb_dir_entries_info(folder, (osgbpb_info_list *) buffer, DIRCACHE_BUFFER_LEN, context,
+				DIRCACHE_BUFFER_LEN, NULL, &read, &context);
+		if (error != NULL)
+			break;
+
+		entry = buffer;
+
+		for (i = 0; i < read; i++) {
+			info = (osgbpb_info *) entry;
+
+			if (info->obj_type == fileswitch_IS_FILE) {
+				file.size = info->size;
+				file.load_addr = info->load_addr;
+				file.exec_addr = info->exec_addr;
+
+				if (dircache_add_entry(index, info->name, &file))
+					dircache_folders[index].count++;
+				else
+					context = -1;
+			}
+
+			/* Records are word-aligned, and sized to fit their names. */
+
+			entry += (offsetof(osgbpb_info, name) + strlen(info->name) + 4) & ~3;
+		}
+	}
+
+	free(buffer);
+
+	return index;
+}
+
+
+/**
+ * Add a file to the catalogue.
+ *
+ * \param folder		The index of the folder holding the file.
+ * \param *leaf			The leafname of the file.
+ * \param *file			The details of the file.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool dircache_add_entry(int folder, char *leaf, struct dircache_file *file)
+{
+	struct dircache_entry	*new_entries;
+	char			*new_pool;
+	size_t			length, new_allocation;
+	unsigned		bucket;
+
+	/* Grow the table when it becomes more than three-quarters full. */
+
+	if (dircache_entry_count >= dircache_bucket_count * 3 / 4 && !dircache_rehash(dircache_bucket_count * 2))
+		return FALSE;
+
+	if (dircache_entry_count >= dircache_entry_allocation) {
+		new_entries = realloc(dircache_entries, dircache_bucket_count * sizeof(struct dircache_entry));
+		if (new_entries == NULL)
+			return FALSE;
+
+		dircache_entries = new_entries;
+		dircache_entry_allocation = dircache_bucket_count;
+	}
+
+	length = strlen(leaf) + 1;
+
+	if (dircache_pool_used + length > dircache_pool_allocation) {
+		new_allocation = dircache_pool_allocation + ((length > DIRCACHE_POOL_ALLOCATION) ? length : DIRCACHE_POOL_ALLOCATION);
+
+		new_pool = realloc(dircache_pool, new_allocation);
+		if (new_pool == NULL)
+			return FALSE;
+
+		dircache_pool = new_pool;
+		dircache_pool_allocation = new_allocation;
+	}
+
+	strcpy(dircache_pool + dircache_pool_used, leaf);
+
+	dircache_entries[dircache_entry_count].folder = folder;
+	dircache_entries[dircache_entry_count].name = dircache_pool_used;
+	dircache_entries[dircache_entry_count].hash = dircache_hash_name(leaf);
+	dircache_entries[dircache_entry_count].file = *file;
+
+	dircache_pool_used += length;
+
+	bucket = dircache_entries[dircache_entry_count].hash & (dircache_bucket_count - 1);
+	dircache_entries[dircache_entry_count].next = dircache_buckets[bucket];
+	dircache_buckets[bucket] = dircache_entry_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Change the number of hash buckets, and rebuild the chains.
+ *
+ * \param buckets		The new number of buckets, which must be a power of two.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool dircache_rehash(unsigned buckets)
+{
+	int		*new_buckets, entry;
+	unsigned	bucket;
+
+	new_buckets = malloc(buckets * sizeof(int));
+	if (new_buckets == NULL)
+		return FALSE;
+
+	for (bucket = 0; bucket < buckets; bucket++)
+		new_buckets[bucket] = DIRCACHE_NONE;
+
+	for (entry = 0; entry < dircache_entry_count; entry++) {
+		bucket = dircache_entries[entry].hash & (buckets - 1);
+		dircache_entries[entry].next = new_buckets[bucket];
+		new_buckets[bucket] = entry;
+	}
+
+	free(dircache_buckets);
+	dircache_buckets = new_buckets;
+	dircache_bucket_count = buckets;
+
+	return TRUE;
+}
+
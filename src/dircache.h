@@ -0,0 +1,106 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: dircache.h
+ *
+ * Snippet folder catalogue interface.
+ */
+
+#ifndef PS2PAPER_DIRCACHE
+#define PS2PAPER_DIRCACHE
+
+#include "oslib/types.h"
+
+/**
+ * The catalogue details of a file.
+ */
+
+struct dircache_file {
+	int			size;				/**< The size of the file, in bytes.				*/
+	bits			load_addr;			/**< The load address, holding the filetype and date.		*/
+	bits			exec_addr;			/**< The execution address, holding the rest of the date.	*/
+};
+
+/**
+ * A callback to be called for each file in a folder.
+ *
+ * \param *leaf			The leafname of the file.
+ * \param *file			The details of the file.
+ * \param *data			The client data passed to dircache_enumerate().
+ */
+
+typedef void (*dircache_callback)(char *leaf, struct dircache_file *file, void *data);
+
+
+/**
+ * Forget all of the folders which have been catalogued, so that they will
+ * be read again when next required. This should be called at the start
+ * of each scan of the snippet files.
+ */
+
+void dircache_reset(void);
+
+
+/**
+ * Look up a file in a folder. The first lookup in each folder following a
+ * reset reads the whole folder into memory, and all subsequent lookups are
+ * answered from there. If the folder is on a path variable, each element
+ * of the path is searched in turn.
+ *
+ * \param *folder		The name of the folder to look in.
+ * \param *leaf			The leafname of the file to look up.
+ * \param *file			Pointer to a block to take the file details, or NULL.
+ * \return			TRUE if the file exists; FALSE if not.
+ */
+
+osbool dircache_find_file(char *folder, char *leaf, struct dircache_file *file);
+
+
+/**
+ * Call a function for each of the files in a folder, reading the folder
+ * into the catalogue first if it hasn't already been seen since the last
+ * reset. If the folder is on a path variable, the files in each element of
+ * the path are passed in turn, skipping any which are hidden by a file of
+ * the same name in an earlier element.
+ *
+ * \param *folder		The name of the folder to enumerate.
+ * \param callback		The function to call for each file.
+ * \param *data			Client data to pass to the callback.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool dircache_enumerate(char *folder, dircache_callback callback, void *data);
+
+
+/**
+ * Calculate the hash of a filename. Filenames are not case sensitive, so
+ * neither is the hash.
+ *
+ * \param *name			The name to hash.
+ * \return			The hash value.
+ */
+
+unsigned dircache_hash_name(char *name);
+
+#endif
@@ -0,0 +1,535 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: duplicate.c
+ *
+ * Near-duplicate paper size report implementation.
+ */
+
+/* ANSI C header files */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/* OSLib header files */
+
+#include "oslib/osfile.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/msgs.h"
+#include "sflib/string.h"
+
+/* Application header files */
+
+#include "duplicate.h"
+
+#include "paper.h"
+
+/**
+ * The length of the buffer used to build report lines.
+ */
+
+#define DUPLICATE_LINE_LEN 256
+
+/**
+ * The length of the buffers used to format numbers.
+ */
+
+#define DUPLICATE_NUMBER_LEN 16
+
+/**
+ * The number of millipoints in a millimetre.
+ */
+
+#define DUPLICATE_MILLIPOINTS_PER_MM 2834.645669
+
+/**
+ * A paper definition, normalised for comparison.
+ */
+
+struct duplicate_entry {
+	int			root;				/**< The root holding the definition.				*/
+	int			short_side;			/**< The shorter side of the paper, in millipoints.		*/
+	int			long_side;			/**< The longer side of the paper, in millipoints.		*/
+	int			paper;				/**< The index of the paper definition.				*/
+	int			parent;				/**< The parent entry in the cluster, or itself.		*/
+	int			order;				/**< The position of the entry in size order.			*/
+	int			rank;				/**< The position of the entry in long side order.		*/
+};
+
+/**
+ * The entries being sorted into long side order, for use by the comparison
+ * function.
+ */
+
+static struct duplicate_entry	*duplicate_sort_entries = NULL;
+
+static int	duplicate_compare_sizes(const void *a, const void *b);
+static int	duplicate_compare_clusters(const void *a, const void *b);
+static int	duplicate_compare_long_sides(const void *a, const void *b);
+static void	duplicate_tree_add(int *tree, int size, int rank, int change);
+static int	duplicate_tree_count(int *tree, int rank);
+static int	duplicate_tree_find(int *tree, int size, int position);
+static int	duplicate_find(struct duplicate_entry *entries, int entry);
+static void	duplicate_join(struct duplicate_entry *entries, int a, int b);
+static osbool	duplicate_write_cluster(FILE *out, struct duplicate_entry *entries, int first, int count);
+static void	duplicate_write_line(FILE *out, int indent, char *token, char *a, char *b, char *c, char *d);
+
+
+/**
+ * Write a text report listing the groups of paper definitions in each root
+ * whose sizes are the same to within a tolerance, in either orientation,
+ * but which go by different names.
+ *
+ * \param *filename		The name of the file to be written.
+ * \param tolerance		The tolerance to allow, in millipoints.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool duplicate_write_report(char *filename, int tolerance)
+{
+	FILE			*out;
+	struct duplicate_entry	*entries;
+	struct paper_size	*papers;
+	size_t			paper_count, paper;
+	int			count, entry, window, first, root, clusters, below, neighbour, *by_rank, *tree;
+	char			number[2][DUPLICATE_NUMBER_LEN];
+	osbool			success;
+
+	if (tolerance < 0)
+		tolerance = 0;
+
+	out = fopen(filename, "w");
+	if (out == NULL)
+		return FALSE;
+
+	paper_count = paper_get_definition_count();
+
+	entries = malloc(((paper_count > 0) ? paper_count : 1) * sizeof(struct duplicate_entry));
+	by_rank = malloc(((paper_count > 0) ? paper_count : 1) * sizeof(int));
+	tree = calloc(paper_count + 1, sizeof(int));
+
+	if (entries == NULL || by_rank == NULL || tree == NULL) {
+		free(entries);
+		free(by_rank);
+		free(tree);
+		fclose(out);
+		return FALSE;
+	}
+
+	/* Take the short and long sides of each definition which takes effect,
+	 * ignoring any which are overridden by a higher layer.
+	 */
+
+	papers = paper_get_definitions();
+	count = 0;
+
+	for (paper = 0; paper < paper_count; paper++) {
+		if (papers[paper].shadowed)
+			continue;
+
+		entries[count].root = papers[paper].root;
+		entries[count].short_side = (papers[paper].width < papers[paper].height) ? papers[paper].width : papers[paper].height;
+		entries[count].long_side = (papers[paper].width < papers[paper].height) ? papers[paper].height : papers[paper].width;
+		entries[count].paper = paper;
+		count++;
+	}
+
+	/* Sort the definitions into order of root and then size, so that any
+	 * definitions whose short sides are within the tolerance of each other
+	 * are in a contiguous run, and rank them by their long sides.
+	 */
+
+	qsort(entries, count, sizeof(struct duplicate_entry), duplicate_compare_sizes);
+
+	for (entry = 0; entry < count; entry++) {
+		entries[entry].parent = entry;
+		entries[entry].order = entry;
+		by_rank[entry] = entry;
+	}
+
+	duplicate_sort_entries = entries;
+	qsort(by_rank, count, sizeof(int), duplicate_compare_long_sides);
+
+	for (entry = 0; entry < count; entry++)
+		entries[by_rank[entry]].rank = entry;
+
+	/* Sweep through the list, keeping a window of the earlier entries whose
+	 * short sides are within range in a Fenwick tree indexed by long side
+	 * rank. The window entries with long sides in range below the current
+	 * entry are all within range of each other, so must already be in one
+	 * cluster; the same goes for those above. Joining the current entry to
+	 * its nearest neighbour on each side is therefore enough, and each
+	 * step takes O(log n).
+	 */
+
+	window = 0;
+
+	for (entry = 0; entry < count; entry++) {
+		while (entries[window].root != entries[entry].root || entries[entry].short_side - entries[window].short_side > tolerance)
+			duplicate_tree_add(tree, count, entries[window++].rank, -1);
+
+		below = duplicate_tree_count(tree, entries[entry].rank);
+
+		if (below > 0) {
+			neighbour = by_rank[duplicate_tree_find(tree, count, below)];
+			if (entries[entry].long_side - entries[neighbour].long_side <= tolerance)
+				duplicate_join(entries, neighbour, entry);
+		}
+
+		if (below < entry - window) {
+			neighbour = by_rank[duplicate_tree_find(tree, count, below + 1)];
+			if (entries[neighbour].long_side - entries[entry].long_side <= tolerance)
+				duplicate_join(entries, neighbour, entry);
+		}
+
+		duplicate_tree_add(tree, count, entries[entry].rank, 1);
+	}
+
+	free(by_rank);
+	free(tree);
+
+	/* Gather the members of each cluster together, in size order. */
+
+	for (entry = 0; entry < count; entry++)
+		entries[entry].parent = duplicate_find(entries, entry);
+
+	qsort(entries, count, sizeof(struct duplicate_entry), duplicate_compare_clusters);
+
+	/* Write the report. */
+
+	string_printf(number[0], DUPLICATE_NUMBER_LEN, "%d", tolerance);
+
+	duplicate_write_line(out, 0, "NearTitle", NULL, NULL, NULL, NULL);
+	duplicate_write_line(out, 0, "NearTolerance", number[0], NULL, NULL, NULL);
+
+	root = -1;
+	clusters = 0;
+
+	for (first = 0; first < count; first = entry) {
+		for (entry = first + 1; entry < count && entries[entry].parent == entries[first].parent; entry++);
+
+		if (entry - first < 2)
+			continue;
+
+		/* Clusters are contiguous within each root, so the heading only
+		 * needs to be written when the root changes.
+		 */
+
+		if (entries[first].root != root) {
+			root = entries[first].root;
+			fputc('\n', out);
+			duplicate_write_line(out, 0, "NearRoot", paper_get_root_name(root), NULL, NULL, NULL);
+		}
+
+		if (duplicate_write_cluster(out, entries, first, entry - first))
+			clusters++;
+	}
+
+	string_printf(number[0], DUPLICATE_NUMBER_LEN, "%d", clusters);
+	string_printf(number[1], DUPLICATE_NUMBER_LEN, "%d", count);
+
+	fputc('\n', out);
+	duplicate_write_line(out, 0, "NearSummary", number[0], number[1], NULL, NULL);
+
+	success = (ferror(out) == 0) ? TRUE : FALSE;
+
+	if (fclose(out) != 0)
+		success = FALSE;
+
+	free(entries);
+
+	osfile_set_type(filename, osfile_TYPE_TEXT);
+
+	return success;
+}
+
+
+/**
+ * Compare two entries by root, then by their short and long sides, for
+ * qsort().
+ *
+ * \param *a			Pointer to the first entry.
+ * \param *b			Pointer to the second entry.
+ * \return			The result of the comparison.
+ */
+
+static int duplicate_compare_sizes(const void *a, const void *b)
+{
+	const struct duplicate_entry	*entry_a = a, *entry_b = b;
+
+	if (entry_a->root != entry_b->root)
+		return (entry_a->root < entry_b->root) ? -1 : 1;
+
+	if (entry_a->short_side != entry_b->short_side)
+		return (entry_a->short_side < entry_b->short_side) ? -1 : 1;
+
+	if (entry_a->long_side != entry_b->long_side)
+		return (entry_a->long_side < entry_b->long_side) ? -1 : 1;
+
+	return entry_a->paper - entry_b->paper;
+}
+
+
+/**
+ * Compare two entries by cluster, and then by their position in size
+ * order, for qsort().
+ *
+ * \param *a			Pointer to the first entry.
+ * \param *b			Pointer to the second entry.
+ * \return			The result of the comparison.
+ */
+
+static int duplicate_compare_clusters(const void *a, const void *b)
+{
+	const struct duplicate_entry	*entry_a = a, *entry_b = b;
+
+	if (entry_a->parent != entry_b->parent)
+		return entry_a->parent - entry_b->parent;
+
+	return entry_a->order - entry_b->order;
+}
+
+
+/**
+ * Compare two entries, given by their indexes, by their long sides and then
+ * their position in size order, for qsort().
+ *
+ * \param *a			Pointer to the first index.
+ * \param *b			Pointer to the second index.
+ * \return			The result of the comparison.
+ */
+
+static int duplicate_compare_long_sides(const void *a, const void *b)
+{
+	const struct duplicate_entry	*entry_a = duplicate_sort_entries + *((const int *) a);
+	const struct duplicate_entry	*entry_b = duplicate_sort_entries + *((const int *) b);
+
+	if (entry_a->long_side != entry_b->long_side)
+		return (entry_a->long_side < entry_b->long_side) ? -1 : 1;
+
+	return entry_a->order - entry_b->order;
+}
+
+
+/**
+ * Add or remove an entry in the window's Fenwick tree.
+ *
+ * \param *tree			The tree, with size + 1 elements.
+ * \param size			The number of ranks in the tree.
+ * \param rank			The long side rank of the entry.
+ * \param change		1 to add the entry, or -1 to remove it.
+ */
+
+static void duplicate_tree_add(int *tree, int size, int rank, int change)
+{
+	for (rank++; rank <= size; rank += rank & -rank)
+		tree[rank] += change;
+}
+
+
+/**
+ * Count the entries in the window's Fenwick tree with a lower rank than
+ * the one given.
+ *
+ * \param *tree			The tree.
+ * \param rank			The rank to count below.
+ * \return			The number of entries.
+ */
+
+static int duplicate_tree_count(int *tree, int rank)
+{
+	int	count = 0;
+
+	for (; rank > 0; rank -= rank & -rank)
+		count += tree[rank];
+
+	return count;
+}
+
+
+/**
+ * Find the rank of the entry at a given position in the window's Fenwick
+ * tree, counting from 1 in long side order.
+ *
+ * \param *tree			The tree, with size + 1 elements.
+ * \param size			The number of ranks in the tree.
+ * \param position		The position of the entry to find.
+ * \return			The rank of the entry.
+ */
+
+static int duplicate_tree_find(int *tree, int size, int position)
+{
+	int	rank = 0, step;
+
+	for (step = 1; step * 2 <= size; step *= 2);
+
+	for (; step > 0; step /= 2) {
+		if (rank + step <= size && tree[rank + step] < position) {
+			rank += step;
+			position -= tree[rank];
+		}
+	}
+
+	return rank;
+}
+
+
+/**
+ * Find the entry which represents the cluster containing an entry, halving
+ * the path to it on the way.
+ *
+ * \param *entries		The array of entries.
+ * \param entry			The entry to look up.
+ * \return			The representative entry of its cluster.
+ */
+
+static int duplicate_find(struct duplicate_entry *entries, int entry)
+{
+	while (entries[entry].parent != entry) {
+		entries[entry].parent = entries[entries[entry].parent].parent;
+		entry = entries[entry].parent;
+	}
+
+	return entry;
+}
+
+
+/**
+ * Join the clusters containing two entries. The representative is always
+ * the earlier entry in size order, so that clusters stay grouped by root.
+ *
+ * \param *entries		The array of entries.
+ * \param a			The first entry to join.
+ * \param b			The second entry to join.
+ */
+
+static void duplicate_join(struct duplicate_entry *entries, int a, int b)
+{
+	a = duplicate_find(entries, a);
+	b = duplicate_find(entries, b);
+
+	if (a < b)
+		entries[b].parent = a;
+	else if (b < a)
+		entries[a].parent = b;
+}
+
+
+/**
+ * Write the section of the report for a single cluster, if the definitions
+ * in it go by more than one name.
+ *
+ * \param *out			The file to write to.
+ * \param *entries		The array of entries.
+ * \param first			The first entry in the cluster.
+ * \param count			The number of entries in the cluster.
+ * \return			TRUE if the cluster was written; else FALSE.
+ */
+
+static osbool duplicate_write_cluster(FILE *out, struct duplicate_entry *entries, int first, int count)
+{
+	struct paper_size	*papers;
+	int			entry, spread;
+	osbool			names, landscape;
+	char			number[2][DUPLICATE_NUMBER_LEN];
+
+	/* The file may have claimed memory since the pointer was last taken,
+	 * so look the definitions up again.
+	 */
+
+	papers = paper_get_definitions();
+
+	/* Definitions of the same name are left to the overlay index. Find the
+	 * spread of sizes, which is zero if all of the sizes are identical.
+	 */
+
+	names = FALSE;
+	spread = 0;
+
+	for (entry = first + 1; entry < first + count; entry++) {
+		if (string_nocase_strcmp(papers[entries[entry].paper].name, papers[entries[first].paper].name) != 0)
+			names = TRUE;
+
+		if (entries[entry].short_side - entries[first].short_side > spread)
+			spread = entries[entry].short_side - entries[first].short_side;
+
+		if (abs(entries[entry].long_side - entries[first].long_side) > spread)
+			spread = abs(entries[entry].long_side - entries[first].long_side);
+	}
+
+	if (!names)
+		return FALSE;
+
+	string_printf(number[0], DUPLICATE_NUMBER_LEN, "%d", count);
+	string_printf(number[1], DUPLICATE_NUMBER_LEN, "%d", spread);
+
+	duplicate_write_line(out, 1, (spread == 0) ? "NearExact" : "NearGroup", number[0], number[1], NULL, NULL);
+
+	/* Flag any definitions which are the other way up to the first. */
+
+	landscape = (papers[entries[first].paper].width > papers[entries[first].paper].height) ? TRUE : FALSE;
+
+	for (entry = first; entry < first + count; entry++) {
+		papers = paper_get_definitions();
+
+		string_printf(number[0], DUPLICATE_NUMBER_LEN, "%.2f", papers[entries[entry].paper].width / DUPLICATE_MILLIPOINTS_PER_MM);
+		string_printf(number[1], DUPLICATE_NUMBER_LEN, "%.2f", papers[entries[entry].paper].height / DUPLICATE_MILLIPOINTS_PER_MM);
+
+		duplicate_write_line(out, 2, ((papers[entries[entry].paper].width > papers[entries[entry].paper].height) != landscape) ? "NearRotated" : "NearEntry",
+				papers[entries[entry].paper].name, number[0], number[1], NULL);
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Look up a report line from the messages file and write it out.
+ *
+ * \param *out			The file to write to.
+ * \param indent		The level of indent to apply to the line.
+ * \param *token		The token for the line.
+ * \param *a			The first parameter, or NULL.
+ * \param *b			The second parameter, or NULL.
+ * \param *c			The third parameter, or NULL.
+ * \param *d			The fourth parameter, or NULL.
+ */
+
+static void duplicate_write_line(FILE *out, int indent, char *token, char *a, char *b, char *c, char *d)
+{
+	char	line[DUPLICATE_LINE_LEN];
+
+	msgs_param_lookup(token, line, DUPLICATE_LINE_LEN, a, b, c, d);
+	line[DUPLICATE_LINE_LEN - 1] = '\0';
+
+	while (indent-- > 0)
+		fputs("  ", out);
+
+	fputs(line, out);
+	fputc('\n', out);
+}
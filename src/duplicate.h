@@ -0,0 +1,48 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: duplicate.h
+ *
+ * Near-duplicate paper size report interface.
+ */
+
+#ifndef PS2PAPER_DUPLICATE
+#define PS2PAPER_DUPLICATE
+
+#include "oslib/types.h"
+
+
+/**
+ * Write a text report listing the groups of paper definitions in each root
+ * whose sizes are the same to within a tolerance, in either orientation,
+ * but which go by different names.
+ *
+ * \param *filename		The name of the file to be written.
+ * \param tolerance		The tolerance to allow, in millipoints.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool duplicate_write_report(char *filename, int tolerance);
+
+#endif
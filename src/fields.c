@@ -0,0 +1,376 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: fields.c
+ *
+ * Paper definition field store implementation.
+ *
+ * The fields from the definition files which aren't held directly in the
+ * paper definitions are kept here, in column order: an array of interned
+ * key numbers, an array of offsets into a shared pool of value strings, and
+ * the pool itself. Each definition refers to a contiguous run of fields, so
+ * there is no per-field overhead beyond the key number and the offset.
+ * The interned key names are held in a pool of their own, which grows as
+ * required so that there is no limit on the length of a key.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Acorn C header files */
+
+#include "flex.h"
+
+/* OSLib header files */
+
+#include "oslib/types.h"
+
+/* Application header files */
+
+#include "fields.h"
+
+/**
+ * The maximum number of distinct key names which can be interned.
+ */
+
+#define FIELDS_MAX_KEYS 255
+
+/**
+ * The number of bytes of key name pool that we allocate on each change.
+ */
+
+#define FIELDS_KEY_POOL_ALLOCATION 256
+
+/**
+ * The number of field spaces that we allocate on each change.
+ */
+
+#define FIELDS_ALLOCATION 64
+
+/**
+ * The number of bytes of value pool that we allocate on each change.
+ */
+
+#define FIELDS_POOL_ALLOCATION 1024
+
+static size_t		fields_keys[FIELDS_MAX_KEYS];	/**< The offset of each interned key name in the key pool.	*/
+static int		fields_key_count = 0;		/**< The number of interned key names.				*/
+
+static char		*fields_key_pool = NULL;	/**< The pool of interned key names.				*/
+static size_t		fields_key_pool_used = 0;	/**< The number of bytes used in the key pool.			*/
+static size_t		fields_key_pool_allocation = 0;	/**< The number of bytes allocated to the key pool.		*/
+
+static unsigned char	*fields_key = NULL;		/**< The key number of each field.				*/
+static unsigned		*fields_value = NULL;		/**< The offset of each field's value in the pool.		*/
+static int		fields_count = 0;		/**< The number of fields in the store.				*/
+static int		fields_allocation = 0;		/**< The number of fields allocated.				*/
+
+static char		*fields_pool = NULL;		/**< The pool of value strings.					*/
+static size_t		fields_pool_used = 0;		/**< The number of bytes used in the pool.			*/
+static size_t		fields_pool_allocation = 0;	/**< The number of bytes allocated to the pool.			*/
+
+static int		fields_rejected = 0;		/**< The number of fields which couldn't be stored.		*/
+
+static int		fields_intern_key(char *key, osbool add);
+static osbool		fields_allocate(int new_allocation);
+
+
+/**
+ * Initialise the field store.
+ */
+
+void fields_initialise(void)
+{
+	if (flex_alloc((flex_ptr) &fields_key, 4) == 0)
+		fields_key = NULL;
+
+	if (flex_alloc((flex_ptr) &fields_value, 4) == 0)
+		fields_value = NULL;
+
+	if (flex_alloc((flex_ptr) &fields_pool, 4) == 0)
+		fields_pool = NULL;
+
+	fields_reset();
+}
+
+
+/**
+ * Discard all of the stored fields. The interned key names are kept, so
+ * that they retain the same identities across loads.
+ */
+
+void fields_reset(void)
+{
+	fields_count = 0;
+	fields_rejected = 0;
+	fields_allocation = 0;
+	fields_pool_used = 0;
+	fields_pool_allocation = 0;
+
+	if (fields_key == NULL || fields_value == NULL || fields_pool == NULL)
+		return;
+
+	flex_extend((flex_ptr) &fields_key, 4);
+	flex_extend((flex_ptr) &fields_value, 4);
+	flex_extend((flex_ptr) &fields_pool, 4);
+}
+
+
+/**
+ * Add a field to the end of the store.
+ *
+ * \param *key			The key name of the field.
+ * \param *value		The value of the field.
+ * \return			The index of the new field, or FIELDS_NONE.
+ */
+
+int fields_add(char *key, char *value)
+{
+	int	id;
+	size_t	length, allocation;
+
+	id = fields_intern_key(key, TRUE);
+	if (id == FIELDS_NONE || !fields_allocate(fields_count + 1)) {
+		fields_rejected++;
+		return FIELDS_NONE;
+	}
+
+	length = strlen(value) + 1;
+
+	if (fields_pool_used + length > fields_pool_allocation) {
+		allocation = ((fields_pool_used + length) / FIELDS_POOL_ALLOCATION + 1) * FIELDS_POOL_ALLOCATION;
+
+		if (flex_extend((flex_ptr) &fields_pool, allocation) == 0) {
+			fields_rejected++;
+			return FIELDS_NONE;
+		}
+
+		fields_pool_allocation = allocation;
+	}
+
+	memcpy(fields_pool + fields_pool_used, value, length);
+
+	fields_key[fields_count] = id;
+	fields_value[fields_count] = fields_pool_used;
+	fields_pool_used += length;
+
+	return fields_count++;
+}
+
+
+/**
+ * Append a copy of a run of existing fields to the end of the store. The
+ * values are shared with the original fields, so only the keys and value
+ * references are copied.
+ *
+ * \param first			The index of the first field to copy.
+ * \param count			The number of fields to copy.
+ * \return			The index of the first new field, or FIELDS_NONE.
+ */
+
+int fields_copy(int first, int count)
+{
+	int	start, field;
+
+	if (first < 0 || count <= 0 || first + count > fields_count)
+		return FIELDS_NONE;
+
+	if (!fields_allocate(fields_count + count))
+		return FIELDS_NONE;
+
+	start = fields_count;
+
+	for (field = first; field < first + count; field++) {
+		fields_key[fields_count] = fields_key[field];
+		fields_value[fields_count] = fields_value[field];
+		fields_count++;
+	}
+
+	return start;
+}
+
+
+/**
+ * Return the number of fields in the store.
+ *
+ * \return			The number of fields.
+ */
+
+int fields_get_count(void)
+{
+	return fields_count;
+}
+
+
+/**
+ * Return the number of fields which couldn't be stored since the store
+ * was last reset, because there was no memory or no space for their keys.
+ *
+ * \return			The number of rejected fields.
+ */
+
+int fields_get_rejected_count(void)
+{
+	return fields_rejected;
+}
+
+
+/**
+ * Find a field with a given key name within a run of fields.
+ *
+ * \param first			The index of the first field to search.
+ * \param count			The number of fields to search.
+ * \param *key			The key name to look for.
+ * \return			The index of the field, or FIELDS_NONE.
+ */
+
+int fields_find(int first, int count, char *key)
+{
+	int	id, field;
+
+	id = fields_intern_key(key, FALSE);
+	if (id == FIELDS_NONE || first < 0)
+		return FIELDS_NONE;
+
+	for (field = first; field < first + count && field < fields_count; field++) {
+		if (fields_key[field] == id)
+			return field;
+	}
+
+	return FIELDS_NONE;
+}
+
+
+/**
+ * Return the key name of a field. The pointer will not remain valid if a
+ * new key name is added to the store.
+ *
+ * \param field			The index of the field.
+ * \return			Pointer to the key name, or NULL.
+ */
+
+char *fields_get_key(int field)
+{
+	if (field < 0 || field >= fields_count || fields_key_pool == NULL)
+		return NULL;
+
+	return fields_key_pool + fields_keys[fields_key[field]];
+}
+
+
+/**
+ * Return the value of a field. This points into a flex heap, so the pointer
+ * will not remain valid if anything causes the heap to shift.
+ *
+ * \param field			The index of the field.
+ * \return			Pointer to the value, or NULL.
+ */
+
+char *fields_get_value(int field)
+{
+	if (field < 0 || field >= fields_count)
+		return NULL;
+
+	return fields_pool + fields_value[field];
+}
+
+
+/**
+ * Find the number of an interned key name, optionally adding it to the
+ * table if it hasn't been seen before. The definition files only use a
+ * handful of short keys, so a simple search is all that's needed.
+ *
+ * \param *key			The key name to look up.
+ * \param add			TRUE to add the key if it isn't found.
+ * \return			The key number, or FIELDS_NONE.
+ */
+
+static int fields_intern_key(char *key, osbool add)
+{
+	int	id;
+	size_t	length, allocation;
+	char	*pool;
+
+	if (key == NULL || *key == '\0')
+		return FIELDS_NONE;
+
+	for (id = 0; id < fields_key_count; id++) {
+		if (strcmp(fields_key_pool + fields_keys[id], key) == 0)
+			return id;
+	}
+
+	if (!add || fields_key_count >= FIELDS_MAX_KEYS)
+		return FIELDS_NONE;
+
+	length = strlen(key) + 1;
+
+	if (fields_key_pool_used + length > fields_key_pool_allocation) {
+		allocation = ((fields_key_pool_used + length) / FIELDS_KEY_POOL_ALLOCATION + 1) * FIELDS_KEY_POOL_ALLOCATION;
+
+		pool = realloc(fields_key_pool, allocation);
+		if (pool == NULL)
+			return FIELDS_NONE;
+
+		fields_key_pool = pool;
+		fields_key_pool_allocation = allocation;
+	}
+
+	memcpy(fields_key_pool + fields_key_pool_used, key, length);
+
+	fields_keys[fields_key_count] = fields_key_pool_used;
+	fields_key_pool_used += length;
+
+	return fields_key_count++;
+}
+
+
+/**
+ * Claim additional storage space for the field columns.
+ *
+ * \param new_allocation	The number of fields required.
+ * \return			TRUE if successful; FALSE if allocation failed.
+ */
+
+static osbool fields_allocate(int new_allocation)
+{
+	if (fields_key == NULL || fields_value == NULL || fields_pool == NULL)
+		return FALSE;
+
+	if (new_allocation <= fields_allocation)
+		return TRUE;
+
+	new_allocation = ((new_allocation / FIELDS_ALLOCATION) + 1) * FIELDS_ALLOCATION;
+
+	if (flex_extend((flex_ptr) &fields_key, new_allocation * sizeof(unsigned char)) == 0)
+		return FALSE;
+
+	if (flex_extend((flex_ptr) &fields_value, new_allocation * sizeof(unsigned)) == 0)
+		return FALSE;
+
+	fields_allocation = new_allocation;
+
+	return TRUE;
+}
@@ -0,0 +1,133 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: fields.h
+ *
+ * Paper definition field store interface.
+ */
+
+#ifndef PS2PAPER_FIELDS
+#define PS2PAPER_FIELDS
+
+#include "oslib/types.h"
+
+/**
+ * A value indicating that there is no field.
+ */
+
+#define FIELDS_NONE (-1)
+
+
+/**
+ * Initialise the field store.
+ */
+
+void fields_initialise(void);
+
+
+/**
+ * Discard all of the stored fields. The interned key names are kept, so
+ * that they retain the same identities across loads.
+ */
+
+void fields_reset(void);
+
+
+/**
+ * Add a field to the end of the store.
+ *
+ * \param *key			The key name of the field.
+ * \param *value		The value of the field.
+ * \return			The index of the new field, or FIELDS_NONE.
+ */
+
+int fields_add(char *key, char *value);
+
+
+/**
+ * Append a copy of a run of existing fields to the end of the store. The
+ * values are shared with the original fields, so only the keys and value
+ * references are copied.
+ *
+ * \param first			The index of the first field to copy.
+ * \param count			The number of fields to copy.
+ * \return			The index of the first new field, or FIELDS_NONE.
+ */
+
+int fields_copy(int first, int count);
+
+
+/**
+ * Return the number of fields in the store.
+ *
+ * \return			The number of fields.
+ */
+
+int fields_get_count(void);
+
+
+/**
+ * Return the number of fields which couldn't be stored since the store
+ * was last reset, because there was no memory or no space for their keys.
+ *
+ * \return			The number of rejected fields.
+ */
+
+int fields_get_rejected_count(void);
+
+
+/**
+ * Find a field with a given key name within a run of fields.
+ *
+ * \param first			The index of the first field to search.
+ * \param count			The number of fields to search.
+ * \param *key			The key name to look for.
+ * \return			The index of the field, or FIELDS_NONE.
+ */
+
+int fields_find(int first, int count, char *key);
+
+
+/**
+ * Return the key name of a field. The pointer will not remain valid if a
+ * new key name is added to the store.
+ *
+ * \param field			The index of the field.
+ * \return			Pointer to the key name, or NULL.
+ */
+
+char *fields_get_key(int field);
+
+
+/**
+ * Return the value of a field. This points into a flex heap, so the pointer
+ * will not remain valid if anything causes the heap to shift.
+ *
+ * \param field			The index of the field.
+ * \return			Pointer to the value, or NULL.
+ */
+
+char *fields_get_value(int field);
+
+#endif
@@ -29,11 +29,16 @@
 
 /* ANSI C header files */
 
+#include <stdlib.h>
+#include <string.h>
+
 /* Acorn C header files */
 
 /* OSLib header files */
 
+#include "oslib/os.h"
 #include "oslib/wimp.h"
+#include "oslib/wimptextop.h"
 
 /* SF-Lib header files. */
 
@@ -54,6 +59,10 @@
 #include "list.h"
 #include "main.h"
 
+#ifdef TRACE
+#include "trace.h"
+#endif
+
 #define URL_LENGTH 256
 
 /* Iconbar menu */
@@ -62,6 +71,19 @@
 #define ICONBAR_MENU_HELP 1
 #define ICONBAR_MENU_QUIT 2
 
+#ifdef TRACE
+
+/* The Save trace entry, which is added to traced builds. */
+
+#define ICONBAR_MENU_TRACE 3
+#define ICONBAR_TRACE_ENTRY_LEN 32
+
+/* The file used to save the event trace. */
+
+#define ICONBAR_TRACE_FILE "<Wimp$ScrapDir>.PS2Trace"
+
+#endif
+
 /* Program Info Window */
 
 #define ICON_PROGINFO_AUTHOR  4
@@ -73,6 +95,10 @@ static void	iconbar_click_handler(wimp_pointer *pointer);
 static void	iconbar_menu_prepare(wimp_w w, wimp_menu *menu, wimp_pointer *pointer);
 static void	iconbar_menu_selection(wimp_w w, wimp_menu *menu, wimp_selection *selection);
 static osbool	iconbar_proginfo_web_click(wimp_pointer *pointer);
+#ifdef TRACE
+static void	iconbar_add_trace_entry(void);
+static void	iconbar_save_trace(void);
+#endif
 
 
 static wimp_menu	*iconbar_menu = NULL;					/**< The iconbar menu handle.			*/
@@ -89,10 +115,15 @@ void iconbar_initialise(void)
 	wimp_icon_create	icon_bar;
 
 	iconbar_menu = templates_get_menu("IconBarMenu");
-	ihelp_add_menu(iconbar_menu, "IconBarMenu");
 
 	iconbar_info_window = templates_create_window("ProgInfo");
 	templates_link_menu_dialogue("ProgInfo", iconbar_info_window);
+
+#ifdef TRACE
+	iconbar_add_trace_entry();
+#endif
+
+	ihelp_add_menu(iconbar_menu, "IconBarMenu");
 	ihelp_add_window(iconbar_info_window, "ProgInfo", NULL);
 	icons_msgs_param_lookup(iconbar_info_window, ICON_PROGINFO_VERSION, "Version",
 			BUILD_VERSION, date, NULL, NULL);
@@ -174,9 +205,76 @@ static void iconbar_menu_selection(wimp_w w, wimp_menu *menu, wimp_selection *se
 	case ICONBAR_MENU_QUIT:
 		main_quit_flag = TRUE;
 		break;
+
+#ifdef TRACE
+	case ICONBAR_MENU_TRACE:
+		iconbar_save_trace();
+		break;
+#endif
+	}
+}
+
+
+#ifdef TRACE
+
+/**
+ * Add a Save trace entry to the end of the iconbar menu, by replacing it
+ * with an extended copy.
+ */
+
+static void iconbar_add_trace_entry(void)
+{
+	wimp_menu	*menu;
+	char		*text;
+	int		width;
+
+	menu = malloc(wimp_SIZEOF_MENU(ICONBAR_MENU_TRACE + 1) + ICONBAR_TRACE_ENTRY_LEN);
+	if (menu == NULL)
+		return;
+
+	memcpy(menu, iconbar_menu, wimp_SIZEOF_MENU(ICONBAR_MENU_TRACE));
+
+	text = (char *) menu + wimp_SIZEOF_MENU(ICONBAR_MENU_TRACE + 1);
+	msgs_lookup("TraceEntry", text, ICONBAR_TRACE_ENTRY_LEN);
+
+	menu->entries[ICONBAR_MENU_QUIT].menu_flags = (menu->entries[ICONBAR_MENU_QUIT].menu_flags & ~wimp_MENU_LAST) | wimp_MENU_SEPARATE;
+
+	menu->entries[ICONBAR_MENU_TRACE].menu_flags = wimp_MENU_LAST;
+	menu->entries[ICONBAR_MENU_TRACE].sub_menu = wimp_NO_SUB_MENU;
+	menu->entries[ICONBAR_MENU_TRACE].icon_flags = wimp_ICON_TEXT | wimp_ICON_FILLED | wimp_ICON_INDIRECTED |
+			(wimp_COLOUR_BLACK << wimp_ICON_FG_COLOUR_SHIFT) | (wimp_COLOUR_WHITE << wimp_ICON_BG_COLOUR_SHIFT);
+	menu->entries[ICONBAR_MENU_TRACE].data.indirected_text.text = text;
+	menu->entries[ICONBAR_MENU_TRACE].data.indirected_text.validation = (char *) -1;
+	menu->entries[ICONBAR_MENU_TRACE].data.indirected_text.size = ICONBAR_TRACE_ENTRY_LEN;
+
+	if (xwimptextop_string_width(text, 0, &width) == NULL && width + 16 > menu->width)
+		menu->width = width + 16;
+
+	iconbar_menu = menu;
+}
+
+
+/**
+ * Save the contents of the event trace buffer to a text file in the
+ * scrap folder, then open it.
+ */
+
+static void iconbar_save_trace(void)
+{
+	os_error	*error;
+
+	if (!trace_dump(ICONBAR_TRACE_FILE)) {
+		error_msgs_report_error("ExportFail");
+		return;
 	}
+
+	error = xos_cli("%Filer_Run " ICONBAR_TRACE_FILE);
+	if (error != NULL)
+		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
 }
 
+#endif
+
 
 /**
  * Handle clicks on the Website action button in the program info window.
@@ -0,0 +1,311 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: journal.c
+ *
+ * Paper definition change journal implementation.
+ *
+ * At the end of each complete load, a fingerprint is taken of every paper
+ * definition: a hash of its root, source and name, along with its size and
+ * snippet status. The fingerprints are held in a hash index, so that the
+ * definitions from the next load can be matched up against them in a single
+ * pass and the differences flagged for display.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+
+/* OSLib header files */
+
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/string.h"
+
+/* Application header files */
+
+#include "journal.h"
+
+#include "dircache.h"
+#include "paper.h"
+
+/**
+ * The minimum number of slots in the fingerprint index; this is always a
+ * power of two.
+ */
+
+#define JOURNAL_INDEX_MIN_SIZE 64
+
+/**
+ * An empty slot in the fingerprint index.
+ */
+
+#define JOURNAL_INDEX_EMPTY (-1)
+
+/**
+ * The fingerprint of a paper definition.
+ */
+
+struct journal_fingerprint {
+	unsigned		key;				/**< The hash of the definition's root, source and name.	*/
+	char			name[PAPER_NAME_LEN];		/**< The name of the definition.				*/
+	int			root;				/**< The root holding the definition.				*/
+	enum paper_source	source;				/**< The source of the definition.				*/
+	int			width;				/**< The width of the paper, in millipoints.			*/
+	int			height;				/**< The height of the paper, in millipoints.			*/
+	enum paper_file_status	status;				/**< The status of the snippet file.				*/
+	osbool			matched;			/**< TRUE if matched by a definition in the current load.	*/
+};
+
+static struct journal_fingerprint	*journal_fingerprints = NULL;	/**< The fingerprints from the previous load.		*/
+static size_t				journal_count = 0;		/**< The number of fingerprints.			*/
+
+static int				*journal_index = NULL;		/**< Hash index of the fingerprints by key.		*/
+static unsigned				journal_index_size = 0;		/**< The number of slots in the fingerprint index.	*/
+
+static osbool				journal_valid = FALSE;		/**< TRUE if the summary holds a valid comparison.	*/
+static unsigned				journal_added = 0;		/**< The number of definitions added.			*/
+static unsigned				journal_removed = 0;		/**< The number of definitions removed.			*/
+static unsigned				journal_changed = 0;		/**< The number of definitions changed.			*/
+
+static void		journal_take_fingerprint(struct paper_size *paper, struct journal_fingerprint *fingerprint);
+static int		journal_find(struct journal_fingerprint *fingerprint);
+static osbool		journal_build_index(void);
+
+
+/**
+ * Forget the summary of the last comparison, ready for a new load. The
+ * fingerprints from the last completed load are kept for comparison.
+ */
+
+void journal_reset(void)
+{
+	journal_valid = FALSE;
+}
+
+
+/**
+ * Compare the paper definitions from a newly completed load against the
+ * fingerprints taken at the end of the previous one, flagging the changes
+ * on each definition, and then take a new set of fingerprints.
+ */
+
+void journal_update(void)
+{
+	struct journal_fingerprint	*fingerprints;
+	struct paper_size		*papers;
+	size_t				count, paper;
+	int				previous;
+
+	count = paper_get_definition_count();
+
+	fingerprints = malloc(((count > 0) ? count : 1) * sizeof(struct journal_fingerprint));
+
+	journal_added = 0;
+	journal_removed = 0;
+	journal_changed = 0;
+
+	/* Match each definition up against the previous load, if there was
+	 * one, and flag up the differences. The definitions are in a flex
+	 * block, so only take the pointer now that the memory has been claimed.
+	 */
+
+	papers = paper_get_definitions();
+
+	for (paper = 0; paper < count; paper++) {
+		if (fingerprints != NULL)
+			journal_take_fingerprint(papers + paper, fingerprints + paper);
+
+		papers[paper].changes = JOURNAL_CHANGE_NONE;
+
+		if (journal_index == NULL || fingerprints == NULL)
+			continue;
+
+		previous = journal_find(fingerprints + paper);
+
+		if (previous == JOURNAL_INDEX_EMPTY) {
+			papers[paper].changes = JOURNAL_CHANGE_ADDED;
+			journal_added++;
+			continue;
+		}
+
+		journal_fingerprints[previous].matched = TRUE;
+
+		if (journal_fingerprints[previous].width != papers[paper].width || journal_fingerprints[previous].height != papers[paper].height)
+			papers[paper].changes |= JOURNAL_CHANGE_SIZE;
+
+		if (journal_fingerprints[previous].status != papers[paper].ps2_file_status)
+			papers[paper].changes |= JOURNAL_CHANGE_STATUS;
+
+		if (papers[paper].changes != JOURNAL_CHANGE_NONE)
+			journal_changed++;
+	}
+
+	/* Anything which wasn't matched has been removed. */
+
+	journal_valid = (journal_index != NULL && fingerprints != NULL) ? TRUE : FALSE;
+
+	if (journal_valid) {
+		for (previous = 0; previous < journal_count; previous++) {
+			if (!journal_fingerprints[previous].matched)
+				journal_removed++;
+		}
+	}
+
+	/* Replace the old fingerprints with the new ones. */
+
+	free(journal_fingerprints);
+	journal_fingerprints = fingerprints;
+	journal_count = (fingerprints != NULL) ? count : 0;
+
+	journal_build_index();
+}
+
+
+/**
+ * Return a summary of the changes found by the last comparison.
+ *
+ * \param *added		Pointer to variable to take the number of
+ *				definitions added, or NULL.
+ * \param *removed		Pointer to variable to take the number of
+ *				definitions removed, or NULL.
+ * \param *changed		Pointer to variable to take the number of
+ *				definitions changed in size or status, or NULL.
+ * \return			TRUE if a comparison is available; FALSE if
+ *				there was no previous load to compare against.
+ */
+
+osbool journal_get_summary(unsigned *added, unsigned *removed, unsigned *changed)
+{
+	if (added != NULL)
+		*added = journal_added;
+
+	if (removed != NULL)
+		*removed = journal_removed;
+
+	if (changed != NULL)
+		*changed = journal_changed;
+
+	return journal_valid;
+}
+
+
+/**
+ * Take the fingerprint of a paper definition.
+ *
+ * \param *paper		The definition to take the fingerprint of.
+ * \param *fingerprint		Pointer to the fingerprint to fill in.
+ */
+
+static void journal_take_fingerprint(struct paper_size *paper, struct journal_fingerprint *fingerprint)
+{
+	fingerprint->key = dircache_hash_name(paper->name) + (paper->root * 0x9e3779b9u) + (paper->source * 0x85ebca6bu);
+	string_copy(fingerprint->name, paper->name, PAPER_NAME_LEN);
+	fingerprint->root = paper->root;
+	fingerprint->source = paper->source;
+	fingerprint->width = paper->width;
+	fingerprint->height = paper->height;
+	fingerprint->status = paper->ps2_file_status;
+	fingerprint->matched = FALSE;
+}
+
+
+/**
+ * Find the first unmatched fingerprint from the previous load with the same
+ * identity as a new one, so that repeated definitions of a name are paired
+ * up in turn.
+ *
+ * \param *fingerprint		The fingerprint to look up.
+ * \return			The index of the matching fingerprint, or
+ *				JOURNAL_INDEX_EMPTY if there is none.
+ */
+
+static int journal_find(struct journal_fingerprint *fingerprint)
+{
+	unsigned			slot;
+	int				previous;
+	struct journal_fingerprint	*test;
+
+	slot = fingerprint->key & (journal_index_size - 1);
+
+	while ((previous = journal_index[slot]) != JOURNAL_INDEX_EMPTY) {
+		test = journal_fingerprints + previous;
+
+		if (!test->matched && test->key == fingerprint->key && test->root == fingerprint->root && test->source == fingerprint->source &&
+				string_nocase_strcmp(test->name, fingerprint->name) == 0)
+			return previous;
+
+		slot = (slot + 1) & (journal_index_size - 1);
+	}
+
+	return JOURNAL_INDEX_EMPTY;
+}
+
+
+/**
+ * Build the hash index of the current fingerprints, replacing any existing
+ * index. If there isn't enough memory, the index is left empty and the next
+ * load won't be compared.
+ *
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool journal_build_index(void)
+{
+	unsigned	size, slot;
+	size_t		fingerprint;
+
+	free(journal_index);
+	journal_index = NULL;
+	journal_index_size = 0;
+
+	if (journal_fingerprints == NULL)
+		return FALSE;
+
+	/* Keep the index no more than half full, so that the probes stay short. */
+
+	for (size = JOURNAL_INDEX_MIN_SIZE; size < journal_count * 2; size *= 2);
+
+	journal_index = malloc(size * sizeof(int));
+	if (journal_index == NULL)
+		return FALSE;
+
+	journal_index_size = size;
+
+	for (slot = 0; slot < size; slot++)
+		journal_index[slot] = JOURNAL_INDEX_EMPTY;
+
+	for (fingerprint = 0; fingerprint < journal_count; fingerprint++) {
+		slot = journal_fingerprints[fingerprint].key & (size - 1);
+
+		while (journal_index[slot] != JOURNAL_INDEX_EMPTY)
+			slot = (slot + 1) & (size - 1);
+
+		journal_index[slot] = fingerprint;
+	}
+
+	return TRUE;
+}
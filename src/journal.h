@@ -0,0 +1,78 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: journal.h
+ *
+ * Paper definition change journal interface.
+ */
+
+#ifndef PS2PAPER_JOURNAL
+#define PS2PAPER_JOURNAL
+
+#include "oslib/types.h"
+
+/**
+ * The flags used to record how a paper definition has changed since the
+ * previous load.
+ */
+
+#define JOURNAL_CHANGE_NONE 0x00u
+#define JOURNAL_CHANGE_ADDED 0x01u
+#define JOURNAL_CHANGE_SIZE 0x02u
+#define JOURNAL_CHANGE_STATUS 0x04u
+
+
+/**
+ * Forget the summary of the last comparison, ready for a new load. The
+ * fingerprints from the last completed load are kept for comparison.
+ */
+
+void journal_reset(void);
+
+
+/**
+ * Compare the paper definitions from a newly completed load against the
+ * fingerprints taken at the end of the previous one, flagging the changes
+ * on each definition, and then take a new set of fingerprints.
+ */
+
+void journal_update(void);
+
+
+/**
+ * Return a summary of the changes found by the last comparison.
+ *
+ * \param *added		Pointer to variable to take the number of
+ *				definitions added, or NULL.
+ * \param *removed		Pointer to variable to take the number of
+ *				definitions removed, or NULL.
+ * \param *changed		Pointer to variable to take the number of
+ *				definitions changed in size or status, or NULL.
+ * \return			TRUE if a comparison is available; FALSE if
+ *				there was no previous load to compare against.
+ */
+
+osbool journal_get_summary(unsigned *added, unsigned *removed, unsigned *changed);
+
+#endif
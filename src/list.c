@@ -41,9 +41,11 @@
 
 #include "oslib/osspriteop.h"
 #include "oslib/wimp.h"
+#include "oslib/wimptextop.h"
 
 /* SF-Lib header files. */
 
+#include "sflib/config.h"
 #include "sflib/errors.h"
 #include "sflib/event.h"
 #include "sflib/icons.h"
@@ -58,8 +60,15 @@
 
 #include "list.h"
 
+#include "audit.h"
 #include "columns.h"
+#include "duplicate.h"
+#include "journal.h"
 #include "paper.h"
+#include "queue.h"
+#include "snippet.h"
+#include "standard.h"
+#include "trace.h"
 
 /* The page dimensions. */
 
@@ -73,7 +82,9 @@
 /* Memory allocation. */
 
 #define LIST_ICON_BUFFER_LEN 128					/**< The scratch buffer used for formatting text for display.		*/
+#define LIST_NUMBER_BUFFER_LEN 16					/**< The scratch buffer used for formatting numbers for display.	*/
 #define LIST_SELECT_MENU_LEN 150					/**< The amount of space allocated for the selection menu item.		*/
+#define LIST_EDIT_MENU_LEN 20						/**< The amount of space allocated for the width and height fields.	*/
 
 /* The main window icons. */
 
@@ -109,15 +120,90 @@
 #define LIST_MENU_SELECT_ALL 1
 #define LIST_MENU_CLEAR_SELECTION 2
 #define LIST_MENU_DIMENSION_UNITS 3
-#define LIST_MENU_REFRESH 4
+#define LIST_MENU_ROOTS 4
+#define LIST_MENU_REFRESH 5
+#define LIST_MENU_STOP_LOADING 6
+#define LIST_MENU_EXPORT 7
+
+#define LIST_ROOT_MENU_ALL 0
 
 #define LIST_SELECTION_MENU_WRITE 0
 #define LIST_SELECTION_MENU_RUN 1
+#define LIST_SELECTION_MENU_WIDTH 2
+#define LIST_SELECTION_MENU_HEIGHT 3
+#define LIST_SELECTION_MENU_COPY 4
+#define LIST_SELECTION_MENU_DELETE 5
+
+#define LIST_EDIT_MENU_VALUE 0
 
 #define LIST_DIMENSION_MENU_MM 0
 #define LIST_DIMENSION_MENU_INCH 1
 #define LIST_DIMENSION_MENU_POINT 2
 
+/* The Wimp colours used for plotting rows, and highlighting changes. */
+
+#define LIST_NORMAL_COLOUR wimp_COLOUR_BLACK
+#define LIST_CHANGE_COLOUR wimp_COLOUR_RED
+
+#define LIST_EXPORT_MENU_SNIPPETS 0
+#define LIST_EXPORT_MENU_AUDIT 1
+#define LIST_EXPORT_MENU_PPD 2
+#define LIST_EXPORT_MENU_NEAR 3
+
+/* The file used to export the snippet catalogue. */
+
+#define LIST_EXPORT_SNIPPETS_FILE "<Wimp$ScrapDir>.PS2Snippets"
+
+/* The file used to export the audit report. */
+
+#define LIST_EXPORT_AUDIT_FILE "<Wimp$ScrapDir>.PS2Audit"
+
+/* The file used to export the PPD fragment. */
+
+#define LIST_EXPORT_PPD_FILE "<Wimp$ScrapDir>.PS2PPD"
+
+/* The file used to export the near-duplicate report. */
+
+#define LIST_EXPORT_NEAR_FILE "<Wimp$ScrapDir>.PS2Near"
+
+/* The order in which the paper sources are shown within each root. */
+
+static enum paper_source list_source_order[] = {
+	PAPER_SOURCE_MASTER,
+	PAPER_SOURCE_DEVICE,
+	PAPER_SOURCE_USER
+};
+
+#define LIST_SOURCE_COUNT (sizeof(list_source_order) / sizeof(enum paper_source))
+
+/* Each root has a group for each source, followed by one for its orphaned snippets. */
+
+#define LIST_ORPHAN_GROUP LIST_SOURCE_COUNT
+#define LIST_GROUPS_PER_ROOT (LIST_SOURCE_COUNT + 1)
+
+/* The root filter setting which shows all of the roots. */
+
+#define LIST_ROOT_FILTER_ALL -1
+
+/* The message tokens for the texts displayed in the window, in the order of
+ * the enums which index them. Separators with no source head the orphans.
+ */
+
+static char *list_size_status_tokens[] = {"SizeStatUnkn", "SizeStatOK", "SizeStatAmb"};
+static char *list_file_status_tokens[] = {"PaperStatUnch", "PaperStatMiss", "PaperStatUnkn", "PaperStatOK", "PaperStatNOK"};
+static char *list_source_tokens[] = {"PaperFileO", "PaperFileM", "PaperFileD", "PaperFileU"};
+static char *list_source_root_tokens[] = {"PaperFileOR", "PaperFileMR", "PaperFileDR", "PaperFileUR"};
+static char *list_status_tokens[] = {"", "LoadParse", "LoadVerify", "LoadScan", "WriteQueue", "WriteDone", "WriteFail", "LoadChanges"};
+static char *list_orphan_tokens[] = {"OrphanP", "OrphanC"};
+static char *list_standard_tokens[] = {"", "StdExact", "StdName", "StdSize"};
+
+#define LIST_SIZE_STATUS_COUNT (sizeof(list_size_status_tokens) / sizeof(char *))
+#define LIST_FILE_STATUS_COUNT (sizeof(list_file_status_tokens) / sizeof(char *))
+#define LIST_SOURCE_TEXT_COUNT (sizeof(list_source_tokens) / sizeof(char *))
+#define LIST_STATUS_TEXT_COUNT (sizeof(list_status_tokens) / sizeof(char *))
+#define LIST_ORPHAN_TEXT_COUNT (sizeof(list_orphan_tokens) / sizeof(char *))
+#define LIST_STANDARD_TEXT_COUNT (sizeof(list_standard_tokens) / sizeof(char *))
+
 /* The number of columns in the window. */
 
 #define LIST_COLUMN_COUNT 6
@@ -125,16 +211,20 @@
 /* The column numbers. */
 
 #define LIST_COLUMN_PAPER_NAME 0
+#define LIST_COLUMN_WIDTH 1
+#define LIST_COLUMN_HEIGHT 2
+#define LIST_COLUMN_SIZE 3
 #define LIST_COLUMN_PAPER_FILE 4
+#define LIST_COLUMN_STATUS 5
 
 /* The column definitions. */
 
 static struct columns_definition list_column_definitions[] = {
-	{ LIST_NAME_ICON, LIST_NAME_HEADING_ICON, 436, LIST_LINE_OFFSET + LIST_ICON_INSET, LIST_LINE_OFFSET, -1, -1, COLUMNS_FLAGS_NONE },
-	{ LIST_WIDTH_ICON, LIST_WIDTH_HEADING_ICON, 156, LIST_LINE_OFFSET, LIST_LINE_OFFSET, -1, -1, COLUMNS_FLAGS_NONE },
-	{ LIST_HEIGHT_ICON, LIST_HEIGHT_HEADING_ICON, 156, LIST_LINE_OFFSET, LIST_LINE_OFFSET, -1, -1, COLUMNS_FLAGS_NONE },
-	{ LIST_SIZE_ICON, LIST_SIZE_HEADING_ICON, 200, LIST_LINE_OFFSET, LIST_LINE_OFFSET, -1, -1, COLUMNS_FLAGS_NONE },
-	{ LIST_FILENAME_ICON, LIST_FILENAME_HEADING_ICON, 360, LIST_LINE_OFFSET + LIST_ICON_INSET, LIST_LINE_OFFSET, -1, -1, COLUMNS_FLAGS_NONE },
+	{ LIST_NAME_ICON, LIST_NAME_HEADING_ICON, 436, LIST_LINE_OFFSET + LIST_ICON_INSET, LIST_LINE_OFFSET, -1, 1200, COLUMNS_FLAGS_AUTO_FIT },
+	{ LIST_WIDTH_ICON, LIST_WIDTH_HEADING_ICON, 156, LIST_LINE_OFFSET, LIST_LINE_OFFSET, -1, -1, COLUMNS_FLAGS_AUTO_FIT },
+	{ LIST_HEIGHT_ICON, LIST_HEIGHT_HEADING_ICON, 156, LIST_LINE_OFFSET, LIST_LINE_OFFSET, -1, -1, COLUMNS_FLAGS_AUTO_FIT },
+	{ LIST_SIZE_ICON, LIST_SIZE_HEADING_ICON, 200, LIST_LINE_OFFSET, LIST_LINE_OFFSET, -1, -1, COLUMNS_FLAGS_AUTO_FIT },
+	{ LIST_FILENAME_ICON, LIST_FILENAME_HEADING_ICON, 360, LIST_LINE_OFFSET + LIST_ICON_INSET, LIST_LINE_OFFSET, -1, 1000, COLUMNS_FLAGS_AUTO_FIT },
 	{ LIST_STATUS_ICON, LIST_STATUS_HEADING_ICON, 164, LIST_LINE_OFFSET, LIST_LINE_OFFSET, -1, -1, COLUMNS_FLAGS_NONE }
 };
 
@@ -154,7 +244,24 @@ enum list_units {
 
 enum list_line_type {
 	LIST_LINE_TYPE_SEPARATOR,					/**< A paper source heading separator.			*/
-	LIST_LINE_TYPE_PAPER						/**< A paper definition entry.				*/
+	LIST_LINE_TYPE_PAPER,						/**< A paper definition entry.				*/
+	LIST_LINE_TYPE_ORPHAN,						/**< An orphaned snippet file entry.			*/
+	LIST_LINE_TYPE_STATUS						/**< A background activity status line.			*/
+};
+
+/**
+ * The texts which can appear in the status line.
+ */
+
+enum list_status_text {
+	LIST_STATUS_TEXT_NONE,						/**< No status to report.				*/
+	LIST_STATUS_TEXT_PARSE,						/**< The definitions are being parsed.			*/
+	LIST_STATUS_TEXT_VERIFY,					/**< The snippets are being verified.			*/
+	LIST_STATUS_TEXT_SCAN,						/**< The sizes are being scanned for clashes.		*/
+	LIST_STATUS_TEXT_QUEUE,						/**< Snippet writes are pending.			*/
+	LIST_STATUS_TEXT_DONE,						/**< The last snippet writes succeeded.			*/
+	LIST_STATUS_TEXT_FAIL,						/**< Some of the last snippet writes failed.		*/
+	LIST_STATUS_TEXT_CHANGES					/**< The changes since the previous load.		*/
 };
 
 /**
@@ -173,8 +280,9 @@ enum list_line_flags {
 struct list_redraw {
 	enum list_line_type	type;					/**< The type of line to be redrawn.			*/
 	enum list_line_flags	flags;					/**< The line flags.					*/
-	int			index;					/**< The paper definition index for a paper line.	*/
+	int			index;					/**< The paper definition or orphan index for a line.	*/
 	enum paper_source	source;					/**< The paper source section for a separator line.	*/
+	int			root;					/**< The paper root for a separator line.		*/
 };
 
 static wimp_window		*list_window_def = NULL;		/**< The list window definition.			*/
@@ -185,14 +293,38 @@ static wimp_w			list_pane = NULL;			/**< The list pane handle.				*/
 
 static wimp_menu		*list_window_menu = NULL;		/**< The list window menu.				*/
 static wimp_menu		*list_window_selection_menu = NULL;	/**< The list window selection submenu.			*/
+static wimp_menu		*list_window_width_menu = NULL;		/**< The list window width editing submenu.		*/
+static wimp_menu		*list_window_height_menu = NULL;	/**< The list window height editing submenu.		*/
+static wimp_menu		*list_window_copy_menu = NULL;		/**< The list window copy to user size submenu.		*/
 static wimp_menu		*list_window_dimension_menu = NULL;	/**< The list window display unit menu.			*/
+static wimp_menu		*list_window_root_menu = NULL;		/**< The list window root filter menu, built on demand.	*/
+static wimp_menu		*list_window_export_menu = NULL;	/**< The list window export menu.			*/
 
 static struct columns_block	*list_columns = NULL;			/**< The column handler for the list window columns.	*/
 
 static enum list_units		list_display_units;			/**< The units used to display paper sizes.		*/
+static int			list_root_filter = LIST_ROOT_FILTER_ALL;	/**< The root to display, or LIST_ROOT_FILTER_ALL.	*/
+
+static struct queue_report	list_write_report;			/**< The results of the last batch of snippet writes.	*/
+static osbool			list_write_report_valid = FALSE;	/**< TRUE if there is a write report to display.	*/
 
 static struct list_redraw	*list_index = NULL;			/**< The window redraw index.				*/
 static size_t			list_index_count = 0;			/**< The number of entries in the redraw index.		*/
+static size_t			list_index_allocation = 0;		/**< The number of entries allocated to the index.	*/
+
+static size_t			*list_group_lines = NULL;		/**< Line counts, then next lines, for each index group.	*/
+static size_t			list_group_allocation = 0;		/**< The number of entries allocated to the group lines.	*/
+
+static size_t			list_fitted_count = 0;			/**< The number of definitions added to the column widths.	*/
+static osbool			list_fit_pending = TRUE;		/**< TRUE if the columns need refitting when a load ends.	*/
+
+static char			list_size_status_text[LIST_SIZE_STATUS_COUNT][LIST_ICON_BUFFER_LEN];	/**< Size status texts.		*/
+static char			list_file_status_text[LIST_FILE_STATUS_COUNT][LIST_ICON_BUFFER_LEN];	/**< File status texts.		*/
+static char			list_source_text[LIST_SOURCE_TEXT_COUNT][LIST_ICON_BUFFER_LEN];		/**< Separator texts.		*/
+static char			list_source_root_text[LIST_SOURCE_TEXT_COUNT][LIST_ICON_BUFFER_LEN];	/**< Separator texts with roots.	*/
+static char			list_status_text[LIST_STATUS_TEXT_COUNT][LIST_ICON_BUFFER_LEN];		/**< Status line texts.		*/
+static char			list_orphan_text[LIST_ORPHAN_TEXT_COUNT][LIST_ICON_BUFFER_LEN];		/**< Orphan location texts.	*/
+static char			list_standard_text[LIST_STANDARD_TEXT_COUNT][LIST_ICON_BUFFER_LEN];	/**< Standard size texts.	*/
 
 static int			list_selection_count = 0;		/**< The number of selected lines.			*/
 static int			list_selection_row = -1;		/**< The currently selected row, or -1.			*/
@@ -206,7 +338,18 @@ static void list_menu_warning(wimp_w w, wimp_menu *menu, wimp_message_menu_warni
 static void list_menu_selection(wimp_w w, wimp_menu *menu, wimp_selection *selection);
 static void list_menu_close(wimp_w w, wimp_menu *menu);
 static void list_redraw_handler(wimp_draw *redraw);
-static void list_add_paper_source_to_index(enum paper_source source, size_t index_lines, struct paper_size *paper, size_t paper_lines);
+static void list_resolve_texts(void);
+static void list_resolve_token_table(char **tokens, char texts[][LIST_ICON_BUFFER_LEN], size_t count);
+static void list_expand_text(char *buffer, size_t length, char *text, char *p0, char *p1, char *p2);
+static osbool list_status_line_required(void);
+static osbool list_update_column_widths(void);
+static void list_set_window_extent(void);
+static void list_redraw_lines(size_t first, size_t end);
+static void list_redraw_visible_definitions(size_t first, size_t end, osbool status);
+static void list_refresh_definitions(void);
+static void list_build_root_menu(void);
+static void list_set_root_filter(int root);
+static int list_find_paper_group(struct paper_size *paper, int root_count);
 static void list_decode_window_help(char *buffer, wimp_w w, wimp_i i, os_coord pos, wimp_mouse_state buttons);
 static int list_calculate_window_click_column(os_coord *pos, wimp_window_state *state);
 static int list_calculate_window_click_row(os_coord *pos, wimp_window_state *state);
@@ -217,7 +360,19 @@ static void list_select_all(void);
 static void list_select_none(void);
 static void list_write_selected_files(void);
 static void list_launch_selected_files(void);
+static void list_edit_selected_size(osbool width);
+static void list_copy_selected_size(void);
+static void list_delete_selected_size(void);
 static void list_set_dimensions(enum list_units units);
+static void list_export_snippets(void);
+static void list_export_audit(void);
+static void list_export_near(void);
+static void list_export_ppd(void);
+static void list_get_units(double *scale, char **format);
+static char *list_get_size_text(struct paper_size *paper, char *buffer, char *number);
+static osbool list_fit_columns(osbool complete);
+static void list_measure_paper(size_t definition, osbool add);
+static void list_highlight_icon(wimp_icon *icon, osbool highlight);
 
 
 /* Line position calculations.
@@ -259,9 +414,17 @@ void list_initialise(osspriteop_area *sprites)
 
 	list_window_menu = templates_get_menu("ListWindowMenu");
 	list_window_selection_menu = templates_get_menu("ListWindowSelectionMenu");
+	list_window_width_menu = templates_get_menu("ListWindowWidthMenu");
+	list_window_height_menu = templates_get_menu("ListWindowHeightMenu");
+	list_window_copy_menu = templates_get_menu("ListWindowCopyMenu");
 	list_window_dimension_menu = templates_get_menu("ListWindowDimensionMenu");
+	list_window_export_menu = templates_get_menu("ListWindowExportMenu");
 	ihelp_add_menu(list_window_menu, "ListMenu");
 
+	/* Look up the texts used in the window. */
+
+	list_resolve_texts();
+
 	/* Load the List Window and List Window Pane definitions. */
 
 	list_window_def = templates_load_window("Paper");
@@ -308,6 +471,9 @@ void list_initialise(osspriteop_area *sprites)
 		return;
 	}
 
+	columns_set_window_handle(list_columns, list_window);
+	columns_set_toolbar_handle(list_columns, list_pane);
+
 	ihelp_add_window(list_window, "List", list_decode_window_help);
 	ihelp_add_window(list_pane, "ListTB", NULL);
 
@@ -341,15 +507,20 @@ void list_initialise(osspriteop_area *sprites)
 
 	if (flex_alloc((flex_ptr) &list_index, 4) == 0)
 		list_index = NULL;
+
+	list_index_allocation = 0;
 }
 
 
 /**
- * Open the List window centred on the screen.
+ * Open the List window centred on the screen, starting to read the paper
+ * definitions if this is the first time that they have been needed.
  */
 
 void list_open_window(void)
 {
+	paper_ensure_loaded();
+
 	windows_open_centred_on_screen(list_window);
 	windows_open_nested_as_toolbar(list_pane, list_window, LIST_TOOLBAR_HEIGHT - 4, FALSE);
 }
@@ -403,8 +574,7 @@ static void list_toolbar_click_handler(wimp_pointer *pointer)
 
 	switch ((int) pointer->i) {
 	case LIST_REFRESH_ICON:
-		paper_read_definitions();
-		windows_redraw(list_window);
+		list_refresh_definitions();
 		break;
 	case LIST_WRITE_ICON:
 		list_write_selected_files();
@@ -457,7 +627,9 @@ static void list_menu_prepare(wimp_w w, wimp_menu *menu, wimp_pointer *pointer)
 {
 	struct paper_size	*paper;
 	wimp_window_state	state;
-	int			row;
+	int			row, definition = -1;
+	double			unit_scale;
+	char			*unit_format;
 
 
 	if (pointer != NULL) {
@@ -476,13 +648,27 @@ static void list_menu_prepare(wimp_w w, wimp_menu *menu, wimp_pointer *pointer)
 
 
 	if (list_selection_count == 1) {
+		definition = list_index[list_selection_row].index;
+
 		paper = paper_get_definitions();
 		msgs_param_lookup("MenuPaper", menus_get_indirected_text_addr(list_window_menu, LIST_MENU_SELECTION), LIST_SELECT_MENU_LEN,
-				paper[list_index[list_selection_row].index].name, NULL, NULL, NULL);
+				paper[definition].name, NULL, NULL, NULL);
+
+		/* Fill in the editing fields with the current values. */
+
+		list_get_units(&unit_scale, &unit_format);
+
+		string_printf(menus_get_indirected_text_addr(list_window_width_menu, LIST_EDIT_MENU_VALUE), LIST_EDIT_MENU_LEN,
+				unit_format, (double) paper[definition].width / unit_scale);
+		string_printf(menus_get_indirected_text_addr(list_window_height_menu, LIST_EDIT_MENU_VALUE), LIST_EDIT_MENU_LEN,
+				unit_format, (double) paper[definition].height / unit_scale);
+		string_copy(menus_get_indirected_text_addr(list_window_copy_menu, LIST_EDIT_MENU_VALUE), paper[definition].name, PAPER_NAME_LEN);
 	} else {
 		msgs_lookup("MenuSelection", menus_get_indirected_text_addr(list_window_menu, LIST_MENU_SELECTION), LIST_SELECT_MENU_LEN);
 	}
 
+	list_build_root_menu();
+
 	menus_tick_entry(list_window_dimension_menu, LIST_DIMENSION_MENU_MM, list_display_units == LIST_UNITS_MM);
 	menus_tick_entry(list_window_dimension_menu, LIST_DIMENSION_MENU_INCH, list_display_units == LIST_UNITS_INCH);
 	menus_tick_entry(list_window_dimension_menu, LIST_DIMENSION_MENU_POINT, list_display_units == LIST_UNITS_POINT);
@@ -491,6 +677,14 @@ static void list_menu_prepare(wimp_w w, wimp_menu *menu, wimp_pointer *pointer)
 	menus_shade_entry(list_window_menu, LIST_MENU_CLEAR_SELECTION, list_selection_count == 0);
 	menus_shade_entry(list_window_selection_menu, LIST_SELECTION_MENU_WRITE, list_selection_count == 0);
 	menus_shade_entry(list_window_selection_menu, LIST_SELECTION_MENU_RUN, list_selection_count == 0);
+	menus_shade_entry(list_window_selection_menu, LIST_SELECTION_MENU_WIDTH, definition == -1 || !paper_can_edit_user_size(definition));
+	menus_shade_entry(list_window_selection_menu, LIST_SELECTION_MENU_HEIGHT, definition == -1 || !paper_can_edit_user_size(definition));
+	menus_shade_entry(list_window_selection_menu, LIST_SELECTION_MENU_COPY, definition == -1 || paper_get_load_stage(NULL, NULL) != PAPER_LOAD_STAGE_IDLE);
+	menus_shade_entry(list_window_selection_menu, LIST_SELECTION_MENU_DELETE, definition == -1 || !paper_can_edit_user_size(definition));
+	menus_shade_entry(list_window_menu, LIST_MENU_STOP_LOADING, paper_get_load_stage(NULL, NULL) == PAPER_LOAD_STAGE_IDLE);
+	menus_shade_entry(list_window_export_menu, LIST_EXPORT_MENU_AUDIT, paper_get_load_stage(NULL, NULL) != PAPER_LOAD_STAGE_IDLE);
+	menus_shade_entry(list_window_export_menu, LIST_EXPORT_MENU_PPD, paper_get_load_stage(NULL, NULL) != PAPER_LOAD_STAGE_IDLE);
+	menus_shade_entry(list_window_export_menu, LIST_EXPORT_MENU_NEAR, paper_get_load_stage(NULL, NULL) != PAPER_LOAD_STAGE_IDLE);
 }
 
 
@@ -567,6 +761,25 @@ static void list_menu_selection(wimp_w w, wimp_menu *menu, wimp_selection *selec
 		case LIST_SELECTION_MENU_RUN:
 			list_launch_selected_files();
 			break;
+
+		case LIST_SELECTION_MENU_WIDTH:
+			if (selection->items[2] == LIST_EDIT_MENU_VALUE)
+				list_edit_selected_size(TRUE);
+			break;
+
+		case LIST_SELECTION_MENU_HEIGHT:
+			if (selection->items[2] == LIST_EDIT_MENU_VALUE)
+				list_edit_selected_size(FALSE);
+			break;
+
+		case LIST_SELECTION_MENU_COPY:
+			if (selection->items[2] == LIST_EDIT_MENU_VALUE)
+				list_copy_selected_size();
+			break;
+
+		case LIST_SELECTION_MENU_DELETE:
+			list_delete_selected_size();
+			break;
 		}
 		break;
 
@@ -596,9 +809,39 @@ static void list_menu_selection(wimp_w w, wimp_menu *menu, wimp_selection *selec
 		}
 		break;
 
+	case LIST_MENU_ROOTS:
+		if (selection->items[1] == LIST_ROOT_MENU_ALL)
+			list_set_root_filter(LIST_ROOT_FILTER_ALL);
+		else if (selection->items[1] > LIST_ROOT_MENU_ALL)
+			list_set_root_filter(selection->items[1] - LIST_ROOT_MENU_ALL - 1);
+		break;
+
 	case LIST_MENU_REFRESH:
-		paper_read_definitions();
-		windows_redraw(list_window);
+		list_refresh_definitions();
+		break;
+
+	case LIST_MENU_STOP_LOADING:
+		paper_cancel_load();
+		break;
+
+	case LIST_MENU_EXPORT:
+		switch(selection->items[1]) {
+		case LIST_EXPORT_MENU_SNIPPETS:
+			list_export_snippets();
+			break;
+
+		case LIST_EXPORT_MENU_AUDIT:
+			list_export_audit();
+			break;
+
+		case LIST_EXPORT_MENU_PPD:
+			list_export_ppd();
+			break;
+
+		case LIST_EXPORT_MENU_NEAR:
+			list_export_near();
+			break;
+		}
 		break;
 
 //	case RESULTS_MENU_OPEN_PARENT:
@@ -651,11 +894,22 @@ static void list_menu_close(wimp_w w, wimp_menu *menu)
 static void list_redraw_handler(wimp_draw *redraw)
 {
 	struct paper_size	*paper;
-	int			oy, top, bottom, y;
+	struct paper_orphan	*orphans;
+	int			ox, oy, top, bottom, y;
+	unsigned		columns;
 	osbool			more;
 	wimp_icon		*icon;
-	char			buffer[LIST_ICON_BUFFER_LEN], *unit_format, *token;
+	char			buffer[LIST_ICON_BUFFER_LEN], *unit_format, *text;
+	char			done_text[LIST_NUMBER_BUFFER_LEN], total_text[LIST_NUMBER_BUFFER_LEN], failed_text[LIST_NUMBER_BUFFER_LEN];
+	char			standard_text[LIST_ICON_BUFFER_LEN], size_text[LIST_NUMBER_BUFFER_LEN];
 	double			unit_scale;
+	size_t			done, total;
+	unsigned		failed, added, removed, changed;
+	osbool			multiple_roots;
+	enum list_status_text	status;
+#ifdef TRACE
+	int			rectangles = 0, lines = 0;
+#endif
 
 	/* ** This is a pointer to a flex block. If anything is done to make the
 	 * ** heap shift before the end of the redraw process, things will
@@ -663,24 +917,13 @@ static void list_redraw_handler(wimp_draw *redraw)
 	 */
 
 	paper = paper_get_definitions();
+	orphans = paper_get_orphans();
 
 	icon = list_window_def->icons;
 
-	switch (list_display_units) {
-	case LIST_UNITS_MM:
-		unit_scale = 2834.64567;
-		unit_format = "%.1f";
-		break;
-	case LIST_UNITS_INCH:
-		unit_scale = 72000.0;
-		unit_format = "%.3f";
-		break;
-	case LIST_UNITS_POINT:
-	default:
-		unit_scale = 1000.0;
-		unit_format = "%.1f";
-		break;
-	}
+	multiple_roots = (paper_get_root_count() > 1) ? TRUE : FALSE;
+
+	list_get_units(&unit_scale, &unit_format);
 
 	/* Set up the buffers for the icons. */
 
@@ -690,13 +933,8 @@ static void list_redraw_handler(wimp_draw *redraw)
 	icon[LIST_HEIGHT_ICON].data.indirected_text_and_sprite.text = buffer;
 	icon[LIST_HEIGHT_ICON].data.indirected_text_and_sprite.size = LIST_ICON_BUFFER_LEN;
 
-	icon[LIST_SIZE_ICON].data.indirected_text_and_sprite.text = buffer;
 	icon[LIST_SIZE_ICON].data.indirected_text_and_sprite.size = LIST_ICON_BUFFER_LEN;
-
-	icon[LIST_STATUS_ICON].data.indirected_text_and_sprite.text = buffer;
 	icon[LIST_STATUS_ICON].data.indirected_text_and_sprite.size = LIST_ICON_BUFFER_LEN;
-
-	icon[LIST_SEPARATOR_ICON].data.indirected_text_and_sprite.text = buffer;
 	icon[LIST_SEPARATOR_ICON].data.indirected_text_and_sprite.size = LIST_ICON_BUFFER_LEN;
 
 
@@ -704,9 +942,16 @@ static void list_redraw_handler(wimp_draw *redraw)
 
 	more = wimp_redraw_window(redraw);
 
+	ox = redraw->box.x0 - redraw->xscroll;
 	oy = redraw->box.y1 - redraw->yscroll;
 
 	while (more) {
+		/* Only the columns which overlap the clip rectangle need to be
+		 * formatted and plotted.
+		 */
+
+		columns = columns_find_visible(list_columns, redraw->clip.x0 - ox, redraw->clip.x1 - ox);
+
 		top = (oy - redraw->clip.y1 - LIST_TOOLBAR_HEIGHT) / LIST_LINE_HEIGHT;
 		if (top < 0)
 			top = 0;
@@ -715,6 +960,12 @@ static void list_redraw_handler(wimp_draw *redraw)
 		if (bottom > list_index_count)
 			bottom = list_index_count;
 
+#ifdef TRACE
+		rectangles++;
+		if (bottom > top)
+			lines += bottom - top;
+#endif
+
 		for (y = top; y < bottom; y++) {
 			switch (list_index[y].type) {
 			case LIST_LINE_TYPE_SEPARATOR:
@@ -723,127 +974,189 @@ static void list_redraw_handler(wimp_draw *redraw)
 				icon[LIST_SEPARATOR_ICON].extent.y0 = LINE_Y0(y);
 				icon[LIST_SEPARATOR_ICON].extent.y1 = LINE_Y1(y);
 
-				switch(list_index[y].source) {
-				case PAPER_SOURCE_MASTER:
-					token = "PaperFileM";
+				/* If there's more than one root, the separators
+				 * include the name of the root that they belong to.
+				 */
+
+				if (list_index[y].source >= LIST_SOURCE_TEXT_COUNT) {
+					text = "";
+				} else if (multiple_roots) {
+					list_expand_text(buffer, LIST_ICON_BUFFER_LEN, list_source_root_text[list_index[y].source],
+							paper_get_root_name(list_index[y].root), NULL, NULL);
+					text = buffer;
+				} else {
+					text = list_source_text[list_index[y].source];
+				}
+
+				icon[LIST_SEPARATOR_ICON].data.indirected_text_and_sprite.text = text;
+
+				wimp_plot_icon(&(icon[LIST_SEPARATOR_ICON]));
+				break;
+
+			case LIST_LINE_TYPE_STATUS:
+				/* Plot the background activity status, using the separator icon. */
+
+				icon[LIST_SEPARATOR_ICON].extent.y0 = LINE_Y0(y);
+				icon[LIST_SEPARATOR_ICON].extent.y1 = LINE_Y1(y);
+
+				failed = list_write_report.failed;
+
+				switch (paper_get_load_stage(&done, &total)) {
+				case PAPER_LOAD_STAGE_PARSE:
+					status = LIST_STATUS_TEXT_PARSE;
 					break;
-				case PAPER_SOURCE_DEVICE:
-					token = "PaperFileD";
+				case PAPER_LOAD_STAGE_VERIFY:
+					status = LIST_STATUS_TEXT_VERIFY;
 					break;
-				case PAPER_SOURCE_USER:
-					token = "PaperFileU";
+				case PAPER_LOAD_STAGE_SCAN:
+					status = LIST_STATUS_TEXT_SCAN;
 					break;
 				default:
-					token = "";
+					if (queue_get_pending_count() > 0) {
+						status = LIST_STATUS_TEXT_QUEUE;
+						done = queue_get_pending_count();
+					} else if (list_write_report_valid) {
+						status = (list_write_report.failed > 0) ? LIST_STATUS_TEXT_FAIL : LIST_STATUS_TEXT_DONE;
+						done = list_write_report.written;
+						total = list_write_report.unchanged;
+					} else if (journal_get_summary(&added, &removed, &changed)) {
+						status = LIST_STATUS_TEXT_CHANGES;
+						done = added;
+						total = removed;
+						failed = changed;
+					} else {
+						status = LIST_STATUS_TEXT_NONE;
+					}
 					break;
 				}
 
-				msgs_lookup(token, buffer, LIST_ICON_BUFFER_LEN);
-				buffer[LIST_ICON_BUFFER_LEN - 1] = '\0';
+				string_printf(done_text, LIST_NUMBER_BUFFER_LEN, "%u", (unsigned) done);
+				string_printf(total_text, LIST_NUMBER_BUFFER_LEN, "%u", (unsigned) total);
+				string_printf(failed_text, LIST_NUMBER_BUFFER_LEN, "%u", failed);
+
+				list_expand_text(buffer, LIST_ICON_BUFFER_LEN, list_status_text[status], done_text, total_text, failed_text);
+
+				icon[LIST_SEPARATOR_ICON].data.indirected_text_and_sprite.text = buffer;
 
 				wimp_plot_icon(&(icon[LIST_SEPARATOR_ICON]));
 				break;
-			
+
 			case LIST_LINE_TYPE_PAPER:
 				/* Plot the Paper Name icon. */
 
-				icon[LIST_NAME_ICON].extent.y0 = LINE_Y0(y);
-				icon[LIST_NAME_ICON].extent.y1 = LINE_Y1(y);
-				icon[LIST_NAME_ICON].data.indirected_text_and_sprite.text = paper[list_index[y].index].name;
-				icon[LIST_NAME_ICON].data.indirected_text_and_sprite.size = PAPER_NAME_LEN;
-				if (list_index[y].flags & LIST_LINE_FLAGS_SELECTED)
-					icon[LIST_NAME_ICON].flags |= wimp_ICON_SELECTED;
-				else
-					icon[LIST_NAME_ICON].flags &= ~wimp_ICON_SELECTED;
-
-				wimp_plot_icon(&(icon[LIST_NAME_ICON]));
+				if (columns & COLUMNS_MASK(LIST_COLUMN_PAPER_NAME)) {
+					icon[LIST_NAME_ICON].extent.y0 = LINE_Y0(y);
+					icon[LIST_NAME_ICON].extent.y1 = LINE_Y1(y);
+					icon[LIST_NAME_ICON].data.indirected_text_and_sprite.text = paper[list_index[y].index].name;
+					icon[LIST_NAME_ICON].data.indirected_text_and_sprite.size = PAPER_NAME_LEN;
+					if (list_index[y].flags & LIST_LINE_FLAGS_SELECTED)
+						icon[LIST_NAME_ICON].flags |= wimp_ICON_SELECTED;
+					else
+						icon[LIST_NAME_ICON].flags &= ~wimp_ICON_SELECTED;
+					if (paper[list_index[y].index].shadowed)
+						icon[LIST_NAME_ICON].flags |= wimp_ICON_SHADED;
+					else
+						icon[LIST_NAME_ICON].flags &= ~wimp_ICON_SHADED;
+					list_highlight_icon(&(icon[LIST_NAME_ICON]), paper[list_index[y].index].changes & JOURNAL_CHANGE_ADDED);
+
+					wimp_plot_icon(&(icon[LIST_NAME_ICON]));
+				}
 
 				/* Plot the Width icon. */
 
-				icon[LIST_WIDTH_ICON].extent.y0 = LINE_Y0(y);
-				icon[LIST_WIDTH_ICON].extent.y1 = LINE_Y1(y);
+				if (columns & COLUMNS_MASK(LIST_COLUMN_WIDTH)) {
+					icon[LIST_WIDTH_ICON].extent.y0 = LINE_Y0(y);
+					icon[LIST_WIDTH_ICON].extent.y1 = LINE_Y1(y);
 
-				string_printf(buffer, LIST_ICON_BUFFER_LEN, unit_format, (double) (paper[list_index[y].index].width / unit_scale));
+					string_printf(buffer, LIST_ICON_BUFFER_LEN, unit_format, (double) (paper[list_index[y].index].width / unit_scale));
+					list_highlight_icon(&(icon[LIST_WIDTH_ICON]), paper[list_index[y].index].changes & JOURNAL_CHANGE_SIZE);
 
-				wimp_plot_icon(&(icon[LIST_WIDTH_ICON]));
+					wimp_plot_icon(&(icon[LIST_WIDTH_ICON]));
+				}
 
 				/* Plot the height icon. */
 
-				icon[LIST_HEIGHT_ICON].extent.y0 = LINE_Y0(y);
-				icon[LIST_HEIGHT_ICON].extent.y1 = LINE_Y1(y);
-
-				string_printf(buffer, LIST_ICON_BUFFER_LEN, unit_format, (double) (paper[list_index[y].index].height / unit_scale));
+				if (columns & COLUMNS_MASK(LIST_COLUMN_HEIGHT)) {
+					icon[LIST_HEIGHT_ICON].extent.y0 = LINE_Y0(y);
+					icon[LIST_HEIGHT_ICON].extent.y1 = LINE_Y1(y);
 
-				wimp_plot_icon(&(icon[LIST_HEIGHT_ICON]));
+					string_printf(buffer, LIST_ICON_BUFFER_LEN, unit_format, (double) (paper[list_index[y].index].height / unit_scale));
+					list_highlight_icon(&(icon[LIST_HEIGHT_ICON]), paper[list_index[y].index].changes & JOURNAL_CHANGE_SIZE);
 
-				/* Plot the size status icon. */
+					wimp_plot_icon(&(icon[LIST_HEIGHT_ICON]));
+				}
 
-				icon[LIST_SIZE_ICON].extent.y0 = LINE_Y0(y);
-				icon[LIST_SIZE_ICON].extent.y1 = LINE_Y1(y);
+				/* Plot the size status icon. Unless the size is ambiguous,
+				 * any relationship to a standard size is shown instead.
+				 */
 
-				switch(paper[list_index[y].index].size_status) {
-				case PAPER_SIZE_STATUS_UNKNOWN:
-					token = "SizeStatUnkn";
-					break;
-				case PAPER_SIZE_STATUS_OK:
-					token = "SizeStatOK";
-					break;
-				case PAPER_SIZE_STATUS_AMBIGUOUS:
-					token = "SizeStatAmb";
-					break;
-				default:
-					token = "";
-					break;
-				}
+				if (columns & COLUMNS_MASK(LIST_COLUMN_SIZE)) {
+					icon[LIST_SIZE_ICON].extent.y0 = LINE_Y0(y);
+					icon[LIST_SIZE_ICON].extent.y1 = LINE_Y1(y);
 
-				msgs_lookup(token, buffer, LIST_ICON_BUFFER_LEN);
-				buffer[LIST_ICON_BUFFER_LEN - 1] = '\0';
+					icon[LIST_SIZE_ICON].data.indirected_text_and_sprite.text =
+							list_get_size_text(paper + list_index[y].index, standard_text, size_text);
 
-				wimp_plot_icon(&(icon[LIST_SIZE_ICON]));
+					wimp_plot_icon(&(icon[LIST_SIZE_ICON]));
+				}
 
 				/* Plot the PS filename icon. */
 
-				icon[LIST_FILENAME_ICON].extent.y0 = LINE_Y0(y);
-				icon[LIST_FILENAME_ICON].extent.y1 = LINE_Y1(y);
-				icon[LIST_FILENAME_ICON].data.indirected_text_and_sprite.text = paper[list_index[y].index].ps2_file;
-				icon[LIST_FILENAME_ICON].data.indirected_text_and_sprite.size = PAPER_FILE_LEN;
+				if (columns & COLUMNS_MASK(LIST_COLUMN_PAPER_FILE)) {
+					icon[LIST_FILENAME_ICON].extent.y0 = LINE_Y0(y);
+					icon[LIST_FILENAME_ICON].extent.y1 = LINE_Y1(y);
+					icon[LIST_FILENAME_ICON].data.indirected_text_and_sprite.text = paper[list_index[y].index].ps2_file;
+					icon[LIST_FILENAME_ICON].data.indirected_text_and_sprite.size = PAPER_FILE_LEN;
 
-				if (paper[list_index[y].index].ps2_file_status == PAPER_FILE_STATUS_MISSING)
-					icon[LIST_FILENAME_ICON].flags |= wimp_ICON_SHADED;
-				else
-					icon[LIST_FILENAME_ICON].flags &= ~wimp_ICON_SHADED;
+					if (paper[list_index[y].index].ps2_file_status == PAPER_FILE_STATUS_MISSING)
+						icon[LIST_FILENAME_ICON].flags |= wimp_ICON_SHADED;
+					else
+						icon[LIST_FILENAME_ICON].flags &= ~wimp_ICON_SHADED;
 
-				wimp_plot_icon(&(icon[LIST_FILENAME_ICON]));
+					wimp_plot_icon(&(icon[LIST_FILENAME_ICON]));
+				}
 
 				/* Plot the PS file status icon. */
 
-				icon[LIST_STATUS_ICON].extent.y0 = LINE_Y0(y);
-				icon[LIST_STATUS_ICON].extent.y1 = LINE_Y1(y);
+				if (columns & COLUMNS_MASK(LIST_COLUMN_STATUS)) {
+					icon[LIST_STATUS_ICON].extent.y0 = LINE_Y0(y);
+					icon[LIST_STATUS_ICON].extent.y1 = LINE_Y1(y);
 
-				switch(paper[list_index[y].index].ps2_file_status) {
-				case PAPER_FILE_STATUS_MISSING:
-					token = "PaperStatMiss";
-					break;
-				case PAPER_FILE_STATUS_UNKNOWN:
-					token = "PaperStatUnkn";
-					break;
-				case PAPER_FILE_STATUS_CORRECT:
-					token = "PaperStatOK";
-					break;
-				case PAPER_FILE_STATUS_INCORRECT:
-					token = "PaperStatNOK";
-					break;
-				default:
-					token = "";
-					break;
+					icon[LIST_STATUS_ICON].data.indirected_text_and_sprite.text =
+							(paper[list_index[y].index].ps2_file_status < LIST_FILE_STATUS_COUNT) ?
+							list_file_status_text[paper[list_index[y].index].ps2_file_status] : "";
+					list_highlight_icon(&(icon[LIST_STATUS_ICON]), paper[list_index[y].index].changes & JOURNAL_CHANGE_STATUS);
+
+					wimp_plot_icon(&(icon[LIST_STATUS_ICON]));
+				}
+				break;
+
+			case LIST_LINE_TYPE_ORPHAN:
+				/* Plot the PS filename icon. */
+
+				if (columns & COLUMNS_MASK(LIST_COLUMN_PAPER_FILE)) {
+					icon[LIST_FILENAME_ICON].extent.y0 = LINE_Y0(y);
+					icon[LIST_FILENAME_ICON].extent.y1 = LINE_Y1(y);
+					icon[LIST_FILENAME_ICON].data.indirected_text_and_sprite.text = orphans[list_index[y].index].name;
+					icon[LIST_FILENAME_ICON].data.indirected_text_and_sprite.size = PAPER_FILE_LEN;
+					icon[LIST_FILENAME_ICON].flags &= ~wimp_ICON_SHADED;
+
+					wimp_plot_icon(&(icon[LIST_FILENAME_ICON]));
 				}
 
-				msgs_lookup(token, buffer, LIST_ICON_BUFFER_LEN);
-				buffer[LIST_ICON_BUFFER_LEN - 1] = '\0';
+				/* Plot the location of the file in the PS file status icon. */
 
-				wimp_plot_icon(&(icon[LIST_STATUS_ICON]));
+				if (columns & COLUMNS_MASK(LIST_COLUMN_STATUS)) {
+					icon[LIST_STATUS_ICON].extent.y0 = LINE_Y0(y);
+					icon[LIST_STATUS_ICON].extent.y1 = LINE_Y1(y);
+
+					icon[LIST_STATUS_ICON].data.indirected_text_and_sprite.text = list_orphan_text[(orphans[list_index[y].index].choices) ? 1 : 0];
+					list_highlight_icon(&(icon[LIST_STATUS_ICON]), FALSE);
+
+					wimp_plot_icon(&(icon[LIST_STATUS_ICON]));
+				}
 				break;
-			
+
 			default:
 				break;
 			}
@@ -851,6 +1164,102 @@ static void list_redraw_handler(wimp_draw *redraw)
 
 		more = wimp_get_rectangle(redraw);
 	}
+
+	TRACE_EVENT(TRACE_EVENT_REDRAW, rectangles, lines);
+}
+
+
+/**
+ * Look up all of the status, source and heading texts used in the window
+ * from the messages file, so that redraws don't need to. The parameters
+ * in the texts are left in place, to be filled in by list_expand_text().
+ */
+
+static void list_resolve_texts(void)
+{
+	list_resolve_token_table(list_size_status_tokens, list_size_status_text, LIST_SIZE_STATUS_COUNT);
+	list_resolve_token_table(list_file_status_tokens, list_file_status_text, LIST_FILE_STATUS_COUNT);
+	list_resolve_token_table(list_source_tokens, list_source_text, LIST_SOURCE_TEXT_COUNT);
+	list_resolve_token_table(list_source_root_tokens, list_source_root_text, LIST_SOURCE_TEXT_COUNT);
+	list_resolve_token_table(list_status_tokens, list_status_text, LIST_STATUS_TEXT_COUNT);
+	list_resolve_token_table(list_orphan_tokens, list_orphan_text, LIST_ORPHAN_TEXT_COUNT);
+	list_resolve_token_table(list_standard_tokens, list_standard_text, LIST_STANDARD_TEXT_COUNT);
+}
+
+
+/**
+ * Look up a table of message tokens into an array of texts.
+ *
+ * \param **tokens		The tokens to be looked up.
+ * \param texts			The array of texts to take the results.
+ * \param count			The number of tokens in the table.
+ */
+
+static void list_resolve_token_table(char **tokens, char texts[][LIST_ICON_BUFFER_LEN], size_t count)
+{
+	size_t	i;
+
+	for (i = 0; i < count; i++) {
+		if (*tokens[i] == '\0') {
+			*texts[i] = '\0';
+			continue;
+		}
+
+		msgs_param_lookup(tokens[i], texts[i], LIST_ICON_BUFFER_LEN, "%0", "%1", "%2", NULL);
+		texts[i][LIST_ICON_BUFFER_LEN - 1] = '\0';
+	}
+}
+
+
+/**
+ * Expand a pre-resolved text into a buffer, replacing the parameters %0
+ * to %2 with the strings supplied.
+ *
+ * \param *buffer		The buffer to take the expanded text.
+ * \param length		The length of the buffer.
+ * \param *text			The text to be expanded.
+ * \param *p0			The string to replace %0, or NULL.
+ * \param *p1			The string to replace %1, or NULL.
+ * \param *p2			The string to replace %2, or NULL.
+ */
+
+static void list_expand_text(char *buffer, size_t length, char *text, char *p0, char *p1, char *p2)
+{
+	char	*param;
+	size_t	used = 0;
+
+	if (buffer == NULL || length == 0)
+		return;
+
+	while (text != NULL && *text != '\0' && used < length - 1) {
+		param = NULL;
+
+		if (*text == '%') {
+			switch (*(text + 1)) {
+			case '0':
+				param = (p0 != NULL) ? p0 : "";
+				break;
+			case '1':
+				param = (p1 != NULL) ? p1 : "";
+				break;
+			case '2':
+				param = (p2 != NULL) ? p2 : "";
+				break;
+			}
+		}
+
+		if (param == NULL) {
+			buffer[used++] = *text++;
+			continue;
+		}
+
+		while (*param != '\0' && used < length - 1)
+			buffer[used++] = *param++;
+
+		text += 2;
+	}
+
+	buffer[used] = '\0';
 }
 
 
@@ -860,66 +1269,187 @@ static void list_redraw_handler(wimp_draw *redraw)
 
 void list_rescan_paper_definitions(void)
 {
-	int			visible_extent, new_extent, new_scroll;
-	size_t			paper_lines, index_size;
+	int			root_count, group, group_count;
+	size_t			paper_lines, orphan_lines, index_size, line, i, *lines;
+	osbool			status;
+	unsigned char		*selected;
 	struct paper_size	*paper;
-	wimp_window_state	state;
-	os_box			extent;
+	struct paper_orphan	*orphans;
+#ifdef TRACE
+	struct list_redraw	*old_index;
+#endif
 
 	paper_lines = paper_get_definition_count();
-	index_size = paper_lines + 3;
+	orphan_lines = paper_get_orphan_count();
+	status = list_status_line_required();
+	root_count = paper_get_root_count();
 
-	if (flex_extend((flex_ptr) &list_index, index_size * sizeof(struct list_redraw)) == 0)
-		list_index = NULL;
+	if (list_root_filter >= root_count)
+		list_root_filter = LIST_ROOT_FILTER_ALL;
+
+	list_update_column_widths();
+
+	/* Note which definitions are selected, so that the selection can be
+	 * carried across to the new index by definition number. Orphans and
+	 * other lines don't keep their selection.
+	 */
+
+	selected = NULL;
+
+	if (list_selection_count > 0 && paper_lines > 0)
+		selected = calloc(paper_lines, sizeof(unsigned char));
+
+	if (selected != NULL) {
+		for (line = 0; line < list_index_count; line++) {
+			if ((list_index[line].flags & LIST_LINE_FLAGS_SELECTED) && list_index[line].type == LIST_LINE_TYPE_PAPER &&
+					list_index[line].index >= 0 && list_index[line].index < paper_lines)
+				selected[list_index[line].index] = 1;
+		}
+	}
 
 	list_index_count = 0;
 	list_selection_count = 0;
 	list_selection_row = -1;
-	list_selection_from_menu = FALSE;
 
-	list_toolbar_set_buttons();
+	/* Each root has a group of lines for each of the sources, headed by a
+	 * separator, and then a group for any orphaned snippets. Make sure that
+	 * there's space to count the groups.
+	 */
+
+	group_count = root_count * LIST_GROUPS_PER_ROOT;
+
+	if (group_count > list_group_allocation) {
+		lines = realloc(list_group_lines, group_count * sizeof(size_t));
+		if (lines != NULL) {
+			list_group_lines = lines;
+			list_group_allocation = group_count;
+		}
+	}
+
+	if (list_group_lines == NULL || group_count > list_group_allocation)
+		group_count = 0;
+
+	/* Count the number of definitions and orphans in each group, in a
+	 * single pass over each.
+	 */
 
 	paper = paper_get_definitions();
+	orphans = paper_get_orphans();
 
-	if (list_index != NULL) {
-		list_add_paper_source_to_index(PAPER_SOURCE_MASTER, index_size, paper, paper_lines);
-		list_add_paper_source_to_index(PAPER_SOURCE_DEVICE, index_size, paper, paper_lines);
-		list_add_paper_source_to_index(PAPER_SOURCE_USER, index_size, paper, paper_lines);
+	for (group = 0; group < group_count; group++)
+		list_group_lines[group] = 0;
+
+	for (i = 0; i < paper_lines; i++) {
+		group = list_find_paper_group(paper + i, root_count);
+		if (group >= 0 && group < group_count)
+			list_group_lines[group]++;
 	}
 
-	state.w = list_window;
-	wimp_get_window_state(&state);
+	for (i = 0; i < orphan_lines; i++) {
+		group = (orphans[i].root * LIST_GROUPS_PER_ROOT) + LIST_ORPHAN_GROUP;
+		if (group >= 0 && group < group_count)
+			list_group_lines[group]++;
+	}
 
-	visible_extent = state.yscroll + (state.visible.y0 - state.visible.y1);
+	/* Work out how big the index needs to be, and extend it if the
+	 * current block is too small.
+	 */
 
-	new_extent = -((LIST_LINE_HEIGHT * index_size) + LIST_TOOLBAR_HEIGHT + (2 * LIST_WINDOW_MARGIN));
+	index_size = (status) ? 1 : 0;
 
-	if (new_extent > (state.visible.y0 - state.visible.y1))
-		new_extent = state.visible.y0 - state.visible.y1;
+	for (group = 0; group < group_count; group++) {
+		if (list_root_filter != LIST_ROOT_FILTER_ALL && list_root_filter != (group / LIST_GROUPS_PER_ROOT))
+			continue;
 
-	if (new_extent > visible_extent) {
-		/* Calculate the required new scroll offset.  If this is greater than zero, the current window is too
-		 * big and will need shrinking down.  Otherwise, just set the new scroll offset.
+		if (group % LIST_GROUPS_PER_ROOT != LIST_ORPHAN_GROUP || list_group_lines[group] > 0)
+			index_size += list_group_lines[group] + 1;
+	}
+
+	if (list_index != NULL && index_size > list_index_allocation) {
+#ifdef TRACE
+		old_index = list_index;
+#endif
+
+		if (flex_extend((flex_ptr) &list_index, index_size * sizeof(struct list_redraw)) != 0)
+			list_index_allocation = index_size;
+
+		TRACE_EVENT(TRACE_EVENT_FLEX, index_size * sizeof(struct list_redraw), list_index != old_index);
+	}
+
+	if (list_index != NULL && index_size <= list_index_allocation) {
+		/* Place the separators, and turn the counts into the next free
+		 * line in each group.
 		 */
 
-		new_scroll = new_extent - (state.visible.y0 - state.visible.y1);
+		line = 0;
 
-		if (new_scroll > 0) {
-			state.visible.y0 += new_scroll;
-			state.yscroll = 0;
-		} else {
-			state.yscroll = new_scroll;
+		for (group = 0; group < group_count; group++) {
+			if ((list_root_filter != LIST_ROOT_FILTER_ALL && list_root_filter != (group / LIST_GROUPS_PER_ROOT)) ||
+					(group % LIST_GROUPS_PER_ROOT == LIST_ORPHAN_GROUP && list_group_lines[group] == 0)) {
+				list_group_lines[group] = index_size;
+				continue;
+			}
+
+			list_index[line].type = LIST_LINE_TYPE_SEPARATOR;
+			list_index[line].source = (group % LIST_GROUPS_PER_ROOT == LIST_ORPHAN_GROUP) ?
+					PAPER_SOURCE_NONE : list_source_order[group % LIST_GROUPS_PER_ROOT];
+			list_index[line].root = group / LIST_GROUPS_PER_ROOT;
+			list_index[line].flags = LIST_LINE_FLAGS_NONE;
+
+			i = list_group_lines[group];
+			list_group_lines[group] = line + 1;
+			line += i + 1;
 		}
 
-		wimp_open_window((wimp_open *) &state);
+		/* Scatter the definitions into their groups, in a second pass. */
+
+		paper = paper_get_definitions();
+
+		for (i = 0; i < paper_lines; i++) {
+			group = list_find_paper_group(paper + i, root_count);
+			if (group < 0 || group >= group_count || list_group_lines[group] >= index_size)
+				continue;
+
+			line = list_group_lines[group]++;
+
+			list_index[line].type = LIST_LINE_TYPE_PAPER;
+			list_index[line].index = i;
+			list_index[line].flags = LIST_LINE_FLAGS_NONE;
+
+			if (selected != NULL && selected[i]) {
+				list_index[line].flags |= LIST_LINE_FLAGS_SELECTED;
+				if (list_selection_count++ == 0)
+					list_selection_row = line;
+			}
+		}
+
+		orphans = paper_get_orphans();
+
+		for (i = 0; i < orphan_lines; i++) {
+			group = (orphans[i].root * LIST_GROUPS_PER_ROOT) + LIST_ORPHAN_GROUP;
+			if (group < 0 || group >= group_count || list_group_lines[group] >= index_size)
+				continue;
+
+			line = list_group_lines[group]++;
+
+			list_index[line].type = LIST_LINE_TYPE_ORPHAN;
+			list_index[line].index = i;
+			list_index[line].flags = LIST_LINE_FLAGS_NONE;
+		}
+
+		list_index_count = index_size;
+
+		if (status) {
+			list_index[list_index_count - 1].type = LIST_LINE_TYPE_STATUS;
+			list_index[list_index_count - 1].flags = LIST_LINE_FLAGS_NONE;
+		}
 	}
 
-	extent.x0 = 0;
-	extent.y1 = 0;
-	extent.x1 = state.visible.x1 - state.visible.x0;
-	extent.y0 = new_extent;
+	free(selected);
 
-	wimp_set_extent(list_window, &extent);
+	list_toolbar_set_buttons();
+
+	list_set_window_extent();
 
 	if (windows_get_open(list_window))
 		windows_redraw(list_window);
@@ -927,40 +1457,338 @@ void list_rescan_paper_definitions(void)
 
 
 /**
- * Add the paper definitions from a given source to the end of the paper
- * list index.
- * 
- * \param source		The target paper source to be added to the index.
- * \param index_lines		The number of index entries allocated for the process.
- * \param *paper		The paper list to process.
- * \param paper_lines		The number of paper definitions in the list.
+ * Add a line to the List window for a paper definition which has just been
+ * added to the end of the catalogue, without rebuilding the whole index.
+ * The line goes at the end of the definition's group, and the selection is
+ * left as it is.
+ *
+ * \param definition		The index of the new definition.
  */
 
-static void list_add_paper_source_to_index(enum paper_source source, size_t index_lines, struct paper_size *paper, size_t paper_lines)
+void list_insert_paper_definition(size_t definition)
 {
-	int i;
+	struct paper_size	*paper;
+	enum paper_source	source;
+	size_t			line;
+	int			root;
 
-	if (list_index_count >= index_lines)
+	if (definition >= paper_get_definition_count())
 		return;
 
-	list_index[list_index_count].type = LIST_LINE_TYPE_SEPARATOR;
-	list_index[list_index_count].source = source;
-	list_index[list_index_count].flags = LIST_LINE_FLAGS_NONE;
-
-	list_index_count++;
+	if (list_update_column_widths()) {
+		list_set_window_extent();
 
-	for (i = 0; i < paper_lines && list_index_count < index_lines; i++) {
-		if (paper[i].source == source) {
-			list_index[list_index_count].type = LIST_LINE_TYPE_PAPER;
-			list_index[list_index_count].index = i;
-			list_index[list_index_count].flags = LIST_LINE_FLAGS_NONE;
-			list_index_count++;
-		}
+		if (windows_get_open(list_window))
+			windows_redraw(list_window);
 	}
-}
 
+	paper = paper_get_definitions() + definition;
+	root = paper->root;
+	source = paper->source;
 
-/**
+	if (list_index == NULL || (list_root_filter != LIST_ROOT_FILTER_ALL && list_root_filter != root))
+		return;
+
+	/* Find the separator at the head of the definition's group, and then
+	 * the end of the group.
+	 */
+
+	for (line = 0; line < list_index_count; line++) {
+		if (list_index[line].type == LIST_LINE_TYPE_SEPARATOR && list_index[line].root == root && list_index[line].source == source)
+			break;
+	}
+
+	if (line >= list_index_count)
+		return;
+
+	for (line++; line < list_index_count && list_index[line].type == LIST_LINE_TYPE_PAPER; line++);
+
+	if (list_index_count + 1 > list_index_allocation) {
+		if (flex_extend((flex_ptr) &list_index, (list_index_count + 1) * sizeof(struct list_redraw)) == 0) {
+			list_rescan_paper_definitions();
+			return;
+		}
+
+		list_index_allocation = list_index_count + 1;
+	}
+
+	memmove(list_index + line + 1, list_index + line, (list_index_count - line) * sizeof(struct list_redraw));
+	list_index_count++;
+
+	list_index[line].type = LIST_LINE_TYPE_PAPER;
+	list_index[line].index = definition;
+	list_index[line].flags = LIST_LINE_FLAGS_NONE;
+
+	if (list_selection_row >= 0 && list_selection_row >= line)
+		list_selection_row++;
+
+	list_set_window_extent();
+	list_redraw_lines(line, list_index_count);
+}
+
+
+/**
+ * Redraw the List window lines for a paper definition which has been changed
+ * in place, refitting the columns to the new texts first.
+ *
+ * \param definition		The index of the definition.
+ */
+
+void list_update_paper_definition(size_t definition)
+{
+	if (list_update_column_widths()) {
+		list_set_window_extent();
+
+		if (windows_get_open(list_window))
+			windows_redraw(list_window);
+
+		return;
+	}
+
+	list_redraw_visible_definitions(definition, definition + 1, FALSE);
+}
+
+
+/**
+ * Fit the List window columns to the texts of the paper definitions, adding
+ * any which haven't yet been seen. Once the load is complete, all of the
+ * columns are refitted so that the final size statuses are taken into
+ * account; until then, just the new definitions are added.
+ *
+ * \return			TRUE if the column widths changed; else FALSE.
+ */
+
+static osbool list_update_column_widths(void)
+{
+	os_box	extent;
+
+	if (!list_fit_columns(paper_get_load_stage(NULL, NULL) == PAPER_LOAD_STAGE_IDLE))
+		return FALSE;
+
+	list_window_def->icons[LIST_SEPARATOR_ICON].extent.x1 = columns_get_full_width(list_columns);
+
+	extent = list_pane_def->extent;
+	if (extent.x1 < columns_get_full_width(list_columns))
+		extent.x1 = columns_get_full_width(list_columns);
+
+	wimp_set_extent(list_pane, &extent);
+
+	if (windows_get_open(list_pane))
+		windows_redraw(list_pane);
+
+	return TRUE;
+}
+
+
+/**
+ * Set the extent of the List window to suit the number of lines in the
+ * index and the width of the columns, shrinking the window if it has
+ * become too tall.
+ */
+
+static void list_set_window_extent(void)
+{
+	int			visible_extent, new_extent, new_scroll;
+	wimp_window_state	state;
+	os_box			extent;
+
+	state.w = list_window;
+	wimp_get_window_state(&state);
+
+	visible_extent = state.yscroll + (state.visible.y0 - state.visible.y1);
+
+	new_extent = -((LIST_LINE_HEIGHT * list_index_count) + LIST_TOOLBAR_HEIGHT + (2 * LIST_WINDOW_MARGIN));
+
+	if (new_extent > (state.visible.y0 - state.visible.y1))
+		new_extent = state.visible.y0 - state.visible.y1;
+
+	if (new_extent > visible_extent) {
+		/* Calculate the required new scroll offset.  If this is greater than zero, the current window is too
+		 * big and will need shrinking down.  Otherwise, just set the new scroll offset.
+		 */
+
+		new_scroll = new_extent - (state.visible.y0 - state.visible.y1);
+
+		if (new_scroll > 0) {
+			state.visible.y0 += new_scroll;
+			state.yscroll = 0;
+		} else {
+			state.yscroll = new_scroll;
+		}
+
+		wimp_open_window((wimp_open *) &state);
+	}
+
+	extent.x0 = 0;
+	extent.y1 = 0;
+	extent.x1 = state.visible.x1 - state.visible.x0;
+	extent.y0 = new_extent;
+
+	if (extent.x1 < columns_get_full_width(list_columns))
+		extent.x1 = columns_get_full_width(list_columns);
+
+	wimp_set_extent(list_window, &extent);
+}
+
+
+/**
+ * Force a redraw of a range of lines in the List window.
+ *
+ * \param first			The first line to redraw.
+ * \param end			The line after the last to redraw.
+ */
+
+static void list_redraw_lines(size_t first, size_t end)
+{
+	wimp_window_state	state;
+
+	if (first >= end || !windows_get_open(list_window))
+		return;
+
+	state.w = list_window;
+	if (xwimp_get_window_state(&state) != NULL)
+		return;
+
+	wimp_force_redraw(list_window, state.xscroll, LINE_BASE(end - 1),
+			state.xscroll + (state.visible.x1 - state.visible.x0), LINE_Y1(first));
+}
+
+
+/**
+ * Request the List window to update its display of the paper definitions
+ * and background load progress, without rebuilding its index. Only the
+ * visible rows for the definitions which have been updated are redrawn,
+ * along with the status line.
+ *
+ * \param first			The first definition which has been updated.
+ * \param end			The definition after the last to be updated.
+ */
+
+void list_update_load_progress(size_t first, size_t end)
+{
+	list_redraw_visible_definitions(first, end, TRUE);
+}
+
+
+/**
+ * Redraw the visible List window lines for a range of paper definitions,
+ * and optionally the status line.
+ *
+ * \param first			The first definition to redraw.
+ * \param end			The definition after the last to redraw.
+ * \param status		TRUE to redraw the status line; else FALSE.
+ */
+
+static void list_redraw_visible_definitions(size_t first, size_t end, osbool status)
+{
+	wimp_window_state	state;
+	int			top, bottom, line;
+
+	if (list_index == NULL || !windows_get_open(list_window))
+		return;
+
+	state.w = list_window;
+	if (xwimp_get_window_state(&state) != NULL)
+		return;
+
+	top = ROW(state.yscroll);
+	if (top < 0)
+		top = 0;
+
+	bottom = ROW(state.yscroll + (state.visible.y0 - state.visible.y1)) + 1;
+	if (bottom > list_index_count)
+		bottom = list_index_count;
+
+	for (line = top; line < bottom; line++) {
+		if ((list_index[line].type == LIST_LINE_TYPE_PAPER && list_index[line].index >= first && list_index[line].index < end) ||
+				(status && list_index[line].type == LIST_LINE_TYPE_STATUS))
+			wimp_force_redraw(list_window, state.xscroll, LINE_BASE(line),
+					state.xscroll + (state.visible.x1 - state.visible.x0), LINE_Y1(line));
+	}
+}
+
+
+/**
+ * Report the results of a batch of snippet writes in the List window.
+ *
+ * \param *report		The results to be reported.
+ */
+
+void list_report_write_status(struct queue_report *report)
+{
+	if (report == NULL)
+		return;
+
+	list_write_report = *report;
+	list_write_report_valid = TRUE;
+
+	list_rescan_paper_definitions();
+}
+
+
+/**
+ * Test whether the List window needs a status line at the foot of the list,
+ * to report on a background load, pending writes or the results of the
+ * last batch of writes.
+ *
+ * \return			TRUE if a status line is required; else FALSE.
+ */
+
+static osbool list_status_line_required(void)
+{
+	if (paper_get_load_stage(NULL, NULL) != PAPER_LOAD_STAGE_IDLE)
+		return TRUE;
+
+	if (queue_get_pending_count() > 0 || list_write_report_valid)
+		return TRUE;
+
+	if (journal_get_summary(NULL, NULL, NULL))
+		return TRUE;
+
+	return FALSE;
+}
+
+
+/**
+ * Refresh the paper definitions at the user's request, clearing any old
+ * write results from the status line.
+ */
+
+static void list_refresh_definitions(void)
+{
+	list_write_report_valid = FALSE;
+
+	paper_request_rescan();
+	windows_redraw(list_window);
+}
+
+
+/**
+ * Find the index group into which a paper definition falls, based on its
+ * root and its position in the source display order.
+ *
+ * \param *paper		The paper definition to locate.
+ * \param root_count		The number of paper roots.
+ * \return			The group number, or -1 if none.
+ */
+
+static int list_find_paper_group(struct paper_size *paper, int root_count)
+{
+	int	source;
+
+	if (paper->root < 0 || paper->root >= root_count)
+		return -1;
+
+	for (source = 0; source < LIST_SOURCE_COUNT; source++) {
+		if (list_source_order[source] == paper->source)
+			return (paper->root * LIST_GROUPS_PER_ROOT) + source;
+	}
+
+	return -1;
+}
+
+
+/**
  * Turn a mouse position over the list window into an interactive
  * help token.
  *
@@ -991,9 +1819,15 @@ static void list_decode_window_help(char *buffer, wimp_w w, wimp_i i, os_coord p
 	case LIST_LINE_TYPE_PAPER:
 		string_printf(buffer, IHELP_INAME_LEN, "Col%d", column);
 		break;
+	case LIST_LINE_TYPE_ORPHAN:
+		string_printf(buffer, IHELP_INAME_LEN, "Orphan");
+		break;
 	case LIST_LINE_TYPE_SEPARATOR:
 		string_printf(buffer, IHELP_INAME_LEN, "Separator");
 		break;
+	case LIST_LINE_TYPE_STATUS:
+		string_printf(buffer, IHELP_INAME_LEN, "Status");
+		break;
 	}
 }
 
@@ -1230,20 +2064,58 @@ static void list_select_none(void)
 
 static void list_write_selected_files(void)
 {
-	int	i;
+	int		i;
+	unsigned	plan[PAPER_WRITE_ACTION_COUNT];
+	char		number[3][LIST_NUMBER_BUFFER_LEN];
+	osbool		overwrite = TRUE;
 
 	if (list_selection_count == 0)
 		return;
 
-	paper_ensure_ps2_file_folder();
+	/* Work out what will happen to each of the selected snippets in a
+	 * single pass, so that any unrecognised files can be confirmed with
+	 * one question instead of one for each file.
+	 */
+
+	memset(plan, 0, sizeof(plan));
 
 	for (i = 0; i < list_index_count; i++) {
-		if ((list_index[i].type == LIST_LINE_TYPE_PAPER) && (list_index[i].flags & LIST_LINE_FLAGS_SELECTED)) {
-			paper_write_file(list_index[i].index);
+		if ((list_index[i].type == LIST_LINE_TYPE_PAPER) && (list_index[i].flags & LIST_LINE_FLAGS_SELECTED))
+			plan[paper_plan_write(list_index[i].index)]++;
+	}
+
+	if (plan[PAPER_WRITE_ACTION_FOREIGN] > 0) {
+		string_printf(number[0], LIST_NUMBER_BUFFER_LEN, "%u", plan[PAPER_WRITE_ACTION_NEW]);
+		string_printf(number[1], LIST_NUMBER_BUFFER_LEN, "%u", plan[PAPER_WRITE_ACTION_INCORRECT]);
+		string_printf(number[2], LIST_NUMBER_BUFFER_LEN, "%u", plan[PAPER_WRITE_ACTION_FOREIGN]);
+
+		switch (error_msgs_param_report_question("OverwritePlan", "OverwritePlanB", number[0], number[1], number[2], NULL)) {
+		case 3:
+			overwrite = TRUE;
+			break;
+		case 4:
+			overwrite = FALSE;
+			break;
+		default:
+			return;
 		}
 	}
 
-	paper_read_definitions();
+	if (plan[PAPER_WRITE_ACTION_NEW] + plan[PAPER_WRITE_ACTION_INCORRECT] + ((overwrite) ? plan[PAPER_WRITE_ACTION_FOREIGN] : 0) == 0)
+		return;
+
+	paper_ensure_ps2_file_folder();
+
+	for (i = 0; i < list_index_count; i++) {
+		if ((list_index[i].type == LIST_LINE_TYPE_PAPER) && (list_index[i].flags & LIST_LINE_FLAGS_SELECTED))
+			paper_write_file(list_index[i].index, overwrite);
+	}
+
+	/* The writes complete in the background, after which the definitions
+	 * will be re-read; for now, just show the status line.
+	 */
+
+	list_rescan_paper_definitions();
 }
 
 
@@ -1267,6 +2139,256 @@ static void list_launch_selected_files(void)
 }
 
 
+/**
+ * Change the width or height of the selected paper size to the value
+ * entered into the corresponding menu field, in the current display units.
+ *
+ * \param width			TRUE to change the width; FALSE for the height.
+ */
+
+static void list_edit_selected_size(osbool width)
+{
+	struct paper_size	*paper;
+	int			definition, new_width, new_height;
+	double			unit_scale, value;
+	char			*unit_format, *text;
+
+	if (list_selection_count != 1)
+		return;
+
+	definition = list_index[list_selection_row].index;
+
+	text = menus_get_indirected_text_addr((width) ? list_window_width_menu : list_window_height_menu, LIST_EDIT_MENU_VALUE);
+	value = atof(text);
+
+	list_get_units(&unit_scale, &unit_format);
+
+	paper = paper_get_definitions();
+	new_width = (width) ? (int) (value * unit_scale + 0.5) : paper[definition].width;
+	new_height = (width) ? paper[definition].height : (int) (value * unit_scale + 0.5);
+
+	if (new_width <= 0 || new_height <= 0) {
+		error_msgs_report_error("EditBadSize");
+		return;
+	}
+
+	if (!paper_set_user_size(definition, new_width, new_height))
+		error_msgs_report_error("EditFail");
+}
+
+
+/**
+ * Copy the size of the selected paper definition into a user definition,
+ * using the name entered into the menu field.
+ */
+
+static void list_copy_selected_size(void)
+{
+	char	name[PAPER_NAME_LEN];
+
+	if (list_selection_count != 1)
+		return;
+
+	string_copy(name, menus_get_indirected_text_addr(list_window_copy_menu, LIST_EDIT_MENU_VALUE), PAPER_NAME_LEN);
+
+	if (!paper_add_user_size(list_index[list_selection_row].index, name))
+		error_msgs_report_error("EditFail");
+}
+
+
+/**
+ * Delete the selected user paper definition, after checking with the user.
+ */
+
+static void list_delete_selected_size(void)
+{
+	struct paper_size	*paper;
+	int			definition;
+
+	if (list_selection_count != 1)
+		return;
+
+	definition = list_index[list_selection_row].index;
+
+	paper = paper_get_definitions();
+	if (error_msgs_param_report_question("DeleteUser", "DeleteUserB", paper[definition].name, NULL, NULL, NULL) != 3)
+		return;
+
+	if (!paper_delete_user_size(definition))
+		error_msgs_report_error("EditFail");
+}
+
+
+/**
+ * Export snippets in all of the supported formats for every paper
+ * definition to a single text file in the scrap folder, then open it.
+ */
+
+static void list_export_snippets(void)
+{
+	os_error	*error;
+
+	if (!snippet_write_catalogue(LIST_EXPORT_SNIPPETS_FILE, SNIPPET_FORMAT_FLAGS_ALL)) {
+		error_msgs_report_error("ExportFail");
+		return;
+	}
+
+	error = xos_cli("%Filer_Run " LIST_EXPORT_SNIPPETS_FILE);
+	if (error != NULL)
+		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
+}
+
+
+/**
+ * Write an audit report on the paper roots to a text file in the scrap
+ * folder, then open it.
+ */
+
+static void list_export_audit(void)
+{
+	os_error	*error;
+
+	if (!audit_write_report(LIST_EXPORT_AUDIT_FILE)) {
+		error_msgs_report_error("ExportFail");
+		return;
+	}
+
+	error = xos_cli("%Filer_Run " LIST_EXPORT_AUDIT_FILE);
+	if (error != NULL)
+		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
+}
+
+
+/**
+ * Write the paper sizes out as a PPD file fragment in the scrap folder,
+ * then open it.
+ */
+
+static void list_export_ppd(void)
+{
+	os_error	*error;
+
+	if (!snippet_write_ppd(LIST_EXPORT_PPD_FILE)) {
+		error_msgs_report_error("ExportFail");
+		return;
+	}
+
+	error = xos_cli("%Filer_Run " LIST_EXPORT_PPD_FILE);
+	if (error != NULL)
+		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
+}
+
+
+/**
+ * Write a report of the paper sizes which are near duplicates of each
+ * other to a text file in the scrap folder, then open it.
+ */
+
+static void list_export_near(void)
+{
+	os_error	*error;
+
+	if (!duplicate_write_report(LIST_EXPORT_NEAR_FILE, config_int_read("NearTolerance"))) {
+		error_msgs_report_error("ExportFail");
+		return;
+	}
+
+	error = xos_cli("%Filer_Run " LIST_EXPORT_NEAR_FILE);
+	if (error != NULL)
+		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
+}
+
+
+/**
+ * Build the root filter submenu to reflect the current paper roots, and
+ * link it in to the list window menu. The menu block holds its own copies
+ * of the root names, so that it remains valid if the roots are re-read
+ * while it is open.
+ */
+
+static void list_build_root_menu(void)
+{
+	wimp_menu	*menu;
+	size_t		entries, entry;
+	char		*text;
+	int		width;
+
+	entries = paper_get_root_count() + 1;
+
+	menu = malloc(wimp_SIZEOF_MENU(entries) + (entries * PAPER_ROOT_NAME_LEN));
+	if (menu == NULL) {
+		list_window_menu->entries[LIST_MENU_ROOTS].sub_menu = wimp_NO_SUB_MENU;
+		return;
+	}
+
+	if (list_window_root_menu != NULL)
+		free(list_window_root_menu);
+
+	list_window_root_menu = menu;
+
+	text = (char *) menu + wimp_SIZEOF_MENU(entries);
+
+	msgs_lookup("RootMenu", menu->title_data.text, 12);
+	menu->title_fg = wimp_COLOUR_BLACK;
+	menu->title_bg = wimp_COLOUR_LIGHT_GREY;
+	menu->work_fg = wimp_COLOUR_BLACK;
+	menu->work_bg = wimp_COLOUR_WHITE;
+	menu->width = 0;
+	menu->height = 44;
+	menu->gap = 0;
+
+	for (entry = 0; entry < entries; entry++) {
+		if (entry == LIST_ROOT_MENU_ALL)
+			msgs_lookup("RootAll", text, PAPER_ROOT_NAME_LEN);
+		else
+			string_copy(text, paper_get_root_name(entry - LIST_ROOT_MENU_ALL - 1), PAPER_ROOT_NAME_LEN);
+
+		menu->entries[entry].menu_flags = 0;
+		if (entry == list_root_filter + LIST_ROOT_MENU_ALL + 1)
+			menu->entries[entry].menu_flags |= wimp_MENU_TICKED;
+		if (entry == LIST_ROOT_MENU_ALL)
+			menu->entries[entry].menu_flags |= wimp_MENU_SEPARATE;
+		if (entry == entries - 1)
+			menu->entries[entry].menu_flags |= wimp_MENU_LAST;
+
+		menu->entries[entry].sub_menu = wimp_NO_SUB_MENU;
+		menu->entries[entry].icon_flags = wimp_ICON_TEXT | wimp_ICON_FILLED | wimp_ICON_INDIRECTED |
+				(wimp_COLOUR_BLACK << wimp_ICON_FG_COLOUR_SHIFT) | (wimp_COLOUR_WHITE << wimp_ICON_BG_COLOUR_SHIFT);
+		menu->entries[entry].data.indirected_text.text = text;
+		menu->entries[entry].data.indirected_text.validation = (char *) -1;
+		menu->entries[entry].data.indirected_text.size = PAPER_ROOT_NAME_LEN;
+
+		if (xwimptextop_string_width(text, 0, &width) == NULL && width + 16 > menu->width)
+			menu->width = width + 16;
+
+		text += PAPER_ROOT_NAME_LEN;
+	}
+
+	list_window_menu->entries[LIST_MENU_ROOTS].sub_menu = menu;
+}
+
+
+/**
+ * Set the paper root displayed in the list window, and rebuild the list
+ * to match.
+ *
+ * \param root			The root to display, or LIST_ROOT_FILTER_ALL.
+ */
+
+static void list_set_root_filter(int root)
+{
+	if (root < LIST_ROOT_FILTER_ALL || root >= (int) paper_get_root_count())
+		root = LIST_ROOT_FILTER_ALL;
+
+	if (root == list_root_filter)
+		return;
+
+	list_root_filter = root;
+
+	list_rescan_paper_definitions();
+}
+
+
 /**
  * Set the dimensions used in the paper list, updating the various display
  * locations to match and refreshing the list.
@@ -1279,6 +2401,248 @@ static void list_set_dimensions(enum list_units units)
 	list_display_units = units;
 	icons_set_radio_group_selected(list_pane, units, 3, LIST_MM_ICON, LIST_INCH_ICON, LIST_POINT_ICON);
 
+	/* The dimension texts have all changed, so the columns must be refitted
+	 * from scratch; this happens on the next rescan if the window is closed.
+	 */
+
+	list_fitted_count = 0;
+
 	if (windows_get_open(list_window))
-		windows_redraw(list_window);
+		list_rescan_paper_definitions();
+}
+
+
+/**
+ * Return the scale and printf() format for displaying dimensions in the
+ * current display units.
+ *
+ * \param *scale		Pointer to a variable to take the number of
+ *				millipoints in a unit.
+ * \param **format		Pointer to a variable to take the format.
+ */
+
+static void list_get_units(double *scale, char **format)
+{
+	switch (list_display_units) {
+	case LIST_UNITS_MM:
+		*scale = 2834.64567;
+		*format = "%.1f";
+		break;
+	case LIST_UNITS_INCH:
+		*scale = 72000.0;
+		*format = "%.3f";
+		break;
+	case LIST_UNITS_POINT:
+	default:
+		*scale = 1000.0;
+		*format = "%.1f";
+		break;
+	}
+}
+
+
+/**
+ * Return the text to show in the Size column for a paper definition. Unless
+ * the size is ambiguous, any relationship to a standard size is shown in
+ * place of the size status.
+ *
+ * \param *paper		The paper definition to describe.
+ * \param *buffer		A buffer of LIST_ICON_BUFFER_LEN bytes, which may
+ *				be used to build the text.
+ * \param *number		A buffer of LIST_NUMBER_BUFFER_LEN bytes, which may
+ *				be used to format numbers.
+ * \return			Pointer to the text.
+ */
+
+static char *list_get_size_text(struct paper_size *paper, char *buffer, char *number)
+{
+	if (paper->size_status == PAPER_SIZE_STATUS_AMBIGUOUS || paper->standard_match == STANDARD_MATCH_NONE ||
+			paper->standard_match >= LIST_STANDARD_TEXT_COUNT)
+		return (paper->size_status < LIST_SIZE_STATUS_COUNT) ? list_size_status_text[paper->size_status] : "";
+
+	string_printf(number, LIST_NUMBER_BUFFER_LEN, "%.1f", (double) (paper->standard_error / 2834.64567));
+	list_expand_text(buffer, LIST_ICON_BUFFER_LEN, list_standard_text[paper->standard_match],
+			standard_get_name(paper->standard), number, NULL);
+
+	return buffer;
+}
+
+
+/**
+ * Stop tracking the column texts for a paper definition, before it is
+ * changed in place. Definitions which haven't yet been fitted are ignored.
+ *
+ * \param definition		The index of the definition.
+ */
+
+void list_remove_paper_texts(size_t definition)
+{
+	if (definition < list_fitted_count)
+		list_measure_paper(definition, FALSE);
+}
+
+
+/**
+ * Start tracking the column texts for a paper definition again, after it
+ * has been changed in place. Definitions which haven't yet been fitted are
+ * ignored, as they will be picked up by the next rescan.
+ *
+ * \param definition		The index of the definition.
+ */
+
+void list_add_paper_texts(size_t definition)
+{
+	if (definition < list_fitted_count)
+		list_measure_paper(definition, TRUE);
+}
+
+
+/**
+ * Note that a paper definition has been removed from the catalogue, and
+ * that those after it have moved down by one. Its line is taken out of the
+ * index without rebuilding it, and the rest of the selection is kept. Its
+ * texts should already have been removed with list_remove_paper_texts().
+ *
+ * \param definition		The index of the definition which was removed.
+ */
+
+void list_remove_paper_definition(size_t definition)
+{
+	size_t	line, removed;
+
+	if (definition < list_fitted_count)
+		list_fitted_count--;
+
+	if (list_index == NULL)
+		return;
+
+	removed = list_index_count;
+
+	for (line = 0; line < list_index_count; line++) {
+		if (list_index[line].type != LIST_LINE_TYPE_PAPER)
+			continue;
+
+		if (list_index[line].index == (int) definition)
+			removed = line;
+		else if (list_index[line].index > (int) definition)
+			list_index[line].index--;
+	}
+
+	if (removed >= list_index_count)
+		return;
+
+	if (list_index[removed].flags & LIST_LINE_FLAGS_SELECTED)
+		list_selection_count--;
+
+	memmove(list_index + removed, list_index + removed + 1, (list_index_count - removed - 1) * sizeof(struct list_redraw));
+	list_index_count--;
+
+	/* Keep the selected row pointing at the first selected line. */
+
+	if (list_selection_count == 0) {
+		list_selection_row = -1;
+	} else if (list_selection_row == removed) {
+		for (line = 0; line < list_index_count; line++) {
+			if (list_index[line].flags & LIST_LINE_FLAGS_SELECTED) {
+				list_selection_row = line;
+				break;
+			}
+		}
+	} else if (list_selection_row > (int) removed) {
+		list_selection_row--;
+	}
+
+	list_set_window_extent();
+	list_redraw_lines(removed, list_index_count + 1);
+	list_toolbar_set_buttons();
+}
+
+
+/**
+ * Add the texts for any paper definitions which haven't yet been seen to
+ * the auto-fit columns, and then fit the column widths to match. Once a
+ * load has completed, all of the definitions are refitted from scratch so
+ * that the final size statuses are taken into account; after that, any
+ * single definitions changed in place are handled by removing and adding
+ * their texts.
+ *
+ * \param complete		TRUE if the background load is complete.
+ * \return			TRUE if the column widths changed; else FALSE.
+ */
+
+static osbool list_fit_columns(osbool complete)
+{
+	size_t	paper_count, i;
+
+	paper_count = paper_get_definition_count();
+
+	if ((complete && list_fit_pending) || list_fitted_count == 0 || paper_count < list_fitted_count) {
+		columns_reset_widths(list_columns);
+		list_fitted_count = 0;
+	}
+
+	list_fit_pending = !complete;
+
+	for (i = list_fitted_count; i < paper_count; i++)
+		list_measure_paper(i, TRUE);
+
+	list_fitted_count = paper_count;
+
+	return columns_fit_widths(list_columns);
+}
+
+
+/**
+ * Add or remove the texts for a paper definition to or from the auto-fit
+ * columns.
+ *
+ * \param definition		The index of the definition.
+ * \param add			TRUE to add the texts; FALSE to remove them.
+ */
+
+static void list_measure_paper(size_t definition, osbool add)
+{
+	struct paper_size	paper;
+	double			unit_scale;
+	char			*unit_format, buffer[LIST_ICON_BUFFER_LEN], number[LIST_NUMBER_BUFFER_LEN];
+	void			(*measure)(struct columns_block *, int, char *);
+
+	if (definition >= paper_get_definition_count())
+		return;
+
+	measure = (add) ? columns_add_text : columns_remove_text;
+
+	list_get_units(&unit_scale, &unit_format);
+
+	/* The definitions are in a flex block, and measuring new texts can
+	 * claim memory, so take a copy of the definition before use.
+	 */
+
+	paper = paper_get_definitions()[definition];
+
+	measure(list_columns, LIST_COLUMN_PAPER_NAME, paper.name);
+	measure(list_columns, LIST_COLUMN_PAPER_FILE, paper.ps2_file);
+
+	string_printf(buffer, LIST_ICON_BUFFER_LEN, unit_format, (double) (paper.width / unit_scale));
+	measure(list_columns, LIST_COLUMN_WIDTH, buffer);
+
+	string_printf(buffer, LIST_ICON_BUFFER_LEN, unit_format, (double) (paper.height / unit_scale));
+	measure(list_columns, LIST_COLUMN_HEIGHT, buffer);
+
+	measure(list_columns, LIST_COLUMN_SIZE, list_get_size_text(&paper, buffer, number));
+}
+
+
+/**
+ * Set the foreground colour of an icon to show whether the value in it has
+ * changed since the previous load.
+ *
+ * \param *icon		The icon to update.
+ * \param highlight		TRUE to highlight the icon; FALSE to plot normally.
+ */
+
+static void list_highlight_icon(wimp_icon *icon, osbool highlight)
+{
+	icon->flags &= ~wimp_ICON_FG_COLOUR;
+	icon->flags |= ((highlight) ? LIST_CHANGE_COLOUR : LIST_NORMAL_COLOUR) << wimp_ICON_FG_COLOUR_SHIFT;
 }
@@ -34,6 +34,8 @@
 
 #include "oslib/osspriteop.h"
 
+#include "queue.h"
+
 
 /**
  * Initialise the list window.
@@ -45,7 +47,8 @@ void list_initialise(osspriteop_area *sprites);
 
 
 /**
- * Open the List window centred on the screen.
+ * Open the List window centred on the screen, starting to read the paper
+ * definitions if this is the first time that they have been needed.
  */
 
 void list_open_window(void);
@@ -57,4 +60,77 @@ void list_open_window(void);
 
 void list_rescan_paper_definitions(void);
 
+
+/**
+ * Add a line to the List window for a paper definition which has just been
+ * added to the end of the catalogue, without rebuilding the whole index.
+ *
+ * \param definition		The index of the new definition.
+ */
+
+void list_insert_paper_definition(size_t definition);
+
+
+/**
+ * Redraw the List window lines for a paper definition which has been changed
+ * in place, refitting the columns to the new texts first.
+ *
+ * \param definition		The index of the definition.
+ */
+
+void list_update_paper_definition(size_t definition);
+
+
+/**
+ * Request the List window to update its display of the paper definitions
+ * and background load progress, without rebuilding its index.
+ *
+ * \param first			The first definition which has been updated.
+ * \param end			The definition after the last to be updated.
+ */
+
+void list_update_load_progress(size_t first, size_t end);
+
+
+/**
+ * Stop tracking the column texts for a paper definition, before it is
+ * changed in place. Definitions which haven't yet been fitted are ignored.
+ *
+ * \param definition		The index of the definition.
+ */
+
+void list_remove_paper_texts(size_t definition);
+
+
+/**
+ * Start tracking the column texts for a paper definition again, after it
+ * has been changed in place. Definitions which haven't yet been fitted are
+ * ignored, as they will be picked up by the next rescan.
+ *
+ * \param definition		The index of the definition.
+ */
+
+void list_add_paper_texts(size_t definition);
+
+
+/**
+ * Note that a paper definition has been removed from the catalogue, and
+ * that those after it have moved down by one. Its line is taken out of the
+ * index, keeping the rest of the selection. Its texts should already have
+ * been removed with list_remove_paper_texts().
+ *
+ * \param definition		The index of the definition which was removed.
+ */
+
+void list_remove_paper_definition(size_t definition);
+
+
+/**
+ * Report the results of a batch of snippet writes in the List window.
+ *
+ * \param *report		The results to be reported.
+ */
+
+void list_report_write_status(struct queue_report *report);
+
 #endif
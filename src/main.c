@@ -63,6 +63,9 @@
 #include "iconbar.h"
 #include "list.h"
 #include "paper.h"
+#include "query.h"
+#include "scheduler.h"
+#include "trace.h"
 
 /**
  * The size of buffer allocated to resource filename processing.
@@ -120,7 +123,9 @@ static void main_poll_loop(void)
 	wimp_block		blk;
 
 	while (!main_quit_flag) {
-		reason = wimp_poll(wimp_MASK_NULL, &blk, 0);
+		reason = wimp_poll((scheduler_tasks_pending()) ? 0 : wimp_MASK_NULL, &blk, 0);
+
+		TRACE_EVENT(TRACE_EVENT_POLL, reason, 0);
 
 		/* Events are passed to Event Lib first; only if this fails
 		 * to handle them do they get passed on to the internal
@@ -129,6 +134,10 @@ static void main_poll_loop(void)
 
 		if (!event_process_event(reason, &blk, 0, NULL)) {
 			switch (reason) {
+			case wimp_NULL_REASON_CODE:
+				scheduler_poll();
+				break;
+
 			case wimp_OPEN_WINDOW_REQUEST:
 				wimp_open_window(&(blk.open));
 				break;
@@ -194,6 +203,8 @@ static void main_initialise(void)
 	config_initialise(task_name, "PS2Paper", "<PS2Paper$Dir>");
 
 //	config_str_init("ScriptFile", "<ProcText$Dir>.ScriptFile");
+	config_int_init("NearTolerance", 500);
+	config_int_init("QueryMessage", 0);
 
 	config_load();
 
@@ -224,6 +235,7 @@ static void main_initialise(void)
 	iconbar_initialise();
 	list_initialise(sprites);
 	paper_initialise();
+	query_initialise();
 	url_initialise();
 
 	templates_close();
@@ -42,18 +42,30 @@
 #include "oslib/fileswitch.h"
 #include "oslib/os.h"
 #include "oslib/osfile.h"
+#include "oslib/osfind.h"
+#include "oslib/osgbpb.h"
 #include "oslib/types.h"
 
 /* SF-Lib header files. */
 
 #include "sflib/errors.h"
+#include "sflib/msgs.h"
 #include "sflib/string.h"
 
 /* Application header files */
 
 #include "paper.h"
 
+#include "dircache.h"
+#include "journal.h"
 #include "list.h"
+#include "query.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "snippet.h"
+#include "standard.h"
+#include "trace.h"
+#include "userdef.h"
 
 /**
  * The maximum length of a paper definition filename.
@@ -73,381 +85,2704 @@
 
 #define PAPER_STORAGE_ALLOCATION 4
 
+/**
+ * The filetype used for PS2 snippet files.
+ */
+
+#define PAPER_SNIPPET_FILETYPE 0xff5u
+
+/**
+ * The file from which additional paper roots are read.
+ */
+
+#define PAPER_ROOTS_FILE "Choices:PS2Paper.Roots"
+
+/**
+ * The minimum number of slots in the snippet filename index; this is
+ * always a power of two.
+ */
+
+#define PAPER_FILE_INDEX_MIN_SIZE 16
+
+/**
+ * An empty slot in the snippet filename index.
+ */
+
+#define PAPER_FILE_INDEX_EMPTY (-1)
+
+/**
+ * The values of the current definition during a load when there isn't one:
+ * either none has been completed since the last name, or the last one
+ * couldn't be added and its fields are being discarded.
+ */
+
+#define PAPER_LOAD_NONE (-1)
+#define PAPER_LOAD_FAILED (-2)
+
+/**
+ * The minimum number of slots in the layer overlay index; this is always
+ * a power of two.
+ */
+
+#define PAPER_OVERLAY_INDEX_MIN_SIZE 64
+
+/**
+ * The length of the "ps.Paper" leaf at the end of a root's write folder,
+ * which must be removed to find the folder holding the user definitions.
+ */
+
+#define PAPER_WRITE_FOLDER_LEN 8
+
+/**
+ * The number of orphan spaces that we allocate on each change.
+ */
+
+#define PAPER_ORPHAN_ALLOCATION 16
+
+/**
+ * The amount of each snippet file which is read for verification.
+ */
+
+#define PAPER_SNIPPET_READ_LEN 1024
+
+/**
+ * The header line which identifies a snippet written by PS2Paper.
+ */
+
+#define PAPER_SNIPPET_HEADER "% Created by PS2Paper\n"
+
+/**
+ * The length of the snippet header line.
+ */
+
+#define PAPER_SNIPPET_HEADER_LEN (sizeof(PAPER_SNIPPET_HEADER) - 1)
+
+/**
+ * Word constants used to search a word of a snippet for newlines at once:
+ * a byte value repeated in each byte of the word.
+ */
+
+#define PAPER_SCAN_ONES 0x01010101u
+#define PAPER_SCAN_HIGHS 0x80808080u
+#define PAPER_SCAN_NEWLINES 0x0a0a0a0au
+
+/**
+ * The minimum number of slots in the snippet result cache; this is
+ * always a power of two.
+ */
+
+#define PAPER_SNIPPET_CACHE_MIN_SIZE 64
+
+/**
+ * The minimum size of the block holding the snippet contents which have
+ * been parsed, in bytes.
+ */
+
+#define PAPER_SNIPPET_TEXT_MIN_SIZE 16384
+
+/**
+ * The starting value and multiplier for the FNV-1a content hash.
+ */
+
+#define PAPER_HASH_SEED 2166136261u
+#define PAPER_HASH_PRIME 16777619u
+
+/**
+ * A paper definition source file, relative to a paper root.
+ */
+
+struct paper_source_file {
+	char			*file;				/**< The name of the definition file.				*/
+	enum paper_source	source;				/**< The source of the definitions in the file.			*/
+	osbool			choices;			/**< TRUE if the file is in the choices; FALSE if in Printers.	*/
+};
+
+/**
+ * The state of a background paper definition load.
+ */
+
+struct paper_load_state {
+	enum paper_load_stage	stage;				/**< The current stage of the load.				*/
+	int			root;				/**< The index of the root being parsed.			*/
+	int			file;				/**< The index of the source file being parsed.			*/
+	FILE			*in;				/**< The handle of the source file being parsed, or NULL.	*/
+	char			name[PAPER_NAME_LEN];		/**< The name of the definition being parsed.			*/
+	unsigned		width;				/**< The width of the definition being parsed.			*/
+	unsigned		height;				/**< The height of the definition being parsed.			*/
+	int			field_start;			/**< The first field belonging to the definition being parsed.	*/
+	int			current;			/**< The last definition completed since its name, or PAPER_LOAD_NONE.	*/
+	size_t			next;				/**< The next definition to be verified or scanned.		*/
+};
+
+/**
+ * The result of parsing the contents of a snippet file.
+ */
+
+struct paper_snippet_result {
+	osbool			used;				/**< TRUE if the cache slot is in use; else FALSE.		*/
+	unsigned		hash;				/**< The hash of the contents which were parsed.		*/
+	size_t			length;				/**< The length of the contents which were parsed.		*/
+	size_t			text;				/**< The offset of the contents in the snippet text block.	*/
+	osbool			recognised;			/**< TRUE if the snippet was written by PS2Paper.		*/
+	unsigned		width;				/**< The page width found in the snippet, in millipoints.	*/
+	unsigned		height;				/**< The page height found in the snippet, in millipoints.	*/
+};
+
+/**
+ * The location being searched for orphaned snippets.
+ */
+
+struct paper_orphan_search {
+	int			root;				/**< The index of the root being searched.			*/
+	osbool			choices;			/**< TRUE if searching the choices; FALSE if Printers.		*/
+};
+
+/**
+ * The paper definition source files within each root, in the order that
+ * they are read.
+ */
+
+static struct paper_source_file	paper_source_files[] = {
+	{"PaperRO", PAPER_SOURCE_MASTER, FALSE},
+	{"PaperRW", PAPER_SOURCE_USER, TRUE},
+	{"ps.Resources.PaperRO", PAPER_SOURCE_DEVICE, FALSE}
+};
+
+#define PAPER_SOURCE_FILE_COUNT (sizeof(paper_source_files) / sizeof(struct paper_source_file))
+
 static struct paper_size	*paper_sizes = NULL;		/**< Linked list of paper sizes.				*/
 static size_t			paper_allocation = 0;		/**< The number of spaces allocated for paper definitions.	*/
 static size_t			paper_count = 0;		/**< Number of defined paper sizes.				*/
 
+static struct paper_root	*paper_roots = NULL;		/**< The paper roots to be loaded.				*/
+static size_t			paper_root_count = 0;		/**< The number of paper roots.					*/
+
+static struct paper_load_state	paper_load;			/**< The state of the background load.				*/
+static osbool			paper_loaded = FALSE;		/**< TRUE once the definitions have first been read.		*/
+static unsigned			paper_rescan_requests = 0;	/**< The number of rescans requested since the last one ran.	*/
+
+static int			*paper_file_index = NULL;	/**< Hash index of definitions by root and snippet filename.	*/
+static unsigned			paper_file_index_size = 0;	/**< The number of slots in the filename index.			*/
+static unsigned			paper_file_index_count = 0;	/**< The number of slots in use in the filename index.		*/
+
+static int			*paper_overlay_index = NULL;	/**< Hash index of effective definitions by root and name.	*/
+static unsigned			paper_overlay_index_size = 0;	/**< The number of slots in the overlay index.			*/
+static unsigned			paper_overlay_index_count = 0;	/**< The number of slots in use in the overlay index.		*/
+
+static struct paper_orphan	*paper_orphans = NULL;		/**< The orphaned snippet files.				*/
+static size_t			paper_orphan_count = 0;		/**< The number of orphaned snippet files.			*/
+static size_t			paper_orphan_allocation = 0;	/**< The number of spaces allocated for orphans.		*/
+
+static struct paper_source_record	*paper_source_records = NULL;	/**< The source file details, by root and then file.	*/
+
+static struct paper_snippet_result	*paper_snippet_cache = NULL;	/**< Parsed snippet results, hashed by contents.	*/
+static unsigned				paper_snippet_cache_size = 0;	/**< The number of slots in the snippet cache.		*/
+static unsigned				paper_snippet_cache_count = 0;	/**< The number of slots in use in the snippet cache.	*/
+static char				*paper_snippet_text = NULL;	/**< The contents of the snippets in the cache.		*/
+static size_t				paper_snippet_text_size = 0;	/**< The number of bytes allocated to the snippet text.	*/
+static size_t				paper_snippet_text_used = 0;	/**< The number of bytes used in the snippet text.	*/
+static size_t				paper_snippets_checked = 0;	/**< The number of snippet files checked.		*/
+static size_t				paper_snippets_parsed = 0;	/**< The number of unique snippet contents parsed.	*/
+static char				paper_snippet_buffer[PAPER_SNIPPET_READ_LEN + 1];	/**< Buffer for reading snippets.	*/
+
+static void			paper_read_roots(void);
+static osbool			paper_add_root(char *name, char *printers, char *choices, char *write);
+static void			paper_set_root_path(char *path, char *value, char *leaf);
+static osbool			paper_find_snippet(struct paper_size *paper, char *buffer, size_t length);
+static osbool			paper_ensure_folder(char *path);
 static void			paper_clear_definitions(void);
 static osbool			paper_allocate_definition_space(unsigned new_allocation);
-static osbool			paper_read_def_file(char *file, enum paper_source source);
-static void			paper_scan_sizes(void);
+static osbool			paper_rescan_poll(os_t end_time, void *data);
+static osbool			paper_load_poll(os_t end_time, void *data);
+static void			paper_load_parse_line(void);
+static void			paper_reset_sources(void);
+static osbool			paper_record_source(int root, int file, FILE *in);
+static unsigned			paper_hash_data(char *data, size_t length, unsigned hash);
+static void			paper_get_source_path(int root, int file, char *buffer, size_t length);
+static osbool			paper_compare_file(FILE *in, char *filename);
+static void			paper_add_definition(char *name, unsigned width, unsigned height, enum paper_source source, int root, int first_field, int field_count);
+static void			paper_verify_definition(size_t paper);
+static osbool			paper_get_user_file(int root, char *source, char *target, size_t length);
+static void			paper_update_definition(size_t paper);
+static void			paper_rescan_file_group(int root, char *file);
+static void			paper_measure_file_group(int root, char *file, osbool add);
+static void			paper_redraw_file_group(int root, char *file);
+static void			paper_scan_size(size_t paper);
+static osbool			paper_build_file_index(void);
+static void			paper_file_index_add(size_t paper);
+static void			paper_file_index_remove(size_t paper);
+static void			paper_file_index_insert(size_t paper);
+static int			paper_find_file(int root, char *file);
+static unsigned			paper_file_hash(int root, char *file);
+static osbool			paper_overlay_rebuild(size_t count, unsigned size);
+static void			paper_overlay_add(size_t paper);
+static unsigned			paper_overlay_find_slot(int root, char *name);
+static void			paper_find_orphans(void);
+static void			paper_check_orphan(char *leaf, struct dircache_file *file, void *data);
+static osbool			paper_claim_orphans(int root, char *file);
+static osbool			paper_release_orphans(int root, char *file);
 static enum paper_file_status	paper_read_pagesize(struct paper_size *paper, char *file);
+static void			paper_parse_pagesize(char *text, size_t length, struct paper_snippet_result *result);
+static char			*paper_find_line_end(char *text, char *end);
+static char			*paper_match_pagesize(char *text, char *end);
+static char			*paper_parse_millipoints(char *text, char *end, unsigned *value);
+static struct paper_snippet_result	*paper_find_snippet_result(unsigned hash, char *text, size_t length);
+static struct paper_snippet_result	*paper_add_snippet_result(struct paper_snippet_result *result, char *text);
 static osbool			paper_write_pagesize(struct paper_size *paper, char *file_path);
+static void			paper_write_complete(struct queue_report *report);
+
+
+
+/**
+ * Initialise the paper definitions list. The definitions themselves are
+ * not read until paper_ensure_loaded() is called.
+ */
+
+void paper_initialise(void)
+{
+	if (flex_alloc((flex_ptr) &paper_sizes, 4) == 0)
+		paper_sizes = NULL;
+
+	paper_load.stage = PAPER_LOAD_STAGE_IDLE;
+	paper_load.in = NULL;
+
+	queue_initialise(paper_write_complete);
+	snippet_initialise();
+	fields_initialise();
+
+	paper_clear_definitions();
+}
+
+
+/**
+ * Start to read the paper definitions if they haven't been read since the
+ * application started. The catalogue isn't loaded until something needs it,
+ * so that the task starts up quickly.
+ */
+
+void paper_ensure_loaded(void)
+{
+	if (!paper_loaded)
+		paper_read_definitions();
+}
+
+
+/**
+ * Reset the paper definitions, then start to read them back in from the
+ * source files in Printers. The load takes place in the background, and
+ * the list window is updated as definitions become available.
+ */
+
+void paper_read_definitions(void)
+{
+	paper_loaded = TRUE;
+
+	paper_cancel_load();
+	paper_clear_definitions();
+	paper_read_roots();
+	paper_reset_sources();
+	dircache_reset();
+
+	TRACE_EVENT(TRACE_EVENT_PARSE_START, paper_root_count, 0);
+
+	paper_load.stage = PAPER_LOAD_STAGE_PARSE;
+	paper_load.root = 0;
+	paper_load.file = 0;
+	paper_load.in = NULL;
+	paper_load.next = 0;
+
+	if (!scheduler_add_task(paper_load_poll, NULL))
+		paper_load.stage = PAPER_LOAD_STAGE_IDLE;
+
+	list_rescan_paper_definitions();
+}
+
+
+/**
+ * Request that the paper definitions are re-read. The catalogue is marked
+ * as stale, and a single rescan is carried out on the next Null Event, so
+ * that any number of requests made before then are merged into one.
+ */
+
+void paper_request_rescan(void)
+{
+	if (paper_rescan_requests++ > 0)
+		return;
+
+	/* If the task can't be scheduled, fall back to rescanning at once. */
+
+	if (!scheduler_add_task(paper_rescan_poll, NULL)) {
+		paper_rescan_requests = 0;
+		paper_read_definitions();
+	}
+}
+
+
+/**
+ * Test whether a rescan has been requested but has yet to start.
+ *
+ * \return			TRUE if a rescan is pending; else FALSE.
+ */
+
+osbool paper_rescan_pending(void)
+{
+	return (paper_rescan_requests > 0) ? TRUE : FALSE;
+}
+
+
+/**
+ * Scheduler task to carry out a deferred rescan, once all of the requests
+ * made in the previous poll cycle have been collected together.
+ *
+ * \param end_time		The time by which the task should return.
+ * \param *data			Unused.
+ * \return			FALSE, as the task always completes.
+ */
+
+static osbool paper_rescan_poll(os_t end_time, void *data)
+{
+	TRACE_EVENT(TRACE_EVENT_RESCAN, paper_rescan_requests, 0);
+
+	paper_rescan_requests = 0;
+	paper_read_definitions();
+
+	return FALSE;
+}
+
+
+/**
+ * Cancel any background load which is in progress, leaving the definitions
+ * which have been read so far in place.
+ */
+
+void paper_cancel_load(void)
+{
+	if (paper_load.stage == PAPER_LOAD_STAGE_IDLE)
+		return;
+
+	scheduler_remove_task(paper_load_poll, NULL);
+
+	if (paper_load.in != NULL) {
+		fclose(paper_load.in);
+		paper_load.in = NULL;
+	}
+
+	paper_load.stage = PAPER_LOAD_STAGE_IDLE;
+
+	list_rescan_paper_definitions();
+}
+
+
+/**
+ * Report the progress of any background load.
+ *
+ * \param *done			Pointer to variable to take the number of items
+ *				processed in the current stage, or NULL.
+ * \param *total		Pointer to variable to take the number of items
+ *				in the current stage (or 0 if not known), or NULL.
+ * \return			The current stage of the load.
+ */
+
+enum paper_load_stage paper_get_load_stage(size_t *done, size_t *total)
+{
+	if (done != NULL)
+		*done = (paper_load.stage == PAPER_LOAD_STAGE_PARSE) ? paper_count : paper_load.next;
+
+	if (total != NULL)
+		*total = (paper_load.stage == PAPER_LOAD_STAGE_PARSE) ? 0 : paper_count;
+
+	return paper_load.stage;
+}
+
+
+/**
+ * Return the number of paper definitions which are currently stored.
+ *
+ * \return			The number of paper definitions.
+ */
+
+size_t paper_get_definition_count(void)
+{
+	return paper_count;
+}
+
+
+/**
+ * Return the number of paper roots which are currently defined. The
+ * first root is always the local system.
+ *
+ * \return			The number of paper roots.
+ */
+
+size_t paper_get_root_count(void)
+{
+	return paper_root_count;
+}
+
+
+/**
+ * Return the name of a paper root.
+ *
+ * \param root			The index of the root to return.
+ * \return			Pointer to the root name, or NULL.
+ */
+
+char *paper_get_root_name(int root)
+{
+	if (paper_roots == NULL || root < 0 || root >= paper_root_count)
+		return NULL;
+
+	return paper_roots[root].name;
+}
+
+
+/**
+ * Return a pointer to the paper definition array. This points into a flex
+ * heap, so the pointer will not remain valid if anything causes the heap
+ * to shift.
+ * 
+ * \return			Pointer to the first entry in the array.
+ */
+
+struct paper_size *paper_get_definitions(void)
+{
+	return paper_sizes;
+}
+
+
+/**
+ * Return the number of orphaned snippet files found by the last load.
+ *
+ * \return			The number of orphaned snippets.
+ */
+
+size_t paper_get_orphan_count(void)
+{
+	return paper_orphan_count;
+}
+
+
+/**
+ * Return a pointer to the orphaned snippet array.
+ *
+ * \return			Pointer to the first entry in the array, or NULL.
+ */
+
+struct paper_orphan *paper_get_orphans(void)
+{
+	return paper_orphans;
+}
+
+
+/**
+ * Return the number of definition source files in each root.
+ *
+ * \return			The number of source files.
+ */
+
+int paper_get_source_file_count(void)
+{
+	return PAPER_SOURCE_FILE_COUNT;
+}
+
+
+/**
+ * Return the name of a definition source file, relative to its root.
+ *
+ * \param file			The index of the source file.
+ * \return			Pointer to the name, or NULL.
+ */
+
+char *paper_get_source_file_name(int file)
+{
+	if (file < 0 || file >= PAPER_SOURCE_FILE_COUNT)
+		return NULL;
+
+	return paper_source_files[file].file;
+}
+
+
+/**
+ * Return the details of a definition source file in a root.
+ *
+ * \param root			The index of the root.
+ * \param file			The index of the source file.
+ * \return			Pointer to the details, or NULL.
+ */
+
+struct paper_source_record *paper_get_source_record(int root, int file)
+{
+	if (paper_source_records == NULL || root < 0 || root >= paper_root_count || file < 0 || file >= PAPER_SOURCE_FILE_COUNT)
+		return NULL;
+
+	return paper_source_records + (root * PAPER_SOURCE_FILE_COUNT) + file;
+}
+
+
+/**
+ * Report how many snippet files were checked by the last load, and how
+ * many of those had unique contents which needed to be parsed.
+ *
+ * \param *checked		Pointer to a variable to take the number checked, or NULL.
+ * \param *parsed		Pointer to a variable to take the number parsed, or NULL.
+ */
+
+void paper_get_snippet_statistics(size_t *checked, size_t *parsed)
+{
+	if (checked != NULL)
+		*checked = paper_snippets_checked;
+
+	if (parsed != NULL)
+		*parsed = paper_snippets_parsed;
+}
+
+
+/**
+ * Test whether a paper definition is the first in the catalogue to use its
+ * snippet filename, looking across all of the roots in order.
+ *
+ * \param definition		The index of the definition to test.
+ * \return			TRUE if the definition is the first to use its
+ *				filename; FALSE if it is a duplicate or invalid.
+ */
+
+osbool paper_is_first_file_use(size_t definition)
+{
+	struct paper_size	*paper;
+	int			root;
+
+	if (paper_sizes == NULL || definition >= paper_count)
+		return FALSE;
+
+	paper = paper_sizes + definition;
+
+	if (paper->ps2_file[0] == '\0')
+		return FALSE;
+
+	/* The index is built at the end of each load, so it will only be
+	 * missing if the load is still in progress.
+	 */
+
+	if (paper_file_index == NULL && !paper_build_file_index())
+		return FALSE;
+
+	for (root = 0; root < paper->root; root++) {
+		if (paper_find_file(root, paper->ps2_file) != PAPER_FILE_INDEX_EMPTY)
+			return FALSE;
+	}
+
+	return (paper_find_file(paper->root, paper->ps2_file) == definition) ? TRUE : FALSE;
+}
+
+
+/**
+ * Find the definition of a paper name which takes effect in a root, once
+ * the user, device and master definitions have been overlaid according to
+ * the printer driver's precedence.
+ *
+ * \param root			The index of the root to look in.
+ * \param *name			The name of the paper to look up.
+ * \return			The index of the effective definition, or -1.
+ */
+
+int paper_find_effective_definition(int root, char *name)
+{
+	if (paper_overlay_index == NULL || name == NULL)
+		return PAPER_FILE_INDEX_EMPTY;
+
+	return paper_overlay_index[paper_overlay_find_slot(root, name)];
+}
+
+
+/**
+ * Return the size of paper which takes effect for a name in a root, once
+ * the definition layers have been overlaid.
+ *
+ * \param root			The index of the root to look in.
+ * \param *name			The name of the paper to look up.
+ * \param *width		Pointer to variable to take the width, or NULL.
+ * \param *height		Pointer to variable to take the height, or NULL.
+ * \return			TRUE if the name is defined; else FALSE.
+ */
+
+osbool paper_get_effective_size(int root, char *name, int *width, int *height)
+{
+	int	paper;
+
+	paper = paper_find_effective_definition(root, name);
+	if (paper == PAPER_FILE_INDEX_EMPTY)
+		return FALSE;
+
+	if (width != NULL)
+		*width = paper_sizes[paper].width;
+
+	if (height != NULL)
+		*height = paper_sizes[paper].height;
+
+	return TRUE;
+}
+
+
+/**
+ * Return the value of a field from a paper definition's source file which
+ * isn't otherwise held in the definition. This points into a flex heap, so
+ * the pointer will not remain valid if anything causes the heap to shift.
+ *
+ * \param definition		The index of the definition.
+ * \param *key			The key name of the field, without the colon.
+ * \return			Pointer to the value, or NULL if not present.
+ */
+
+char *paper_get_field(size_t definition, char *key)
+{
+	if (paper_sizes == NULL || definition >= paper_count)
+		return NULL;
+
+	return fields_get_value(fields_find(paper_sizes[definition].first_field, paper_sizes[definition].field_count, key));
+}
+
+
+/**
+ * Return the number of additional fields held for a paper definition.
+ *
+ * \param definition		The index of the definition.
+ * \return			The number of fields.
+ */
+
+int paper_get_field_count(size_t definition)
+{
+	if (paper_sizes == NULL || definition >= paper_count)
+		return 0;
+
+	return paper_sizes[definition].field_count;
+}
+
+
+/**
+ * Return one of the additional fields held for a paper definition, in the
+ * order that they appeared in the source file. The value points into a flex
+ * heap, so will not remain valid if anything causes the heap to shift.
+ *
+ * \param definition		The index of the definition.
+ * \param entry			The index of the field within the definition.
+ * \param **key			Pointer to a variable to take a pointer to the
+ *				key name, or NULL.
+ * \return			Pointer to the value, or NULL if not present.
+ */
+
+char *paper_get_field_entry(size_t definition, int entry, char **key)
+{
+	if (paper_sizes == NULL || definition >= paper_count || entry < 0 || entry >= paper_sizes[definition].field_count)
+		return NULL;
+
+	if (key != NULL)
+		*key = fields_get_key(paper_sizes[definition].first_field + entry);
+
+	return fields_get_value(paper_sizes[definition].first_field + entry);
+}
+
+
+/**
+ * Test whether a paper definition can be edited in place: it must be the
+ * effective user definition of its name, and the background load must not
+ * be running.
+ *
+ * \param definition		The index of the definition to test.
+ * \return			TRUE if the definition can be edited; else FALSE.
+ */
+
+osbool paper_can_edit_user_size(size_t definition)
+{
+	if (paper_sizes == NULL || definition >= paper_count || paper_load.stage != PAPER_LOAD_STAGE_IDLE)
+		return FALSE;
+
+	return (paper_sizes[definition].source == PAPER_SOURCE_USER && !paper_sizes[definition].shadowed) ? TRUE : FALSE;
+}
+
+
+/**
+ * Change the size of a user paper definition, patching the new values into
+ * the user definitions file and updating the definition in the catalogue.
+ *
+ * \param definition		The index of the definition to change.
+ * \param width			The new width, in millipoints.
+ * \param height		The new height, in millipoints.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool paper_set_user_size(size_t definition, int width, int height)
+{
+	char	source[PAPER_MAX_FILENAME_LENGTH], target[PAPER_MAX_FILENAME_LENGTH], name[PAPER_NAME_LEN];
+
+	if (!paper_can_edit_user_size(definition) || width <= 0 || height <= 0)
+		return FALSE;
+
+	if (!paper_get_user_file(paper_sizes[definition].root, source, target, PAPER_MAX_FILENAME_LENGTH))
+		return FALSE;
+
+	/* Take a copy of the name, as the flex heap might move. */
+
+	string_copy(name, paper_sizes[definition].name, PAPER_NAME_LEN);
+
+	if (!userdef_set_size(source, target, name, width, height))
+		return FALSE;
+
+	paper_measure_file_group(paper_sizes[definition].root, paper_sizes[definition].ps2_file, FALSE);
+
+	paper_sizes[definition].width = width;
+	paper_sizes[definition].height = height;
+
+	paper_update_definition(definition);
+	query_update_definition(definition);
+
+	return TRUE;
+}
+
+
+/**
+ * Copy the size of a paper definition into a user definition in the same
+ * root, adding the user definition to the user definitions file if it
+ * doesn't already exist.
+ *
+ * \param definition		The index of the definition to copy.
+ * \param *name			The name to give the user definition.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool paper_add_user_size(size_t definition, char *name)
+{
+	char		source[PAPER_MAX_FILENAME_LENGTH], target[PAPER_MAX_FILENAME_LENGTH], copy[PAPER_NAME_LEN], file[PAPER_FILE_LEN];
+	unsigned	width, height;
+	int		root, existing;
+	size_t		count, paper;
+
+	if (paper_sizes == NULL || definition >= paper_count || paper_load.stage != PAPER_LOAD_STAGE_IDLE || name == NULL)
+		return FALSE;
+
+	string_copy(copy, name, PAPER_NAME_LEN);
+	name = string_strip_surrounding_whitespace(copy);
+
+	if (*name == '\0')
+		return FALSE;
+
+	root = paper_sizes[definition].root;
+	width = paper_sizes[definition].width;
+	height = paper_sizes[definition].height;
+
+	/* If the name is already defined by the user, update it instead. */
+
+	existing = paper_find_effective_definition(root, name);
+	if (existing != PAPER_FILE_INDEX_EMPTY && paper_sizes[existing].source == PAPER_SOURCE_USER)
+		return paper_set_user_size(existing, width, height);
+
+	if (!paper_get_user_file(root, source, target, PAPER_MAX_FILENAME_LENGTH) || !userdef_set_size(source, target, name, width, height))
+		return FALSE;
+
+	/* If there's no room in the catalogue, the file has still been
+	 * updated, so fall back to reading everything in again.
+	 */
+
+	count = paper_count;
+	paper_add_definition(name, width, height, PAPER_SOURCE_USER, root, FIELDS_NONE, 0);
+
+	if (paper_count == count) {
+		paper_request_rescan();
+		return TRUE;
+	}
+
+	paper = paper_count - 1;
+
+	paper_measure_file_group(root, paper_sizes[paper].ps2_file, FALSE);
+	paper_update_definition(paper);
+	query_add_definition(paper);
+	list_insert_paper_definition(paper);
+
+	/* Any definition of the same name in a lower layer is now shadowed. */
+
+	if (existing != PAPER_FILE_INDEX_EMPTY)
+		list_update_paper_definition(existing);
+
+	/* If the new definition claims an orphaned snippet, the orphans will
+	 * have moved, so the list must be rebuilt; the selection is kept.
+	 */
+
+	string_copy(file, paper_sizes[paper].ps2_file, PAPER_FILE_LEN);
+
+	if (paper_claim_orphans(root, file))
+		list_rescan_paper_definitions();
+
+	return TRUE;
+}
+
+
+/**
+ * Delete a user paper definition, removing it from the user definitions
+ * file and from the catalogue. Any definition from a lower layer which it
+ * was shadowing takes effect again.
+ *
+ * \param definition		The index of the definition to delete.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool paper_delete_user_size(size_t definition)
+{
+	char		source[PAPER_MAX_FILENAME_LENGTH], target[PAPER_MAX_FILENAME_LENGTH], name[PAPER_NAME_LEN], file[PAPER_FILE_LEN];
+	unsigned	size;
+	int		root, effective;
+
+	if (!paper_can_edit_user_size(definition))
+		return FALSE;
+
+	root = paper_sizes[definition].root;
+	string_copy(name, paper_sizes[definition].name, PAPER_NAME_LEN);
+	string_copy(file, paper_sizes[definition].ps2_file, PAPER_FILE_LEN);
+
+	if (!paper_get_user_file(root, source, target, PAPER_MAX_FILENAME_LENGTH) || !userdef_delete(source, target, name))
+		return FALSE;
+
+	paper_measure_file_group(root, file, FALSE);
+	query_remove_definition(definition);
+	paper_file_index_remove(definition);
+
+	memmove(paper_sizes + definition, paper_sizes + definition + 1, (paper_count - definition - 1) * sizeof(struct paper_size));
+	paper_count--;
+
+	list_remove_paper_definition(definition);
+
+	/* Removing an entry means re-resolving the layers from scratch, to
+	 * find out which definition of the name now takes effect.
+	 */
+
+	for (size = PAPER_OVERLAY_INDEX_MIN_SIZE; size < paper_count * 2; size *= 2);
+	paper_overlay_rebuild(paper_count, size);
+
+	paper_rescan_file_group(root, file);
+	paper_measure_file_group(root, file, TRUE);
+	paper_redraw_file_group(root, file);
+
+	effective = paper_find_effective_definition(root, name);
+	if (effective != PAPER_FILE_INDEX_EMPTY)
+		list_update_paper_definition(effective);
+
+	/* If that was the last definition using its snippet, the snippet may
+	 * now be an orphan; if so, the list must be rebuilt to show it.
+	 */
+
+	if (paper_release_orphans(root, file))
+		list_rescan_paper_definitions();
+
+	return TRUE;
+}
+
+
+/**
+ * Launch the snippet file relating to a paper definition, using a
+ * *Filer_Run command.
+ * 
+ * \param definition		The index into the definitions of the
+ *				definition to be launched.
+ */
+
+void paper_launch_file(int definition)
+{
+	char		buffer[PAPER_MAX_LINE_LEN], filename[PAPER_MAX_FILENAME_LENGTH];
+	os_error	*error;
+
+	if (definition < 0 || definition >= paper_count || paper_sizes[definition].ps2_file_status == PAPER_FILE_STATUS_MISSING)
+		return;
+
+	if (!paper_find_snippet(paper_sizes + definition, filename, PAPER_MAX_FILENAME_LENGTH))
+		return;
+
+	string_printf(buffer, PAPER_MAX_LINE_LEN, "%%Filer_Run -Shift %s", filename);
+	error = xos_cli(buffer);
+	if (error != NULL)
+		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
+}
+
+
+/**
+ * Write a new snipped file for a paper definition.
+ *
+ * \param definition		The index into the definitions of the
+ *				definition to be launched.
+ */
+
+void paper_write_file(int definition, osbool overwrite)
+{
+	switch (paper_plan_write(definition)) {
+	case PAPER_WRITE_ACTION_NEW:
+	case PAPER_WRITE_ACTION_INCORRECT:
+		break;
+	case PAPER_WRITE_ACTION_FOREIGN:
+		if (!overwrite)
+			return;
+		break;
+	default:
+		return;
+	}
+
+	paper_write_pagesize(paper_sizes + definition, paper_roots[paper_sizes[definition].root].write);
+
+	return;
+}
+
+
+/**
+ * Work out what writing a new snippet file for a paper definition would
+ * do, checking the existing snippet first if the background load hasn't
+ * yet reached it.
+ *
+ * \param definition		The index into the definitions of the
+ *				definition to be planned.
+ * \return			The action which a write would take.
+ */
+
+enum paper_write_action paper_plan_write(int definition)
+{
+	if (definition < 0 || definition >= paper_count)
+		return PAPER_WRITE_ACTION_NONE;
+
+	if (paper_roots == NULL || paper_sizes[definition].root >= paper_root_count)
+		return PAPER_WRITE_ACTION_NONE;
+
+	/* If the background load hasn't reached this definition yet, check
+	 * the snippet now so that we know whether it's safe to overwrite.
+	 */
+
+	if (paper_sizes[definition].ps2_file_status == PAPER_FILE_STATUS_UNCHECKED)
+		paper_verify_definition(definition);
+
+	switch (paper_sizes[definition].ps2_file_status) {
+	case PAPER_FILE_STATUS_MISSING:
+		return PAPER_WRITE_ACTION_NEW;
+	case PAPER_FILE_STATUS_INCORRECT:
+		return PAPER_WRITE_ACTION_INCORRECT;
+	case PAPER_FILE_STATUS_UNKNOWN:
+		return PAPER_WRITE_ACTION_FOREIGN;
+	default:
+		return PAPER_WRITE_ACTION_NONE;
+	}
+}
+
+
+/**
+ * Read the list of paper roots, starting with the local system and then
+ * adding any further roots listed in the roots file. Each entry in the file
+ * is a block of lines in the style of the Printers paper files:
+ *
+ *	rn: <name>
+ *	rp: <path to Printers application>
+ *	rc: <path to Printers choices>
+ */
+
+static void paper_read_roots(void)
+{
+	FILE	*in;
+	char	line[PAPER_MAX_LINE_LEN], *clean, *data;
+	char	name[PAPER_ROOT_NAME_LEN], printers[PAPER_ROOT_PATH_LEN], choices[PAPER_ROOT_PATH_LEN], write[PAPER_ROOT_PATH_LEN];
+
+	paper_root_count = 0;
+
+	/* The local system is always the first root. */
+
+	msgs_lookup("RootLocal", name, PAPER_ROOT_NAME_LEN);
+	paper_add_root(name, "Printers:", "PrinterChoices:", "<Choices$Write>.Printers.ps.Paper");
+
+	in = fopen(PAPER_ROOTS_FILE, "r");
+	if (in == NULL)
+		return;
+
+	*name = '\0';
+	*printers = '\0';
+	*choices = '\0';
+
+	while (fgets(line, PAPER_MAX_LINE_LEN, in) != NULL) {
+		string_ctrl_zero_terminate(line);
+		clean = string_strip_surrounding_whitespace(line);
+
+		if (*clean == '\0' || *clean == '#')
+			continue;
+
+		/* Only take the value once the prefix is known to be there, as
+		 * shorter lines have nothing after their terminator.
+		 */
+
+		if (strncmp(clean, "rn:", 3) != 0 && strncmp(clean, "rp:", 3) != 0 && strncmp(clean, "rc:", 3) != 0)
+			continue;
+
+		data = string_strip_surrounding_whitespace(clean + 3);
+
+		if (strncmp(clean, "rn:", 3) == 0)
+			string_copy(name, data, PAPER_ROOT_NAME_LEN);
+		else if (strncmp(clean, "rp:", 3) == 0)
+			paper_set_root_path(printers, data, NULL);
+		else
+			paper_set_root_path(choices, data, NULL);
+
+		if (*name != '\0' && *printers != '\0' && *choices != '\0') {
+			paper_set_root_path(write, choices, "ps.Paper");
+			paper_add_root(name, printers, choices, write);
+
+			*name = '\0';
+			*printers = '\0';
+			*choices = '\0';
+		}
+	}
+
+	fclose(in);
+}
+
+
+/**
+ * Add a paper root to the end of the list of roots.
+ *
+ * \param *name			The name of the root.
+ * \param *printers		The path prefix of the root's Printers application.
+ * \param *choices		The path prefix of the root's Printers choices.
+ * \param *write		The folder into which snippets should be written.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool paper_add_root(char *name, char *printers, char *choices, char *write)
+{
+	struct paper_root	*roots;
+
+	roots = realloc(paper_roots, (paper_root_count + 1) * sizeof(struct paper_root));
+	if (roots == NULL)
+		return FALSE;
+
+	paper_roots = roots;
+
+	string_copy(paper_roots[paper_root_count].name, name, PAPER_ROOT_NAME_LEN);
+	string_copy(paper_roots[paper_root_count].printers, printers, PAPER_ROOT_PATH_LEN);
+	string_copy(paper_roots[paper_root_count].choices, choices, PAPER_ROOT_PATH_LEN);
+	string_copy(paper_roots[paper_root_count].write, write, PAPER_ROOT_PATH_LEN);
+
+	paper_root_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Build a root path from a folder name. With no leaf, the result is a
+ * path prefix to which filenames can be appended directly; otherwise it is
+ * the leaf within the folder.
+ *
+ * \param *path			Pointer to a buffer of PAPER_ROOT_PATH_LEN to
+ *				take the path.
+ * \param *value		The folder or path prefix to start from.
+ * \param *leaf			The leaf to append, or NULL for a prefix.
+ */
+
+static void paper_set_root_path(char *path, char *value, char *leaf)
+{
+	size_t	length;
+	char	*separator;
+
+	length = strlen(value);
+	separator = (length > 0 && (value[length - 1] == '.' || value[length - 1] == ':')) ? "" : ".";
+
+	string_printf(path, PAPER_ROOT_PATH_LEN, "%s%s%s", value, separator, (leaf == NULL) ? "" : leaf);
+}
+
+
+/**
+ * Find the PS2 snippet file for a paper definition, looking in the root's
+ * choices first and then in its Printers application.
+ *
+ * \param *paper		The paper definition to find the snippet for.
+ * \param *buffer		Pointer to a buffer to take the snippet filename.
+ * \param length		The length of the buffer.
+ * \return			TRUE if the snippet was found; else FALSE.
+ */
+
+static osbool paper_find_snippet(struct paper_size *paper, char *buffer, size_t length)
+{
+	struct paper_root	*root;
+
+	if (paper == NULL || paper_roots == NULL || paper->root >= paper_root_count || paper->ps2_file[0] == '\0')
+		return FALSE;
+
+	root = paper_roots + paper->root;
+
+	string_printf(buffer, length, "%sps.Paper", root->choices);
+	if (dircache_find_file(buffer, paper->ps2_file, NULL)) {
+		string_printf(buffer, length, "%sps.Paper.%s", root->choices, paper->ps2_file);
+		return TRUE;
+	}
+
+	string_printf(buffer, length, "%sps.Paper", root->printers);
+	if (dircache_find_file(buffer, paper->ps2_file, NULL)) {
+		string_printf(buffer, length, "%sps.Paper.%s", root->printers, paper->ps2_file);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+/**
+ * Clear the paper definitions and release the memory used to hold them.
+ * Calling this function will also initialise the flex block and
+ * associated variables.
+ */
+
+static void paper_clear_definitions(void)
+{
+	query_reset();
+	journal_reset();
+	fields_reset();
+
+	paper_count = 0;
+	paper_allocation = 0;
+
+	paper_orphan_count = 0;
+
+	free(paper_snippet_cache);
+	paper_snippet_cache = NULL;
+	paper_snippet_cache_size = 0;
+	paper_snippet_cache_count = 0;
+	free(paper_snippet_text);
+	paper_snippet_text = NULL;
+	paper_snippet_text_size = 0;
+	paper_snippet_text_used = 0;
+	paper_snippets_checked = 0;
+	paper_snippets_parsed = 0;
+
+	free(paper_file_index);
+	paper_file_index = NULL;
+	paper_file_index_size = 0;
+	paper_file_index_count = 0;
+
+	free(paper_overlay_index);
+	paper_overlay_index = NULL;
+	paper_overlay_index_size = 0;
+	paper_overlay_index_count = 0;
+
+	if (paper_sizes == NULL)
+		return;
+
+	if (flex_extend((flex_ptr) &paper_sizes, 4) == 0)
+		paper_sizes = NULL;
+}
+
+
+/**
+ * Claim additional storage space for paper definitions.
+ * 
+ * \param new_allocation	The number of storage places required.
+ * \return			TRUE if successful; FALSE if allocation failed.
+ */
+
+static osbool paper_allocate_definition_space(unsigned new_allocation)
+{
+#ifdef TRACE
+	struct paper_size	*old_sizes = paper_sizes;
+#endif
+
+	if (paper_sizes == NULL)
+		return FALSE;
+
+	if (new_allocation <= paper_allocation)
+		return TRUE;
+
+	new_allocation = ((new_allocation / PAPER_STORAGE_ALLOCATION) + 1) * PAPER_STORAGE_ALLOCATION;
+
+	if (flex_extend((flex_ptr) &paper_sizes, new_allocation * sizeof(struct paper_size)) == 0)
+		return FALSE;
+
+	TRACE_EVENT(TRACE_EVENT_FLEX, new_allocation * sizeof(struct paper_size), paper_sizes != old_sizes);
+
+	paper_allocation = new_allocation;
+
+	return TRUE;
+}
+
+
+/**
+ * Run the background paper definition load for one time slice, as a
+ * scheduler task.
+ *
+ * \param end_time		The monotonic time by which the slice should end.
+ * \param *data			Unused.
+ * \return			TRUE if there is more to do; FALSE on completion.
+ */
+
+static osbool paper_load_poll(os_t end_time, void *data)
+{
+	size_t	initial_count = paper_count, first = paper_count, end = 0;
+
+	do {
+		switch (paper_load.stage) {
+		case PAPER_LOAD_STAGE_PARSE:
+			paper_load_parse_line();
+			break;
+
+		case PAPER_LOAD_STAGE_VERIFY:
+			if (paper_load.next < paper_count) {
+				if (paper_load.next < first)
+					first = paper_load.next;
+
+				paper_verify_definition(paper_load.next++);
+
+				if (paper_load.next > end)
+					end = paper_load.next;
+			} else {
+				TRACE_EVENT(TRACE_EVENT_VERIFY_END, paper_snippets_checked, paper_snippets_parsed);
+				paper_load.stage = PAPER_LOAD_STAGE_SCAN;
+				paper_load.next = 0;
+			}
+			break;
+
+		case PAPER_LOAD_STAGE_SCAN:
+			if (paper_load.next < paper_count) {
+				if (paper_load.next < first)
+					first = paper_load.next;
+
+				paper_scan_size(paper_load.next++);
+
+				if (paper_load.next > end)
+					end = paper_load.next;
+			} else {
+				paper_find_orphans();
+				journal_update();
+				paper_load.stage = PAPER_LOAD_STAGE_IDLE;
+			}
+			break;
+
+		case PAPER_LOAD_STAGE_IDLE:
+			break;
+		}
+	} while (paper_load.stage != PAPER_LOAD_STAGE_IDLE && os_read_monotonic_time() < end_time);
+
+	/* The list index only needs rebuilding if the number of definitions
+	 * has changed, or if the load has completed; otherwise, it's enough to
+	 * redraw the definitions which were checked and the status line.
+	 */
+
+	if (paper_count != initial_count || paper_load.stage == PAPER_LOAD_STAGE_IDLE)
+		list_rescan_paper_definitions();
+	else
+		list_update_load_progress(first, end);
+
+	return (paper_load.stage != PAPER_LOAD_STAGE_IDLE) ? TRUE : FALSE;
+}
+
+
+/**
+ * Process the next line of the Printers paper files, opening and closing
+ * the files as required and adding any completed paper definitions to the
+ * list of sizes. When the last file has been read, the load moves on to
+ * the verification stage.
+ */
+
+static void paper_load_parse_line(void)
+{
+	char				line[PAPER_MAX_LINE_LEN], *clean, *data;
+	struct paper_source_record	*record;
+	size_t				count;
+
+	/* If there's no file open, try to open the next one in the list,
+	 * moving on to the next root when all of a root's files are done.
+	 */
+
+	if (paper_load.in == NULL) {
+		if (paper_load.file >= PAPER_SOURCE_FILE_COUNT) {
+			paper_load.root++;
+			paper_load.file = 0;
+		}
+
+		if (paper_roots == NULL || paper_load.root >= paper_root_count) {
+			TRACE_EVENT(TRACE_EVENT_PARSE_END, paper_count, 0);
+			TRACE_EVENT(TRACE_EVENT_VERIFY_START, paper_count, 0);
+			paper_load.stage = PAPER_LOAD_STAGE_VERIFY;
+			paper_load.next = 0;
+			return;
+		}
+
+		*paper_load.name = '\0';
+		paper_load.width = 0;
+		paper_load.height = 0;
+		paper_load.field_start = fields_get_count();
+		paper_load.current = PAPER_LOAD_NONE;
+
+		paper_get_source_path(paper_load.root, paper_load.file, line, PAPER_MAX_LINE_LEN);
+
+		paper_load.in = fopen(line, "r");
+
+		if (paper_load.in == NULL) {
+			paper_load.file++;
+			return;
+		}
+
+		/* If an earlier root had an identical file, its definitions
+		 * have been copied across and there's nothing left to parse.
+		 */
+
+		if (paper_record_source(paper_load.root, paper_load.file, paper_load.in)) {
+			fclose(paper_load.in);
+			paper_load.in = NULL;
+			paper_load.file++;
+		}
+
+		return;
+	}
+
+	/* Read the next line from the current file. */
+
+	if (fgets(line, PAPER_MAX_LINE_LEN, paper_load.in) == NULL) {
+		fclose(paper_load.in);
+		paper_load.in = NULL;
+		paper_load.file++;
+		return;
+	}
+
+	string_ctrl_zero_terminate(line);
+	clean = string_strip_surrounding_whitespace(line);
+
+	if (*clean == '\0' || *clean == '#')
+		return;
+
+	/* Split the line into its key and value at the first colon. */
+
+	data = strchr(clean, ':');
+	if (data == NULL)
+		return;
+
+	*data++ = '\0';
+	clean = string_strip_surrounding_whitespace(clean);
+	data = string_strip_surrounding_whitespace(data);
+
+	/* The name, width and height are held in the definition; anything
+	 * else goes into the field store. A name starts a new definition,
+	 * so any fields after the last one was completed are left with it;
+	 * fields before the new one is completed are collected up for it.
+	 */
+
+	if (strcmp(clean, "pn") == 0) {
+		if (paper_load.current != PAPER_LOAD_NONE) {
+			paper_load.field_start = fields_get_count();
+			paper_load.current = PAPER_LOAD_NONE;
+		}
+
+		string_copy(paper_load.name, data, PAPER_NAME_LEN);
+	} else if (strcmp(clean, "pw") == 0) {
+		paper_load.width = atoi(data);
+	} else if (strcmp(clean, "ph") == 0) {
+		paper_load.height = atoi(data);
+	} else if (fields_add(clean, data) == FIELDS_NONE) {
+		TRACE_EVENT(TRACE_EVENT_FIELD_REJECTED, paper_load.root, paper_load.file);
+	} else if (paper_load.current >= 0) {
+		paper_sizes[paper_load.current].field_count++;
+	}
+
+	if (*paper_load.name != '\0' && paper_load.width != 0 && paper_load.height != 0) {
+		count = paper_count;
+
+		paper_add_definition(paper_load.name, paper_load.width, paper_load.height,
+				paper_source_files[paper_load.file].source, paper_load.root,
+				paper_load.field_start, fields_get_count() - paper_load.field_start);
+
+		/* If the definition couldn't be added, its fields are dropped
+		 * rather than being passed on to the next one.
+		 */
+
+		if (paper_count > count) {
+			paper_load.current = paper_count - 1;
+		} else {
+			paper_load.field_start = fields_get_count();
+			paper_load.current = PAPER_LOAD_FAILED;
+		}
+
+		if ((record = paper_get_source_record(paper_load.root, paper_load.file)) != NULL)
+			record->definitions++;
+
+		*paper_load.name = '\0';
+		paper_load.width = 0;
+		paper_load.height = 0;
+	}
+}
+
+
+/**
+ * Allocate and clear the source file records for the current set of
+ * roots. If there isn't enough memory, the records are left empty and
+ * every file will be parsed in full.
+ */
+
+static void paper_reset_sources(void)
+{
+	struct paper_source_record	*records;
+	size_t				record, count;
+
+	count = paper_root_count * PAPER_SOURCE_FILE_COUNT;
+
+	records = realloc(paper_source_records, ((count > 0) ? count : 1) * sizeof(struct paper_source_record));
+	if (records == NULL) {
+		free(paper_source_records);
+		paper_source_records = NULL;
+		return;
+	}
+
+	paper_source_records = records;
+
+	for (record = 0; record < count; record++) {
+		paper_source_records[record].present = FALSE;
+		paper_source_records[record].size = 0;
+		paper_source_records[record].hash = 0;
+		paper_source_records[record].shared_root = -1;
+		paper_source_records[record].definitions = 0;
+	}
+}
+
+
+/**
+ * Record the size and content hash of a newly opened definition source
+ * file. If the same file in an earlier root had identical contents, the
+ * definitions which were parsed from it are copied into this root instead
+ * of the file being parsed again.
+ *
+ * \param root			The index of the root holding the file.
+ * \param file			The index of the source file.
+ * \param *in			The handle of the open file, which is left
+ *				at the start of the file on exit.
+ * \return			TRUE if the definitions were copied from an
+ *				earlier root; FALSE if the file needs parsing.
+ */
+
+static osbool paper_record_source(int root, int file, FILE *in)
+{
+	struct paper_source_record	*record, *earlier;
+	struct paper_size		definition;
+	char				buffer[PAPER_MAX_LINE_LEN], filename[PAPER_MAX_FILENAME_LENGTH];
+	size_t				length, count, paper;
+	int				test, first;
+
+	record = paper_get_source_record(root, file);
+	if (record == NULL)
+		return FALSE;
+
+	record->present = TRUE;
+	record->size = 0;
+	record->hash = PAPER_HASH_SEED;
+
+	while ((length = fread(buffer, 1, PAPER_MAX_LINE_LEN, in)) > 0) {
+		record->hash = paper_hash_data(buffer, length, record->hash);
+		record->size += length;
+	}
+
+	rewind(in);
+
+	/* Look for the same file in an earlier root, with the same contents.
+	 * The hash only narrows down the search, so the files are compared
+	 * before the earlier root's definitions are used.
+	 */
+
+	for (test = 0; test < root; test++) {
+		earlier = paper_get_source_record(test, file);
+
+		if (earlier == NULL || !earlier->present || earlier->size != record->size || earlier->hash != record->hash)
+			continue;
+
+		paper_get_source_path(test, file, filename, PAPER_MAX_FILENAME_LENGTH);
+
+		if (paper_compare_file(in, filename))
+			break;
+	}
+
+	if (test >= root)
+		return FALSE;
+
+	/* Point at the root which was actually parsed, and copy its definitions. */
+
+	record->shared_root = (earlier->shared_root != -1) ? earlier->shared_root : test;
+
+	count = paper_count;
+
+	for (paper = 0; paper < count; paper++) {
+		if (paper_sizes[paper].root != record->shared_root || paper_sizes[paper].source != paper_source_files[file].source)
+			continue;
+
+		/* Take a copy, as adding the definition may move the flex heap. */
+
+		definition = paper_sizes[paper];
+
+		first = fields_copy(definition.first_field, definition.field_count);
+
+		paper_add_definition(definition.name, definition.width, definition.height, definition.source, root,
+				first, (first != FIELDS_NONE) ? definition.field_count : 0);
+		record->definitions++;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Build the name of a definition source file in a root.
+ *
+ * \param root			The index of the root.
+ * \param file			The index of the source file.
+ * \param *buffer		Pointer to a buffer to take the filename.
+ * \param length		The length of the buffer.
+ */
+
+static void paper_get_source_path(int root, int file, char *buffer, size_t length)
+{
+	string_printf(buffer, length, "%s%s", (paper_source_files[file].choices) ? paper_roots[root].choices : paper_roots[root].printers,
+			paper_source_files[file].file);
+}
+
+
+/**
+ * Compare the contents of an open file with those of another file. The
+ * open file is rewound afterwards.
+ *
+ * \param *in			The open file to compare.
+ * \param *filename		The name of the file to compare it with.
+ * \return			TRUE if the contents are identical; else FALSE.
+ */
+
+static osbool paper_compare_file(FILE *in, char *filename)
+{
+	FILE	*other;
+	char	buffer[PAPER_MAX_LINE_LEN], other_buffer[PAPER_MAX_LINE_LEN];
+	size_t	length;
+	osbool	identical = TRUE;
+
+	other = fopen(filename, "r");
+	if (other == NULL)
+		return FALSE;
+
+	do {
+		length = fread(buffer, 1, PAPER_MAX_LINE_LEN, in);
+
+		if (fread(other_buffer, 1, PAPER_MAX_LINE_LEN, other) != length || memcmp(buffer, other_buffer, length) != 0)
+			identical = FALSE;
+	} while (identical && length > 0);
+
+	fclose(other);
+	rewind(in);
+
+	return identical;
+}
+
+
+/**
+ * Add a block of data to a running FNV-1a hash.
+ *
+ * \param *data			The data to be hashed.
+ * \param length		The length of the data.
+ * \param hash			The hash so far, or PAPER_HASH_SEED to start.
+ * \return			The updated hash value.
+ */
+
+static unsigned paper_hash_data(char *data, size_t length, unsigned hash)
+{
+	while (length-- > 0)
+		hash = (hash ^ (unsigned char) *data++) * PAPER_HASH_PRIME;
+
+	return hash;
+}
+
+
+/**
+ * Add a paper definition to the end of the list of sizes. The size and
+ * snippet file status are left to be filled in by later stages of the load.
+ *
+ * \param *name			The name of the paper.
+ * \param width			The width of the paper, in millipoints.
+ * \param height		The height of the paper, in millipoints.
+ * \param source		The source of the definition.
+ * \param root			The root holding the definition.
+ * \param first_field		The first of the definition's other fields.
+ * \param field_count		The number of other fields.
+ */
+
+static void paper_add_definition(char *name, unsigned width, unsigned height, enum paper_source source, int root, int first_field, int field_count)
+{
+	int			i;
+	struct paper_size	*paper_definition;
+
+	paper_allocate_definition_space(paper_count + 1);
+
+	if (paper_count >= paper_allocation)
+		return;
+
+	paper_definition = paper_sizes + paper_count;
+
+	string_copy(paper_definition->name, name, PAPER_NAME_LEN);
+	paper_definition->source = source;
+	paper_definition->root = root;
+	paper_definition->width = width;
+	paper_definition->height = height;
+	paper_definition->size_status = PAPER_SIZE_STATUS_UNKNOWN;
+	paper_definition->standard_match = standard_classify(name, width, height,
+			&(paper_definition->standard), &(paper_definition->standard_error));
+
+	for (i = 0; i < (PAPER_FILE_LEN - 1) && name[i] != '\0' && name[i] != ' '; i++)
+		paper_definition->ps2_file[i] = name[i];
+
+	paper_definition->ps2_file[i] = '\0';
+	paper_definition->ps2_file_status = PAPER_FILE_STATUS_UNCHECKED;
+	paper_definition->shadowed = FALSE;
+	paper_definition->changes = JOURNAL_CHANGE_NONE;
+	paper_definition->first_field = first_field;
+	paper_definition->field_count = field_count;
+	paper_definition->file_next = PAPER_FILE_INDEX_EMPTY;
+
+	string_tolower(paper_definition->ps2_file);
+
+	paper_overlay_add(paper_count++);
+	paper_file_index_add(paper_count - 1);
+}
+
+
+/**
+ * Check for the presence of a paper definition's PS2 snippet, and compare
+ * its contents to the paper size.
+ *
+ * \param paper			The index of the definition to verify.
+ */
+
+static void paper_verify_definition(size_t paper)
+{
+	char			filename[PAPER_MAX_FILENAME_LENGTH];
+
+	if (paper >= paper_count)
+		return;
+
+	paper_sizes[paper].ps2_file_status = PAPER_FILE_STATUS_MISSING;
+
+	if (paper_find_snippet(paper_sizes + paper, filename, PAPER_MAX_FILENAME_LENGTH))
+		paper_sizes[paper].ps2_file_status = paper_read_pagesize(paper_sizes + paper, filename);
+}
+
+
+/**
+ * Find the names of the user definitions file for a root. The source is
+ * on the choices path from which the definitions were read, while the
+ * target is in the folder into which the root's snippets are written. The
+ * folders for the target are created if they don't already exist.
+ *
+ * \param root			The index of the root.
+ * \param *source		Pointer to a buffer to take the source filename.
+ * \param *target		Pointer to a buffer to take the target filename.
+ * \param length		The length of the buffers.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool paper_get_user_file(int root, char *source, char *target, size_t length)
+{
+	size_t	file, folder;
+
+	if (paper_roots == NULL || root < 0 || root >= paper_root_count)
+		return FALSE;
+
+	for (file = 0; file < PAPER_SOURCE_FILE_COUNT && paper_source_files[file].source != PAPER_SOURCE_USER; file++);
+
+	folder = strlen(paper_roots[root].write);
+
+	if (file >= PAPER_SOURCE_FILE_COUNT || folder < PAPER_WRITE_FOLDER_LEN || folder - PAPER_WRITE_FOLDER_LEN + 1 > length)
+		return FALSE;
+
+	paper_get_source_path(root, file, source, length);
+
+	string_copy(target, paper_roots[root].write, folder - PAPER_WRITE_FOLDER_LEN + 1);
+	string_printf(target + strlen(target), length - strlen(target), "%s", paper_source_files[file].file);
+
+	/* Any failure here will be reported when the file is written. */
+
+	paper_ensure_ps2_file_folder();
+
+	return TRUE;
+}
+
+
+/**
+ * Bring the catalogue up to date following a change to a single paper
+ * definition, without reading everything in again. Only the definitions
+ * sharing its snippet file can be affected, so just their lines in the
+ * List window are redrawn.
+ *
+ * \param paper			The index of the definition which has changed.
+ */
+
+static void paper_update_definition(size_t paper)
+{
+	char	file[PAPER_FILE_LEN];
+
+	if (paper_sizes == NULL || paper >= paper_count)
+		return;
+
+	paper_sizes[paper].standard_match = standard_classify(paper_sizes[paper].name, paper_sizes[paper].width, paper_sizes[paper].height,
+			&(paper_sizes[paper].standard), &(paper_sizes[paper].standard_error));
+
+	paper_verify_definition(paper);
+
+	string_copy(file, paper_sizes[paper].ps2_file, PAPER_FILE_LEN);
+	paper_rescan_file_group(paper_sizes[paper].root, file);
+	paper_measure_file_group(paper_sizes[paper].root, file, TRUE);
+	paper_redraw_file_group(paper_sizes[paper].root, file);
+}
+
+
+/**
+ * Recalculate the paper size status of all of the definitions in a root
+ * which share a PS2 filename.
+ *
+ * \param root			The index of the root.
+ * \param *file			The PS2 filename.
+ */
+
+static void paper_rescan_file_group(int root, char *file)
+{
+	int			first, paper;
+	enum paper_size_status	status;
+
+	if (paper_file_index == NULL && !paper_build_file_index())
+		return;
+
+	first = paper_find_file(root, file);
+	if (first == PAPER_FILE_INDEX_EMPTY)
+		return;
+
+	status = PAPER_SIZE_STATUS_OK;
+
+	for (paper = paper_sizes[first].file_next; paper != PAPER_FILE_INDEX_EMPTY; paper = paper_sizes[paper].file_next) {
+		if (paper_sizes[paper].width != paper_sizes[first].width || paper_sizes[paper].height != paper_sizes[first].height) {
+			status = PAPER_SIZE_STATUS_AMBIGUOUS;
+			break;
+		}
+	}
+
+	for (paper = first; paper != PAPER_FILE_INDEX_EMPTY; paper = paper_sizes[paper].file_next)
+		paper_sizes[paper].size_status = status;
+}
+
+
+/**
+ * Add or remove the List window column texts for all of the definitions
+ * in a root which share a PS2 filename, as these are the ones whose texts
+ * can change when one of them is edited.
+ *
+ * \param root			The index of the root.
+ * \param *file			The PS2 filename.
+ * \param add			TRUE to add the texts; FALSE to remove them.
+ */
+
+static void paper_measure_file_group(int root, char *file, osbool add)
+{
+	int	paper;
+
+	if (paper_file_index == NULL && !paper_build_file_index())
+		return;
+
+	/* The group is followed by index, so the flex heap can safely move
+	 * while the texts are measured.
+	 */
+
+	for (paper = paper_find_file(root, file); paper != PAPER_FILE_INDEX_EMPTY; paper = paper_sizes[paper].file_next) {
+		if (add)
+			list_add_paper_texts(paper);
+		else
+			list_remove_paper_texts(paper);
+	}
+}
+
+
+/**
+ * Redraw the List window lines for all of the definitions in a root which
+ * share a PS2 filename.
+ *
+ * \param root			The index of the root.
+ * \param *file			The PS2 filename.
+ */
+
+static void paper_redraw_file_group(int root, char *file)
+{
+	int	paper;
+
+	/* Redrawing can move the flex heap, so the group is followed by index. */
+
+	for (paper = paper_find_file(root, file); paper != PAPER_FILE_INDEX_EMPTY; paper = paper_sizes[paper].file_next)
+		list_update_paper_definition(paper);
+}
+
+
+/**
+ * Scan a paper definition against the others to set up its paper size
+ * status value, along with those of any other definitions sharing the
+ * same PS2 filename.
+ *
+ * \param paper			The index of the definition to scan.
+ */
+
+static void paper_scan_size(size_t paper)
+{
+	int	test;
+	osbool	ambiguous;
+
+	if (paper_sizes == NULL || paper >= paper_count)
+		return;
+
+	/* Has this paper already been tested in an earlier scan? */
+
+	if (paper_sizes[paper].size_status != PAPER_SIZE_STATUS_UNKNOWN)
+		return;
+
+	/* Scan through the remaining paper definitions to check for matching PS2 filenames. */
+
+	ambiguous = FALSE;
+
+	for (test = paper + 1; test < paper_count; test++) {
+		/* Do the PS2 filenames match or not? Each root has its own
+		 * set of snippets, so definitions in other roots can't clash.
+		 */
+
+		if (paper_sizes[paper].root != paper_sizes[test].root || strcmp(paper_sizes[paper].ps2_file, paper_sizes[test].ps2_file) != 0)
+			continue;
+
+		/* If they do, do the paper sizes agree or not? */
+
+		if (paper_sizes[paper].width == paper_sizes[test].width && paper_sizes[paper].height == paper_sizes[test].height)
+			continue;
+
+		/* If they don't, the same filename is being used for different sizes of paper. */
+
+		ambiguous = TRUE;
+		break;
+	}
+
+	/* Update the status of this paper definition. */
+
+	paper_sizes[paper].size_status = (ambiguous) ? PAPER_SIZE_STATUS_AMBIGUOUS : PAPER_SIZE_STATUS_OK;
+
+	/* Update the status of any other definitions using the same PS2 filename. */
+
+	for (test = paper + 1; test < paper_count; test++) {
+		if (paper_sizes[paper].root == paper_sizes[test].root && strcmp(paper_sizes[paper].ps2_file, paper_sizes[test].ps2_file) == 0)
+			paper_sizes[test].size_status = (ambiguous) ? PAPER_SIZE_STATUS_AMBIGUOUS : PAPER_SIZE_STATUS_OK;
+	}
+}
+
+
+/**
+ * Build the hash index of paper definitions by root and snippet filename,
+ * replacing any existing index.
+ *
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool paper_build_file_index(void)
+{
+	unsigned	size, slot;
+	size_t		paper;
+
+	free(paper_file_index);
+	paper_file_index = NULL;
+	paper_file_index_size = 0;
+	paper_file_index_count = 0;
+
+	/* Keep the index no more than half full, so that the probes stay short. */
+
+	for (size = PAPER_FILE_INDEX_MIN_SIZE; size < paper_count * 2; size *= 2);
+
+	paper_file_index = malloc(size * sizeof(int));
+	if (paper_file_index == NULL)
+		return FALSE;
+
+	paper_file_index_size = size;
+
+	for (slot = 0; slot < size; slot++)
+		paper_file_index[slot] = PAPER_FILE_INDEX_EMPTY;
+
+	for (paper = 0; paper < paper_count; paper++)
+		paper_file_index_insert(paper);
+
+	return TRUE;
+}
+
+
+/**
+ * Add a new definition to the filename index, if the index exists,
+ * rebuilding the index if it would become more than half full.
+ *
+ * \param paper			The index of the definition to add.
+ */
+
+static void paper_file_index_add(size_t paper)
+{
+	if (paper_file_index == NULL)
+		return;
+
+	if ((paper_file_index_count + 1) * 2 > paper_file_index_size)
+		paper_build_file_index();
+	else
+		paper_file_index_insert(paper);
+}
+
+
+/**
+ * Remove a definition from the filename index, before it is removed from
+ * the list of definitions. Any references to the definitions which follow
+ * it are renumbered to allow for the move.
+ *
+ * \param paper			The index of the definition to remove.
+ */
+
+static void paper_file_index_remove(size_t paper)
+{
+	unsigned	slot, gap, home, mask;
+	int		first, test, next;
+	size_t		definition;
+
+	if (paper_file_index == NULL || paper >= paper_count)
+		return;
+
+	mask = paper_file_index_size - 1;
+	next = paper_sizes[paper].file_next;
+	first = paper_find_file(paper_sizes[paper].root, paper_sizes[paper].ps2_file);
+
+	if (first == paper) {
+		for (slot = paper_file_hash(paper_sizes[paper].root, paper_sizes[paper].ps2_file) & mask; paper_file_index[slot] != paper; slot = (slot + 1) & mask);
+
+		if (next != PAPER_FILE_INDEX_EMPTY) {
+			paper_file_index[slot] = next;
+		} else {
+			/* Empty the slot, then close up any entries further down
+			 * the probe run which could no longer be reached.
+			 */
+
+			paper_file_index[slot] = PAPER_FILE_INDEX_EMPTY;
+			paper_file_index_count--;
+
+			for (gap = slot, slot = (slot + 1) & mask; paper_file_index[slot] != PAPER_FILE_INDEX_EMPTY; slot = (slot + 1) & mask) {
+				test = paper_file_index[slot];
+				home = paper_file_hash(paper_sizes[test].root, paper_sizes[test].ps2_file) & mask;
+
+				if (((slot - home) & mask) >= ((slot - gap) & mask)) {
+					paper_file_index[gap] = test;
+					paper_file_index[slot] = PAPER_FILE_INDEX_EMPTY;
+					gap = slot;
+				}
+			}
+		}
+	} else if (first != PAPER_FILE_INDEX_EMPTY) {
+		for (test = first; paper_sizes[test].file_next != PAPER_FILE_INDEX_EMPTY && paper_sizes[test].file_next != paper; test = paper_sizes[test].file_next);
+
+		if (paper_sizes[test].file_next == paper)
+			paper_sizes[test].file_next = next;
+	}
+
+	for (slot = 0; slot < paper_file_index_size; slot++) {
+		if (paper_file_index[slot] > (int) paper)
+			paper_file_index[slot]--;
+	}
+
+	for (definition = 0; definition < paper_count; definition++) {
+		if (paper_sizes[definition].file_next > (int) paper)
+			paper_sizes[definition].file_next--;
+	}
+}
+
+
+/**
+ * Insert a definition into the filename index, which must have space for
+ * it. Only the first definition using each filename in a root is held in
+ * the index: any others are chained on to it in the order that they were
+ * added.
+ *
+ * \param paper			The index of the definition to insert.
+ */
+
+static void paper_file_index_insert(size_t paper)
+{
+	unsigned	slot;
+	int		test;
+
+	paper_sizes[paper].file_next = PAPER_FILE_INDEX_EMPTY;
+
+	test = paper_find_file(paper_sizes[paper].root, paper_sizes[paper].ps2_file);
+
+	if (test != PAPER_FILE_INDEX_EMPTY) {
+		while (paper_sizes[test].file_next != PAPER_FILE_INDEX_EMPTY)
+			test = paper_sizes[test].file_next;
+
+		paper_sizes[test].file_next = paper;
+		return;
+	}
+
+	slot = paper_file_hash(paper_sizes[paper].root, paper_sizes[paper].ps2_file) & (paper_file_index_size - 1);
+
+	while (paper_file_index[slot] != PAPER_FILE_INDEX_EMPTY)
+		slot = (slot + 1) & (paper_file_index_size - 1);
+
+	paper_file_index[slot] = paper;
+	paper_file_index_count++;
+}
+
+
+/**
+ * Find the first paper definition in a root which uses a given snippet
+ * filename, using the filename index.
+ *
+ * \param root			The index of the root to search.
+ * \param *file			The snippet filename to look for.
+ * \return			The index of the definition, or PAPER_FILE_INDEX_EMPTY.
+ */
+
+static int paper_find_file(int root, char *file)
+{
+	unsigned	slot;
+	int		paper;
+
+	if (paper_file_index == NULL || file == NULL)
+		return PAPER_FILE_INDEX_EMPTY;
+
+	slot = paper_file_hash(root, file) & (paper_file_index_size - 1);
+
+	while ((paper = paper_file_index[slot]) != PAPER_FILE_INDEX_EMPTY) {
+		if (paper_sizes[paper].root == root && string_nocase_strcmp(paper_sizes[paper].ps2_file, file) == 0)
+			return paper;
+
+		slot = (slot + 1) & (paper_file_index_size - 1);
+	}
+
+	return PAPER_FILE_INDEX_EMPTY;
+}
+
+
+/**
+ * Calculate the filename index hash for a snippet filename in a root.
+ *
+ * \param root			The index of the root.
+ * \param *file			The snippet filename.
+ * \return			The hash value.
+ */
 
+static unsigned paper_file_hash(int root, char *file)
+{
+	return dircache_hash_name(file) + (root * 0x9e3779b9u);
+}
 
 
 /**
- * Initialise the paper definitions list.
+ * Rebuild the layer overlay index from scratch for the first definitions
+ * in the list, replacing any existing index and recalculating which of
+ * the definitions are shadowed.
+ *
+ * \param count			The number of definitions to include.
+ * \param size			The number of slots required; a power of two.
+ * \return			TRUE if successful; FALSE on failure.
  */
 
-void paper_initialise(void)
+static osbool paper_overlay_rebuild(size_t count, unsigned size)
 {
-	if (flex_alloc((flex_ptr) &paper_sizes, 4) == 0)
-		paper_sizes = NULL;
+	unsigned	slot;
+	size_t		paper;
 
-	paper_clear_definitions();
-	paper_read_definitions();
+	free(paper_overlay_index);
+	paper_overlay_index_size = 0;
+	paper_overlay_index_count = 0;
+
+	paper_overlay_index = malloc(size * sizeof(int));
+	if (paper_overlay_index == NULL)
+		return FALSE;
+
+	paper_overlay_index_size = size;
+
+	for (slot = 0; slot < size; slot++)
+		paper_overlay_index[slot] = PAPER_FILE_INDEX_EMPTY;
+
+	for (paper = 0; paper < count; paper++)
+		paper_overlay_add(paper);
+
+	return TRUE;
 }
 
 
 /**
- * Reset the paper definitions, then read them back in from the source
- * files in Printers.
+ * Add a definition to the layer overlay index, resolving it against any
+ * existing definition of the same name in the same root. A definition from
+ * a higher layer (user over device over master) replaces the one in the
+ * index, which becomes shadowed; within a layer, the first definition of
+ * a name wins and any later ones are shadowed.
+ *
+ * \param paper			The index of the definition to add.
  */
 
-void paper_read_definitions(void)
+static void paper_overlay_add(size_t paper)
 {
-	paper_clear_definitions();
+	unsigned	slot, size;
+	int		winner;
 
-	paper_read_def_file("Printers:PaperRO", PAPER_SOURCE_MASTER);
-	paper_read_def_file("PrinterChoices:PaperRW", PAPER_SOURCE_USER);
-	paper_read_def_file("Printers:ps.Resources.PaperRO", PAPER_SOURCE_DEVICE);
+	paper_sizes[paper].shadowed = FALSE;
 
-	paper_scan_sizes();
+	/* Keep the index no more than half full, doubling it and re-adding
+	 * the earlier definitions when it fills up.
+	 */
 
-	list_rescan_paper_definitions();
+	if ((paper_overlay_index_count + 1) * 2 > paper_overlay_index_size) {
+		for (size = PAPER_OVERLAY_INDEX_MIN_SIZE; size < (paper + 1) * 2; size *= 2);
+
+		if (!paper_overlay_rebuild(paper, size))
+			return;
+	}
+
+	slot = paper_overlay_find_slot(paper_sizes[paper].root, paper_sizes[paper].name);
+	winner = paper_overlay_index[slot];
+
+	if (winner == PAPER_FILE_INDEX_EMPTY) {
+		paper_overlay_index[slot] = paper;
+		paper_overlay_index_count++;
+	} else if (paper_sizes[paper].source > paper_sizes[winner].source) {
+		paper_sizes[winner].shadowed = TRUE;
+		paper_overlay_index[slot] = paper;
+	} else {
+		paper_sizes[paper].shadowed = TRUE;
+	}
 }
 
 
 /**
- * Return the number of paper definitions which are currently stored.
+ * Find the slot in the layer overlay index which holds a paper name in a
+ * root, or the empty slot where it would be added if it isn't present.
  *
- * \return			The number of paper definitions.
+ * \param root			The index of the root.
+ * \param *name			The name of the paper.
+ * \return			The index of the slot.
  */
 
-size_t paper_get_definition_count(void)
+static unsigned paper_overlay_find_slot(int root, char *name)
 {
-	return paper_count;
+	unsigned	slot;
+	int		paper;
+
+	slot = paper_file_hash(root, name) & (paper_overlay_index_size - 1);
+
+	while ((paper = paper_overlay_index[slot]) != PAPER_FILE_INDEX_EMPTY) {
+		if (paper_sizes[paper].root == root && string_nocase_strcmp(paper_sizes[paper].name, name) == 0)
+			break;
+
+		slot = (slot + 1) & (paper_overlay_index_size - 1);
+	}
+
+	return slot;
 }
 
 
 /**
- * Return a pointer to the paper definition array. This points into a flex
- * heap, so the pointer will not remain valid if anything causes the heap
- * to shift.
- * 
- * \return			Pointer to the first entry in the array.
+ * Find the snippet files in each root which aren't referenced by any of
+ * the definitions in that root, by joining the catalogued folder contents
+ * against the filename index. Folders on path variables are enumerated an
+ * element at a time by the catalogue.
  */
 
-struct paper_size *paper_get_definitions(void)
+static void paper_find_orphans(void)
 {
-	return paper_sizes;
+	struct paper_orphan_search	search;
+	char				printers[PAPER_MAX_FILENAME_LENGTH], choices[PAPER_MAX_FILENAME_LENGTH];
+
+	paper_orphan_count = 0;
+
+	if (!paper_build_file_index())
+		return;
+
+	for (search.root = 0; search.root < paper_root_count; search.root++) {
+		string_printf(choices, PAPER_MAX_FILENAME_LENGTH, "%sps.Paper", paper_roots[search.root].choices);
+		string_printf(printers, PAPER_MAX_FILENAME_LENGTH, "%sps.Paper", paper_roots[search.root].printers);
+
+		search.choices = TRUE;
+		dircache_enumerate(choices, paper_check_orphan, &search);
+
+		if (string_nocase_strcmp(choices, printers) == 0)
+			continue;
+
+		search.choices = FALSE;
+		dircache_enumerate(printers, paper_check_orphan, &search);
+	}
 }
 
 
 /**
- * Launch the snippet file relating to a paper definition, using a
- * *Filer_Run command.
- * 
- * \param definition		The index into the definitions of the
- *				definition to be launched.
+ * Check a file from a snippet folder against the filename index, and add
+ * it to the list of orphans if no definition refers to it.
+ *
+ * \param *leaf			The leafname of the file.
+ * \param *file			The details of the file.
+ * \param *data			The orphan search details.
  */
 
-void paper_launch_file(int definition)
+static void paper_check_orphan(char *leaf, struct dircache_file *file, void *data)
 {
-	char		buffer[PAPER_MAX_LINE_LEN];
-	os_error	*error;
+	struct paper_orphan_search	*search = data;
+	struct paper_orphan		*new_orphans;
 
-	if (definition < 0 || definition >= paper_count || paper_sizes[definition].ps2_file_status == PAPER_FILE_STATUS_MISSING)
+	if (search == NULL || paper_find_file(search->root, leaf) != PAPER_FILE_INDEX_EMPTY)
 		return;
 
-	string_printf(buffer, PAPER_MAX_LINE_LEN, "%%Filer_Run -Shift Printers:ps.Paper.%s", paper_sizes[definition].ps2_file);
-	error = xos_cli(buffer);
-	if (error != NULL)
-		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
+	if (paper_orphan_count >= paper_orphan_allocation) {
+		new_orphans = realloc(paper_orphans, (paper_orphan_allocation + PAPER_ORPHAN_ALLOCATION) * sizeof(struct paper_orphan));
+		if (new_orphans == NULL)
+			return;
+
+		paper_orphans = new_orphans;
+		paper_orphan_allocation += PAPER_ORPHAN_ALLOCATION;
+	}
+
+	string_copy(paper_orphans[paper_orphan_count].name, leaf, PAPER_FILE_LEN);
+	paper_orphans[paper_orphan_count].root = search->root;
+	paper_orphans[paper_orphan_count].choices = search->choices;
+	paper_orphan_count++;
 }
 
 
 /**
- * Write a new snipped file for a paper definition.
+ * Remove any orphaned snippets in a root which have been claimed by a new
+ * definition using their filename.
  *
- * \param definition		The index into the definitions of the
- *				definition to be launched.
+ * \param root			The index of the root.
+ * \param *file			The snippet filename used by the new definition.
+ * \return			TRUE if any orphans were removed; else FALSE.
  */
 
-void paper_write_file(int definition)
+static osbool paper_claim_orphans(int root, char *file)
 {
-	if (definition < 0 || definition >= paper_count || paper_sizes[definition].ps2_file_status == PAPER_FILE_STATUS_CORRECT)
-		return;
+	size_t	orphan, kept = 0;
 
-	if ((paper_sizes[definition].ps2_file_status == PAPER_FILE_STATUS_UNKNOWN) &&
-			(error_msgs_param_report_question("Overwrite", "OverwriteB", paper_sizes[definition].ps2_file, NULL, NULL, NULL) == 4))
-		return;
+	for (orphan = 0; orphan < paper_orphan_count; orphan++) {
+		if (paper_orphans[orphan].root == root && string_nocase_strcmp(paper_orphans[orphan].name, file) == 0)
+			continue;
 
-	paper_write_pagesize(paper_sizes + definition, "<Choices$Write>.Printers.ps.Paper");
+		if (kept != orphan)
+			paper_orphans[kept] = paper_orphans[orphan];
 
-	return;
+		kept++;
+	}
+
+	if (kept == paper_orphan_count)
+		return FALSE;
+
+	paper_orphan_count = kept;
+
+	return TRUE;
 }
 
 
 /**
- * Clear the paper definitions and release the memory used to hold them.
- * Calling this function will also initialise the flex block and
- * associated variables.
+ * Check for snippets in a root which have been orphaned by the removal of the
+ * last definition to use their filename, adding any found to the orphans.
+ *
+ * \param root			The index of the root.
+ * \param *file			The snippet filename used by the old definition.
+ * \return			TRUE if any orphans were added; else FALSE.
  */
 
-static void paper_clear_definitions(void)
+static osbool paper_release_orphans(int root, char *file)
 {
-	paper_count = 0;
-	paper_allocation = 0;
+	struct paper_orphan_search	search;
+	struct dircache_file		entry;
+	char				printers[PAPER_MAX_FILENAME_LENGTH], choices[PAPER_MAX_FILENAME_LENGTH];
+	size_t				count = paper_orphan_count;
 
-	if (paper_sizes == NULL)
-		return;
+	if (paper_file_index == NULL || root < 0 || root >= paper_root_count || paper_find_file(root, file) != PAPER_FILE_INDEX_EMPTY)
+		return FALSE;
 
-	if (flex_extend((flex_ptr) &paper_sizes, 4) == 0)
-		paper_sizes = NULL;
+	string_printf(choices, PAPER_MAX_FILENAME_LENGTH, "%sps.Paper", paper_roots[root].choices);
+	string_printf(printers, PAPER_MAX_FILENAME_LENGTH, "%sps.Paper", paper_roots[root].printers);
+
+	search.root = root;
+
+	search.choices = TRUE;
+	if (dircache_find_file(choices, file, &entry))
+		paper_check_orphan(file, &entry, &search);
+
+	search.choices = FALSE;
+	if (string_nocase_strcmp(choices, printers) != 0 && dircache_find_file(printers, file, &entry))
+		paper_check_orphan(file, &entry, &search);
+
+	return (paper_orphan_count != count) ? TRUE : FALSE;
 }
 
 
 /**
- * Claim additional storage space for paper definitions.
+ * Read a PS2 snippet and compare its contents to a paper size definition.
+ * Snippets with identical contents are only parsed once in each load, with
+ * the results being shared through the snippet result cache.
  * 
- * \param new_allocation	The number of storage places required.
- * \return			TRUE if successful; FALSE if allocation failed.
+ * \param *paper		Pointer to the paper definition to be read.
+ * \param *file_path		Pointer to the filename to read from.
+ * \return			The status of the PS2 snippet in relation to the paper size.
  */
 
-static osbool paper_allocate_definition_space(unsigned new_allocation)
+static enum paper_file_status paper_read_pagesize(struct paper_size *paper, char *file)
 {
-	if (paper_sizes == NULL)
-		return FALSE;
+	os_fw				in;
+	int				unread;
+	size_t				length;
+	unsigned			hash;
+	struct paper_snippet_result	parsed, *result;
+	os_error			*error;
 
-	if (new_allocation <= paper_allocation)
-		return TRUE;
+	if (file == NULL)
+		return PAPER_FILE_STATUS_UNKNOWN;
 
-	new_allocation = ((new_allocation / PAPER_STORAGE_ALLOCATION) + 1) * PAPER_STORAGE_ALLOCATION;
+	/* Only the first few lines of the file matter, so just read the start
+	 * straight into the shared buffer. There can be tens of thousands of
+	 * snippets, so this avoids setting up a C stream for each one.
+	 */
 
-	if (flex_extend((flex_ptr) &paper_sizes, new_allocation * sizeof(struct paper_size)) == 0)
-		return FALSE;
+	error = xosfind_openinw(osfind_NO_PATH | osfind_ERROR_IF_ABSENT | osfind_ERROR_IF_DIR, file, NULL, &in);
+	if (error != NULL || in == 0)
+		return PAPER_FILE_STATUS_UNKNOWN;
 
-	paper_allocation = new_allocation;
+	error = xosgbpb_readw(in, (byte *) paper_snippet_buffer, PAPER_SNIPPET_READ_LEN, &unread);
 
-	return TRUE;
+	xosfind_closew(in);
+
+	if (error != NULL)
+		return PAPER_FILE_STATUS_UNKNOWN;
+
+	length = PAPER_SNIPPET_READ_LEN - unread;
+	paper_snippet_buffer[length] = '\0';
+
+	paper_snippets_checked++;
+
+	/* Parse the contents, unless they've been seen before. */
+
+	hash = paper_hash_data(paper_snippet_buffer, length, PAPER_HASH_SEED);
+
+	result = paper_find_snippet_result(hash, paper_snippet_buffer, length);
+
+	if (result == NULL) {
+		paper_parse_pagesize(paper_snippet_buffer, length, &parsed);
+		parsed.hash = hash;
+		parsed.length = length;
+		paper_snippets_parsed++;
+
+		result = paper_add_snippet_result(&parsed, paper_snippet_buffer);
+		if (result == NULL)
+			result = &parsed;
+	}
+
+	if (!result->recognised)
+		return PAPER_FILE_STATUS_UNKNOWN;
+
+	if (result->width != paper->width || result->height != paper->height)
+		return PAPER_FILE_STATUS_INCORRECT;
+
+	return PAPER_FILE_STATUS_CORRECT;
 }
 
 
 /**
- * Process the contents of a Printers paper file, reading the paper definitions
- * and adding them to the list of sizes.
+ * Parse the start of a PS2 snippet, to see if it was written by PS2Paper
+ * and, if so, what page size it contains.
  *
- * \param *file			The name of the file to be read in.
- * \param source		The type of file being read.
- * \return			TRUE on success; FALSE on failure.
+ * \param *text			The start of the snippet.
+ * \param length		The number of bytes of the snippet in the buffer.
+ * \param *result		Pointer to a block to take the results.
  */
 
-static osbool paper_read_def_file(char *file, enum paper_source source)
+static void paper_parse_pagesize(char *text, size_t length, struct paper_snippet_result *result)
 {
-	FILE			*in;
-	char			line[PAPER_MAX_LINE_LEN], *clean, *data, paper_name[PAPER_NAME_LEN];
-	int			i;
-	unsigned		paper_width, paper_height;
-	struct paper_size	*paper_definition;
-	os_error		*error;
-	fileswitch_object_type	type;
+	char	*end = text + length, *line;
 
+	result->used = TRUE;
+	result->recognised = FALSE;
+	result->width = 0;
+	result->height = 0;
 
-	if (file == NULL || *file == '\0')
-		return FALSE;
+	/* The first line identifies the file, and the page size is on the third. */
 
-	in = fopen(file, "r");
+	if (length < PAPER_SNIPPET_HEADER_LEN || memcmp(text, PAPER_SNIPPET_HEADER, PAPER_SNIPPET_HEADER_LEN) != 0)
+		return;
 
-	if (in == NULL)
-		return FALSE;
+	line = paper_find_line_end(text + PAPER_SNIPPET_HEADER_LEN, end);
+	if (line == NULL || ++line >= end)
+		return;
 
-	*paper_name = '\0';
-	paper_width = 0;
-	paper_height = 0;
+	result->recognised = TRUE;
 
-	while (fgets(line, PAPER_MAX_LINE_LEN, in) != NULL) {
-		string_ctrl_zero_terminate(line);
-		clean = string_strip_surrounding_whitespace(line);
+	/* PS2Paper writes the dimensions with exactly three decimal places, so
+	 * they can be read directly as millipoints without going via floating
+	 * point. Anything which can't be read leaves the size as zero.
+	 */
 
-		if (*clean == '\0' || *clean == '#')
-			continue;
+	line = paper_match_pagesize(line, end);
+	if (line == NULL)
+		return;
 
-		if (strstr(clean, "pn:") == clean) {
-			data = string_strip_surrounding_whitespace(clean + 3);
-			string_copy(paper_name, data, PAPER_NAME_LEN);
-		} else if (strstr(clean, "pw:") == clean) {
-			data = string_strip_surrounding_whitespace(clean + 3);
-			paper_width = atoi(data);
-		} else if (strstr(clean, "ph:") == clean) {
-			data = string_strip_surrounding_whitespace(clean + 3);
-			paper_height = atoi(data);
-		}
+	line = paper_parse_millipoints(line, end, &(result->width));
+	if (line != NULL)
+		line = paper_parse_millipoints(line, end, &(result->height));
+
+	if (line == NULL) {
+		result->width = 0;
+		result->height = 0;
+	}
+}
 
-		if (paper_name != '\0' && paper_width != 0 && paper_height != 0) {
-			paper_allocate_definition_space(paper_count + 1);
 
-			if (paper_count < paper_allocation) {
-				paper_definition = paper_sizes + paper_count;
+/**
+ * Find the end of the line in a block of snippet text. The text is checked
+ * a word at a time: exclusive-ORing a word with newlines leaves a zero byte
+ * in place of any newline, and the zero byte can be found with a couple of
+ * arithmetic operations on the whole word.
+ *
+ * \param *text			The start of the text to search.
+ * \param *end			The end of the text.
+ * \return			Pointer to the newline, or NULL if none was found.
+ */
 
-				string_copy(paper_definition->name, paper_name, PAPER_NAME_LEN);
-				paper_definition->source = source;
-				paper_definition->width = paper_width;
-				paper_definition->height = paper_height;
-				paper_definition->size_status = PAPER_SIZE_STATUS_UNKNOWN;
+static char *paper_find_line_end(char *text, char *end)
+{
+	unsigned	word;
 
-				for (i = 0; i < PAPER_FILE_LEN && paper_name[i] != '\0' && paper_name[i] != ' '; i++)
-					paper_definition->ps2_file[i] = paper_name[i];
+	/* Check a byte at a time until the text is word aligned. */
 
-				paper_definition->ps2_file[i] = '\0';
-				paper_definition->ps2_file_status = PAPER_FILE_STATUS_MISSING;
+	while (text < end && ((size_t) text & (sizeof(unsigned) - 1)) != 0) {
+		if (*text == '\n')
+			return text;
 
-				string_tolower(paper_definition->ps2_file);
+		text++;
+	}
 
-				if (paper_definition->ps2_file[0] != '\0') {
-					string_printf(line, PAPER_MAX_LINE_LEN, "Printers:ps.Paper.%s", paper_definition->ps2_file);
-					error = xosfile_read_no_path(line, &type, NULL, NULL, NULL, NULL);
+	/* Skip whole words which don't contain a newline. */
 
-					if (error == NULL && type == fileswitch_IS_FILE)
-						paper_definition->ps2_file_status = paper_read_pagesize(paper_definition, line);
-				}
+	while (end - text >= sizeof(unsigned)) {
+		word = *((unsigned *) text) ^ PAPER_SCAN_NEWLINES;
 
-				paper_count++;
-			}
+		if (((word - PAPER_SCAN_ONES) & ~word & PAPER_SCAN_HIGHS) != 0)
+			break;
 
-			*paper_name = '\0';
-			paper_width = 0;
-			paper_height = 0;
-		}
+		text += sizeof(unsigned);
 	}
 
-	fclose(in);
+	/* Find the newline within the final word. */
 
-	return TRUE;
+	while (text < end) {
+		if (*text == '\n')
+			return text;
+
+		text++;
+	}
+
+	return NULL;
 }
 
 
 /**
- * Run a scan of the paper definitions to set up the paper size status values.
+ * Match the start of a snippet's page size line, up to the first of the
+ * dimensions, allowing for any spaces between the tokens.
+ *
+ * \param *text			The start of the line.
+ * \param *end			The end of the text.
+ * \return			Pointer to the first dimension, or NULL if the line
+ *				doesn't match.
  */
 
-static void paper_scan_sizes(void)
+static char *paper_match_pagesize(char *text, char *end)
 {
-	int	paper, test;
-	osbool	ambiguous;
+	static char	*tokens[] = {"<<", "/PageSize", "["};
+	size_t		token, length;
 
-	if (paper_sizes == NULL)
-		return;
+	for (token = 0; token < (sizeof(tokens) / sizeof(char *)); token++) {
+		while (text < end && (*text == ' ' || *text == '\t'))
+			text++;
 
-	for (paper = 0; paper < paper_count; paper++) {
-		/* Has this paper already been tested in an earlier scan? */
+		length = strlen(tokens[token]);
 
-		if (paper_sizes[paper].size_status != PAPER_SIZE_STATUS_UNKNOWN)
-			continue;
+		if (end - text < length || memcmp(text, tokens[token], length) != 0)
+			return NULL;
 
-		/* Scan through the remaining paper definitions to check for matching PS2 filenames. */
+		text += length;
+	}
 
-		ambiguous = FALSE;
+	return text;
+}
 
-		for (test = paper + 1; test < paper_count; test++) {
-			/* Do the PS2 filenames match or not? */
 
-			if (strcmp(paper_sizes[paper].ps2_file, paper_sizes[test].ps2_file) != 0)
-				continue;
+/**
+ * Parse a dimension from a snippet, in points with up to three decimal
+ * places, into millipoints.
+ *
+ * \param *text			The start of the dimension, which may be
+ *				preceded by spaces.
+ * \param *end			The end of the text.
+ * \param *value		Pointer to a variable to take the dimension.
+ * \return			Pointer to the text following the dimension, or
+ *				NULL if the dimension can't be read exactly.
+ */
+
+static char *paper_parse_millipoints(char *text, char *end, unsigned *value)
+{
+	unsigned	result = 0;
+	int		places = 0;
+	osbool		digits = FALSE;
 
-			/* If they do, do the paper sizes agree or not? */
+	while (text < end && (*text == ' ' || *text == '\t'))
+		text++;
 
-			if (paper_sizes[paper].width == paper_sizes[test].width && paper_sizes[paper].height == paper_sizes[test].height)
-				continue;
+	while (text < end && *text >= '0' && *text <= '9') {
+		result = (result * 10) + (*text++ - '0');
+		digits = TRUE;
+	}
 
-			/* If they don't, the same filename is being used for different sizes of paper. */
+	if (text < end && *text == '.') {
+		text++;
 
-			ambiguous = TRUE;
-			break;
+		while (text < end && *text >= '0' && *text <= '9') {
+			if (places < 3) {
+				result = (result * 10) + (*text - '0');
+				places++;
+			} else if (*text != '0') {
+				return NULL;
+			}
+
+			digits = TRUE;
+			text++;
 		}
+	}
 
-		/* Update the status of this paper definition. */
+	if (!digits)
+		return NULL;
 
-		paper_sizes[paper].size_status = (ambiguous) ? PAPER_SIZE_STATUS_AMBIGUOUS : PAPER_SIZE_STATUS_OK;
+	while (places++ < 3)
+		result *= 10;
 
-		/* Update the status of any other definitions using the same PS2 filename. */
+	*value = result;
 
-		for (test = paper + 1; test < paper_count; test++) {
-			if (strcmp(paper_sizes[paper].ps2_file, paper_sizes[test].ps2_file) == 0)
-				paper_sizes[test].size_status = (ambiguous) ? PAPER_SIZE_STATUS_AMBIGUOUS : PAPER_SIZE_STATUS_OK;
-		}
+	return text;
+}
+
+
+/**
+ * Look up the results of parsing a snippet in the cache. The hash only
+ * narrows down the search, so the contents are compared before a cached
+ * result is accepted.
+ *
+ * \param hash			The hash of the snippet contents.
+ * \param *text			The snippet contents.
+ * \param length		The length of the snippet contents.
+ * \return			Pointer to the cached results, or NULL.
+ */
+
+static struct paper_snippet_result *paper_find_snippet_result(unsigned hash, char *text, size_t length)
+{
+	unsigned	slot;
+
+	if (paper_snippet_cache == NULL)
+		return NULL;
+
+	for (slot = hash & (paper_snippet_cache_size - 1); paper_snippet_cache[slot].used; slot = (slot + 1) & (paper_snippet_cache_size - 1)) {
+		if (paper_snippet_cache[slot].hash == hash && paper_snippet_cache[slot].length == length &&
+				memcmp(paper_snippet_text + paper_snippet_cache[slot].text, text, length) == 0)
+			return paper_snippet_cache + slot;
 	}
+
+	return NULL;
 }
 
 
 /**
- * Read a PS2 snippet and compare its contents to a paper size definition.
- * 
- * \param *paper		Pointer to the paper definition to be read.
- * \param *file_path		Pointer to the filename to read from.
- * \return			The status of the PS2 snippet in relation to the paper size.
+ * Add the results of parsing a snippet to the cache, along with a copy of
+ * the contents which were parsed, growing the cache if it is becoming full.
+ *
+ * \param *result		The results to be added.
+ * \param *text			The snippet contents, of the length in the results.
+ * \return			Pointer to the cached results, or NULL on failure.
  */
 
-static enum paper_file_status paper_read_pagesize(struct paper_size *paper, char *file)
+static struct paper_snippet_result *paper_add_snippet_result(struct paper_snippet_result *result, char *text)
 {
-	FILE	*in;
-	char	line[1024];
-	double	width, height;
+	struct paper_snippet_result	*old_cache;
+	unsigned			old_size, size, slot, i;
+	size_t				text_size;
+	char				*new_text;
 
-	if (file == NULL)
-		return PAPER_FILE_STATUS_UNKNOWN;
+	/* Keep a copy of the contents, so that later matches can be checked. */
 
-	in = fopen(file, "r");
-	if (in == NULL)
-		return PAPER_FILE_STATUS_UNKNOWN;
+	if (paper_snippet_text_used + result->length > paper_snippet_text_size) {
+		for (text_size = (paper_snippet_text_size == 0) ? PAPER_SNIPPET_TEXT_MIN_SIZE : paper_snippet_text_size;
+				text_size < paper_snippet_text_used + result->length; text_size *= 2);
 
-	if (fgets(line, sizeof(line), in) == NULL) {
-		fclose(in);
-		return PAPER_FILE_STATUS_UNKNOWN;
-	}
+		new_text = realloc(paper_snippet_text, text_size);
+		if (new_text == NULL)
+			return NULL;
 
-	if (strcmp(line, "% Created by PS2Paper\n") != 0) {
-		fclose(in);
-		return PAPER_FILE_STATUS_UNKNOWN;
+		paper_snippet_text = new_text;
+		paper_snippet_text_size = text_size;
 	}
 
-	if (fgets(line, sizeof(line), in) == NULL) {
-		fclose(in);
-		return PAPER_FILE_STATUS_UNKNOWN;
-	}
+	/* Keep the cache no more than half full, rehashing into a larger
+	 * block when necessary.
+	 */
 
-	if (fgets(line, sizeof(line), in) == NULL) {
-		fclose(in);
-		return PAPER_FILE_STATUS_UNKNOWN;
+	if ((paper_snippet_cache_count + 1) * 2 > paper_snippet_cache_size) {
+		size = (paper_snippet_cache_size == 0) ? PAPER_SNIPPET_CACHE_MIN_SIZE : paper_snippet_cache_size * 2;
+
+		old_cache = paper_snippet_cache;
+		old_size = paper_snippet_cache_size;
+
+		paper_snippet_cache = malloc(size * sizeof(struct paper_snippet_result));
+		if (paper_snippet_cache == NULL) {
+			paper_snippet_cache = old_cache;
+			return NULL;
+		}
+
+		paper_snippet_cache_size = size;
+
+		for (slot = 0; slot < size; slot++)
+			paper_snippet_cache[slot].used = FALSE;
+
+		for (i = 0; i < old_size; i++) {
+			if (!old_cache[i].used)
+				continue;
+
+			for (slot = old_cache[i].hash & (size - 1); paper_snippet_cache[slot].used; slot = (slot + 1) & (size - 1));
+
+			paper_snippet_cache[slot] = old_cache[i];
+		}
+
+		free(old_cache);
 	}
 
-	sscanf(line, "<< /PageSize [ %lf %lf ] >> setpagedevice \n", &width, &height);
+	for (slot = result->hash & (paper_snippet_cache_size - 1); paper_snippet_cache[slot].used; slot = (slot + 1) & (paper_snippet_cache_size - 1));
 
-	fclose(in);
+	paper_snippet_cache[slot] = *result;
+	paper_snippet_cache[slot].used = TRUE;
+	paper_snippet_cache[slot].text = paper_snippet_text_used;
+	paper_snippet_cache_count++;
 
-	if (width * 1000.0 != paper->width || height * 1000.0 != paper->height)
-		return PAPER_FILE_STATUS_INCORRECT;
+	memcpy(paper_snippet_text + paper_snippet_text_used, text, result->length);
+	paper_snippet_text_used += result->length;
 
-	return PAPER_FILE_STATUS_CORRECT;
+	return paper_snippet_cache + slot;
 }
 
 
 /**
- * Ensure that the Paper folder exists on Choices$Write, ready for writing
- * PS2 files to.
+ * Ensure that the Paper folders exist in the choices of each root, ready
+ * for writing PS2 files to.
  *
  * \return			TRUE if successful; FALSE on failure.
  */
 
 osbool paper_ensure_ps2_file_folder(void)
 {
-	int			var_len;
+	int			var_len, root;
 	char			file_path[PAPER_MAX_LINE_LEN];
+	osbool			success = TRUE;
 
 
 	*file_path = '\0';
 
+	/* The local root writes to Choices$Write, which must exist. */
+
 	os_read_var_val_size("Choices$Write", 0, os_VARTYPE_STRING, &var_len, NULL);
 
 	if (var_len == 0)
@@ -457,20 +2792,51 @@ osbool paper_ensure_ps2_file_folder(void)
 	if (osfile_read_no_path(file_path, NULL, NULL, NULL, NULL) == fileswitch_NOT_FOUND)
 		osfile_create_dir(file_path, 0);
 
-	string_printf(file_path, PAPER_MAX_LINE_LEN, "<Choices$Write>.Printers.ps");
-	if (osfile_read_no_path(file_path, NULL, NULL, NULL, NULL) == fileswitch_NOT_FOUND)
-		osfile_create_dir(file_path, 0);
+	/* Each root then needs a ps.Paper folder in its choices. */
 
-	string_printf(file_path, PAPER_MAX_LINE_LEN, "<Choices$Write>.Printers.ps.Paper");
-	if (osfile_read_no_path(file_path, NULL, NULL, NULL, NULL) == fileswitch_NOT_FOUND)
-		osfile_create_dir(file_path, 0);
+	for (root = 0; root < paper_root_count; root++) {
+		string_printf(file_path, PAPER_MAX_LINE_LEN, "%s", paper_roots[root].write);
+		if (!paper_ensure_folder(file_path))
+			success = FALSE;
+	}
+
+	return success;
+}
+
+
+/**
+ * Ensure that a snippet folder and its parent exist, creating them if
+ * required.
+ *
+ * \param *path			The path of the folder, which will be
+ *				corrupted during the process.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool paper_ensure_folder(char *path)
+{
+	char	*leaf;
+
+	leaf = strrchr(path, '.');
+	if (leaf == NULL)
+		return FALSE;
+
+	*leaf = '\0';
+	if (osfile_read_no_path(path, NULL, NULL, NULL, NULL) == fileswitch_NOT_FOUND && xosfile_create_dir(path, 0) != NULL)
+		return FALSE;
+
+	*leaf = '.';
+	if (osfile_read_no_path(path, NULL, NULL, NULL, NULL) == fileswitch_NOT_FOUND && xosfile_create_dir(path, 0) != NULL)
+		return FALSE;
 
 	return TRUE;
 }
 
 
 /**
- * Write a PS2 snippet file for a paper definition.
+ * Write a PS2 snippet file for a paper definition. The snippet is rendered
+ * into memory and passed to the write-behind queue, which will write it to
+ * disc in the background if the existing file differs.
  * 
  * \param *paper		Pointer to the paper definition to be written.
  * \param *file_path		Pointer to the filename to write to.
@@ -479,25 +2845,32 @@ osbool paper_ensure_ps2_file_folder(void)
 
 static osbool paper_write_pagesize(struct paper_size *paper, char *file_path)
 {
-	FILE	*out;
-	char	filename[PAPER_MAX_FILENAME_LENGTH];
+	char		filename[PAPER_MAX_FILENAME_LENGTH], snippet[SNIPPET_MAX_LEN];
+	int		length;
 
 	if (paper == NULL)
 		return FALSE;
 
 	string_printf(filename, PAPER_MAX_FILENAME_LENGTH, "%s.%s", file_path, paper->ps2_file);
 
-	out = fopen(filename, "w");
-	if (out == NULL)
+	length = snippet_render(SNIPPET_FORMAT_PAGESIZE, paper, snippet, SNIPPET_MAX_LEN);
+	if (length < 0)
 		return FALSE;
 
-	fprintf(out, "%% Created by PS2Paper\n");
-	fprintf(out, "%%%%BeginFeature: PageSize %s\n", paper->name);
-	fprintf(out, "<< /PageSize [ %.3f %.3f ] >> setpagedevice\n", (double) paper->width / 1000.0, (double) paper->height / 1000.0);
-	fprintf(out, "%%%%EndFeature\n");
+	return queue_add_write(filename, snippet, length, PAPER_SNIPPET_FILETYPE);
+}
 
-	fclose(out);
-	osfile_set_type (filename, (bits) 0xff5);
 
-	return TRUE;
+/**
+ * Handle the completion of a batch of snippet writes, by passing the
+ * results on to the list window and then re-reading the definitions to
+ * pick up the new snippet states on the next Null Event.
+ *
+ * \param *report		The results of the batch of writes.
+ */
+
+static void paper_write_complete(struct queue_report *report)
+{
+	list_report_write_status(report);
+	paper_request_rescan();
 }
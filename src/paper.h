@@ -30,6 +30,10 @@
 #ifndef PS2PAPER_PAPER
 #define PS2PAPER_PAPER
 
+#include "fields.h"
+#include "journal.h"
+#include "standard.h"
+
 /* Static constants */
 
 /**
@@ -44,6 +48,18 @@
 
 #define PAPER_FILE_LEN 128
 
+/**
+ * The maximum amount of space allocated for a paper root name.
+ */
+
+#define PAPER_ROOT_NAME_LEN 32
+
+/**
+ * The maximum amount of space allocated for a paper root path.
+ */
+
+#define PAPER_ROOT_PATH_LEN 256
+
 /* Data structures */
 
 /**
@@ -72,12 +88,48 @@ enum paper_size_status {
  */
 
 enum paper_file_status {
+	PAPER_FILE_STATUS_UNCHECKED,				/**< The file hasn't yet been checked.				*/
 	PAPER_FILE_STATUS_MISSING,				/**< There is no file for the paper size.			*/
 	PAPER_FILE_STATUS_UNKNOWN,				/**< There is a file, but it's not one of ours.			*/
 	PAPER_FILE_STATUS_CORRECT,				/**< There is a file, and it matches the paper.			*/
 	PAPER_FILE_STATUS_INCORRECT				/**< There is a file, but the size is wrong.			*/
 };
 
+/**
+ * The action which writing a snippet file for a paper definition will take.
+ */
+
+enum paper_write_action {
+	PAPER_WRITE_ACTION_NONE = 0,				/**< The snippet is already correct, or can't be written.	*/
+	PAPER_WRITE_ACTION_NEW,					/**< A new snippet will be created.				*/
+	PAPER_WRITE_ACTION_INCORRECT,				/**< An incorrect snippet of ours will be replaced.		*/
+	PAPER_WRITE_ACTION_FOREIGN,				/**< An unrecognised file will be overwritten.			*/
+	PAPER_WRITE_ACTION_COUNT				/**< The number of write actions; must be last.			*/
+};
+
+/**
+ * A root from which paper definitions are loaded: a Printers installation
+ * and its associated choices.
+ */
+
+struct paper_root {
+	char			name[PAPER_ROOT_NAME_LEN];	/**< The name of the root, for display.				*/
+	char			printers[PAPER_ROOT_PATH_LEN];	/**< The path prefix for the Printers application.		*/
+	char			choices[PAPER_ROOT_PATH_LEN];	/**< The path prefix for the Printers choices.			*/
+	char			write[PAPER_ROOT_PATH_LEN];	/**< The folder into which new snippets are written.		*/
+};
+
+/**
+ * The stages of a background paper definition load.
+ */
+
+enum paper_load_stage {
+	PAPER_LOAD_STAGE_IDLE,					/**< No load is in progress.					*/
+	PAPER_LOAD_STAGE_PARSE,					/**< The definition files are being parsed.			*/
+	PAPER_LOAD_STAGE_VERIFY,				/**< The PS2 snippet files are being verified.			*/
+	PAPER_LOAD_STAGE_SCAN					/**< The paper sizes are being scanned for clashes.		*/
+};
+
 /**
  * The definition of a paper size.
  */
@@ -87,25 +139,108 @@ struct paper_size {
 	int			width;				/**< The Printers width of the paper				*/
 	int			height;				/**< The Printers height of the paper				*/
 	enum paper_size_status	size_status;			/**< The status of the paper size				*/
+	enum standard_match	standard_match;			/**< The relationship to a standard paper size.			*/
+	int			standard;			/**< The related standard size, or STANDARD_NONE.		*/
+	int			standard_error;			/**< The difference from the standard size, in millipoints.	*/
 	enum paper_source	source;				/**< The name of the source file				*/
+	int			root;				/**< The index of the root holding the definition		*/
 	char			ps2_file[PAPER_FILE_LEN];	/**< The associated PS2 Paper file, or ""			*/
 	enum paper_file_status	ps2_file_status;		/**< Indicate the status of the Paper File.			*/
+	osbool			shadowed;			/**< TRUE if overridden by a definition from a higher layer.	*/
+	unsigned		changes;			/**< The JOURNAL_CHANGE flags since the previous load.		*/
+	int			first_field;			/**< The first of the other fields from the source file.	*/
+	int			field_count;			/**< The number of other fields from the source file.		*/
+	int			file_next;			/**< The next definition in the root using the same snippet, or -1.	*/
+};
+
+/**
+ * A snippet file which isn't referenced by any of the paper definitions
+ * in its root.
+ */
+
+struct paper_orphan {
+	char			name[PAPER_FILE_LEN];		/**< The leafname of the snippet file.				*/
+	int			root;				/**< The index of the root holding the file.			*/
+	osbool			choices;			/**< TRUE if the file is in the choices; FALSE if in Printers.	*/
+};
+
+/**
+ * The details of a definition source file within a root, as found by the
+ * last load.
+ */
+
+struct paper_source_record {
+	osbool			present;			/**< TRUE if the file was found; else FALSE.			*/
+	int			size;				/**< The size of the file, in bytes.				*/
+	unsigned		hash;				/**< The hash of the file contents.				*/
+	int			shared_root;			/**< The root whose identical file was parsed, or -1.		*/
+	size_t			definitions;			/**< The number of definitions taken from the file.		*/
 };
 
 /**
- * Initialise the paper definitions list.
+ * Initialise the paper definitions list. The definitions themselves are
+ * not read until paper_ensure_loaded() is called.
  */
 
 void paper_initialise(void);
 
 
 /**
- * Reset the paper definitions, then read them back in from the source
- * files in Printers.
+ * Start to read the paper definitions if they haven't been read since the
+ * application started. The catalogue isn't loaded until something needs it,
+ * so that the task starts up quickly.
+ */
+
+void paper_ensure_loaded(void);
+
+
+/**
+ * Reset the paper definitions, then start to read them back in from the
+ * source files in Printers. The load takes place in the background, and
+ * the list window is updated as definitions become available.
  */
 
 void paper_read_definitions(void);
 
+
+/**
+ * Request that the paper definitions are re-read. The catalogue is marked
+ * as stale, and a single rescan is carried out on the next Null Event, so
+ * that any number of requests made before then are merged into one.
+ */
+
+void paper_request_rescan(void);
+
+
+/**
+ * Test whether a rescan has been requested but has yet to start.
+ *
+ * \return			TRUE if a rescan is pending; else FALSE.
+ */
+
+osbool paper_rescan_pending(void);
+
+
+/**
+ * Cancel any background load which is in progress, leaving the definitions
+ * which have been read so far in place.
+ */
+
+void paper_cancel_load(void);
+
+
+/**
+ * Report the progress of any background load.
+ *
+ * \param *done			Pointer to variable to take the number of items
+ *				processed in the current stage, or NULL.
+ * \param *total		Pointer to variable to take the number of items
+ *				in the current stage (or 0 if not known), or NULL.
+ * \return			The current stage of the load.
+ */
+
+enum paper_load_stage paper_get_load_stage(size_t *done, size_t *total);
+
 /**
  * Return the number of paper definitions which are currently stored.
  *
@@ -114,6 +249,24 @@ void paper_read_definitions(void);
 
 size_t paper_get_definition_count(void);
 
+/**
+ * Return the number of paper roots which are currently defined. The
+ * first root is always the local system.
+ *
+ * \return			The number of paper roots.
+ */
+
+size_t paper_get_root_count(void);
+
+/**
+ * Return the name of a paper root.
+ *
+ * \param root			The index of the root to return.
+ * \return			Pointer to the root name, or NULL.
+ */
+
+char *paper_get_root_name(int root);
+
 /**
  * Return a pointer to the paper definition array. This points into a flex
  * heap, so the pointer will not remain valid if anything causes the heap
@@ -124,6 +277,176 @@ size_t paper_get_definition_count(void);
 
 struct paper_size *paper_get_definitions(void);
 
+/**
+ * Return the number of orphaned snippet files found by the last load.
+ *
+ * \return			The number of orphaned snippets.
+ */
+
+size_t paper_get_orphan_count(void);
+
+/**
+ * Return a pointer to the orphaned snippet array.
+ *
+ * \return			Pointer to the first entry in the array, or NULL.
+ */
+
+struct paper_orphan *paper_get_orphans(void);
+
+/**
+ * Return the number of definition source files in each root.
+ *
+ * \return			The number of source files.
+ */
+
+int paper_get_source_file_count(void);
+
+/**
+ * Return the name of a definition source file, relative to its root.
+ *
+ * \param file			The index of the source file.
+ * \return			Pointer to the name, or NULL.
+ */
+
+char *paper_get_source_file_name(int file);
+
+/**
+ * Return the details of a definition source file in a root.
+ *
+ * \param root			The index of the root.
+ * \param file			The index of the source file.
+ * \return			Pointer to the details, or NULL.
+ */
+
+struct paper_source_record *paper_get_source_record(int root, int file);
+
+/**
+ * Report how many snippet files were checked by the last load, and how
+ * many of those had unique contents which needed to be parsed.
+ *
+ * \param *checked		Pointer to a variable to take the number checked, or NULL.
+ * \param *parsed		Pointer to a variable to take the number parsed, or NULL.
+ */
+
+void paper_get_snippet_statistics(size_t *checked, size_t *parsed);
+
+/**
+ * Test whether a paper definition is the first in the catalogue to use its
+ * snippet filename, looking across all of the roots in order.
+ *
+ * \param definition		The index of the definition to test.
+ * \return			TRUE if the definition is the first to use its
+ *				filename; FALSE if it is a duplicate or invalid.
+ */
+
+osbool paper_is_first_file_use(size_t definition);
+
+/**
+ * Find the definition of a paper name which takes effect in a root, once
+ * the user, device and master definitions have been overlaid according to
+ * the printer driver's precedence.
+ *
+ * \param root			The index of the root to look in.
+ * \param *name			The name of the paper to look up.
+ * \return			The index of the effective definition, or -1.
+ */
+
+int paper_find_effective_definition(int root, char *name);
+
+/**
+ * Return the size of paper which takes effect for a name in a root, once
+ * the definition layers have been overlaid.
+ *
+ * \param root			The index of the root to look in.
+ * \param *name			The name of the paper to look up.
+ * \param *width		Pointer to variable to take the width, or NULL.
+ * \param *height		Pointer to variable to take the height, or NULL.
+ * \return			TRUE if the name is defined; else FALSE.
+ */
+
+osbool paper_get_effective_size(int root, char *name, int *width, int *height);
+
+/**
+ * Return the value of a field from a paper definition's source file which
+ * isn't otherwise held in the definition. This points into a flex heap, so
+ * the pointer will not remain valid if anything causes the heap to shift.
+ *
+ * \param definition		The index of the definition.
+ * \param *key			The key name of the field, without the colon.
+ * \return			Pointer to the value, or NULL if not present.
+ */
+
+char *paper_get_field(size_t definition, char *key);
+
+/**
+ * Return the number of additional fields held for a paper definition.
+ *
+ * \param definition		The index of the definition.
+ * \return			The number of fields.
+ */
+
+int paper_get_field_count(size_t definition);
+
+/**
+ * Return one of the additional fields held for a paper definition, in the
+ * order that they appeared in the source file. The value points into a flex
+ * heap, so will not remain valid if anything causes the heap to shift.
+ *
+ * \param definition		The index of the definition.
+ * \param entry			The index of the field within the definition.
+ * \param **key			Pointer to a variable to take a pointer to the
+ *				key name, or NULL.
+ * \return			Pointer to the value, or NULL if not present.
+ */
+
+char *paper_get_field_entry(size_t definition, int entry, char **key);
+
+/**
+ * Test whether a paper definition can be edited in place: it must be the
+ * effective user definition of its name, and the background load must not
+ * be running.
+ *
+ * \param definition		The index of the definition to test.
+ * \return			TRUE if the definition can be edited; else FALSE.
+ */
+
+osbool paper_can_edit_user_size(size_t definition);
+
+/**
+ * Change the size of a user paper definition, patching the new values into
+ * the user definitions file and updating the definition in the catalogue.
+ *
+ * \param definition		The index of the definition to change.
+ * \param width			The new width, in millipoints.
+ * \param height		The new height, in millipoints.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool paper_set_user_size(size_t definition, int width, int height);
+
+/**
+ * Copy the size of a paper definition into a user definition in the same
+ * root, adding the user definition to the user definitions file if it
+ * doesn't already exist.
+ *
+ * \param definition		The index of the definition to copy.
+ * \param *name			The name to give the user definition.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool paper_add_user_size(size_t definition, char *name);
+
+/**
+ * Delete a user paper definition, removing it from the user definitions
+ * file and from the catalogue. Any definition from a lower layer which it
+ * was shadowing takes effect again.
+ *
+ * \param definition		The index of the definition to delete.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool paper_delete_user_size(size_t definition);
+
 /**
  * Launch the snippet file relating to a paper definition, using a
  * *Filer_Run command.
@@ -134,18 +457,32 @@ struct paper_size *paper_get_definitions(void);
 
 void paper_launch_file(int definition);
 
+/**
+ * Work out what writing a new snippet file for a paper definition would
+ * do, checking the existing snippet first if the background load hasn't
+ * yet reached it.
+ *
+ * \param definition		The index into the definitions of the
+ *				definition to be planned.
+ * \return			The action which a write would take.
+ */
+
+enum paper_write_action paper_plan_write(int definition);
+
 /**
  * Write a new snipped file for a paper definition.
  *
  * \param definition		The index into the definitions of the
  *				definition to be launched.
+ * \param overwrite		TRUE to overwrite files which aren't recognised
+ *				as snippets; FALSE to leave them alone.
  */
 
-void paper_write_file(int definition);
+void paper_write_file(int definition, osbool overwrite);
 
 /**
- * Ensure that the Paper folder exists on Choices$Write, ready for writing
- * PS2 files to.
+ * Ensure that the Paper folders exist in the choices of each root, ready
+ * for writing PS2 files to.
  *
  * \return			TRUE if successful; FALSE on failure.
  */
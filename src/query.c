@@ -0,0 +1,681 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: query.c
+ *
+ * Paper status query service implementation.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* OSLib header files */
+
+#include "oslib/types.h"
+#include "oslib/wimp.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/config.h"
+#include "sflib/event.h"
+#include "sflib/string.h"
+
+/* Application header files */
+
+#include "query.h"
+
+#include "dircache.h"
+#include "paper.h"
+#include "standard.h"
+
+/**
+ * The value used to mark an empty slot in the hash indexes.
+ */
+
+#define QUERY_INDEX_EMPTY -1
+
+/**
+ * The minimum size of the hash indexes, which must be a power of two.
+ */
+
+#define QUERY_INDEX_MIN_SIZE 64
+
+/**
+ * The difference, in millipoints, within which dimensions are taken to
+ * match in a size query.
+ */
+
+#define QUERY_TOLERANCE 500
+
+/**
+ * The offset of the string in a query or reply message's data.
+ */
+
+#define QUERY_STRING_OFFSET 12
+#define QUERY_REPLY_STRING_OFFSET 32
+
+/**
+ * The size of the data area in a Wimp message.
+ */
+
+#define QUERY_MESSAGE_DATA_LEN 236
+
+/**
+ * The size of a Wimp message header.
+ */
+
+#define QUERY_MESSAGE_HEADER_LEN 20
+
+/**
+ * The name and filename hash indexes, which hold every definition so that
+ * duplicates can be counted.
+ */
+
+static int		*query_name_index = NULL;
+static int		*query_file_index = NULL;
+
+/**
+ * The query message number, or 0 if the service is disabled. The reply
+ * uses the following message number.
+ */
+
+static bits		query_message = 0;
+
+/**
+ * The size of the hash indexes.
+ */
+
+static unsigned		query_index_size = 0;
+
+/**
+ * The definitions, sorted by short and then long side.
+ */
+
+static int		*query_size_order = NULL;
+
+/**
+ * The number of definitions in the indexes.
+ */
+
+static size_t		query_count = 0;
+
+/**
+ * TRUE if the indexes are up to date with the definitions.
+ */
+
+static osbool		query_valid = FALSE;
+
+/**
+ * The definitions being sorted, for use by the comparison function.
+ */
+
+static struct paper_size	*query_sort_papers = NULL;
+
+static osbool		query_message_handler(wimp_message *message);
+static osbool		query_build_indexes(void);
+static void		query_insert_hashed(int *index, int definition, char *text);
+static void		query_remove_hashed(int *index, int definition, osbool file);
+static void		query_insert_size(int definition, size_t count);
+static int		query_find_hashed(int *index, char *text, osbool file, int *matches);
+static int		query_find_size(int width, int height, int *matches);
+static int		query_compare_sizes(const void *a, const void *b);
+static void		query_get_sides(struct paper_size *paper, int *short_side, int *long_side);
+
+
+/**
+ * Initialise the query service, if a message number has been configured.
+ */
+
+void query_initialise(void)
+{
+	query_message = config_int_read("QueryMessage");
+
+	if (query_message != 0)
+		event_add_message_handler(query_message, EVENT_MESSAGE_INCOMING, query_message_handler);
+}
+
+
+/**
+ * Discard the query indexes, because the paper definitions have changed.
+ * The indexes are rebuilt when the next query arrives.
+ */
+
+void query_reset(void)
+{
+	free(query_name_index);
+	free(query_file_index);
+	free(query_size_order);
+
+	query_name_index = NULL;
+	query_file_index = NULL;
+	query_size_order = NULL;
+	query_index_size = 0;
+	query_count = 0;
+	query_valid = FALSE;
+}
+
+
+/**
+ * Add a paper definition which has just been added to the end of the
+ * catalogue to the query indexes, if they are up to date. If the hash
+ * indexes would become too full, they are discarded to be rebuilt when the
+ * next query arrives.
+ *
+ * \param definition		The index of the new definition.
+ */
+
+void query_add_definition(size_t definition)
+{
+	struct paper_size	*papers;
+	int			*order;
+
+	if (!query_valid)
+		return;
+
+	if (definition != query_count || (query_count + 1) * 2 > query_index_size) {
+		query_reset();
+		return;
+	}
+
+	order = realloc(query_size_order, (query_count + 1) * sizeof(int));
+	if (order == NULL) {
+		query_reset();
+		return;
+	}
+
+	query_size_order = order;
+
+	papers = paper_get_definitions();
+
+	query_insert_hashed(query_name_index, definition, papers[definition].name);
+	query_insert_hashed(query_file_index, definition, papers[definition].ps2_file);
+	query_insert_size(definition, query_count);
+
+	query_count++;
+}
+
+
+/**
+ * Update the query indexes following a change to the size of a paper
+ * definition, if they are up to date. The name and filename are unchanged,
+ * so only the size order needs to be adjusted.
+ *
+ * \param definition		The index of the definition which has changed.
+ */
+
+void query_update_definition(size_t definition)
+{
+	size_t	position;
+
+	if (!query_valid || definition >= query_count)
+		return;
+
+	for (position = 0; position < query_count && query_size_order[position] != definition; position++);
+
+	if (position >= query_count)
+		return;
+
+	memmove(query_size_order + position, query_size_order + position + 1, (query_count - position - 1) * sizeof(int));
+	query_insert_size(definition, query_count - 1);
+}
+
+
+/**
+ * Remove a paper definition from the query indexes, if they are up to date,
+ * before it is removed from the catalogue. The definitions after it are
+ * renumbered to allow for the move.
+ *
+ * \param definition		The index of the definition to remove.
+ */
+
+void query_remove_definition(size_t definition)
+{
+	size_t		position;
+	unsigned	slot;
+
+	if (!query_valid || definition >= query_count)
+		return;
+
+	query_remove_hashed(query_name_index, definition, FALSE);
+	query_remove_hashed(query_file_index, definition, TRUE);
+
+	for (position = 0; position < query_count && query_size_order[position] != definition; position++);
+
+	if (position < query_count)
+		memmove(query_size_order + position, query_size_order + position + 1, (query_count - position - 1) * sizeof(int));
+
+	query_count--;
+
+	for (slot = 0; slot < query_index_size; slot++) {
+		if (query_name_index[slot] > (int) definition)
+			query_name_index[slot]--;
+
+		if (query_file_index[slot] > (int) definition)
+			query_file_index[slot]--;
+	}
+
+	for (position = 0; position < query_count; position++) {
+		if (query_size_order[position] > (int) definition)
+			query_size_order[position]--;
+	}
+}
+
+
+/**
+ * Handle incoming Message_PS2PaperQuery, replying with the details of the
+ * first matching paper definition.
+ *
+ * \param *message		The message data block.
+ * \return			TRUE to claim the message.
+ */
+
+static osbool query_message_handler(wimp_message *message)
+{
+	struct paper_size	*paper;
+	enum query_result	result;
+	char			text[QUERY_MESSAGE_DATA_LEN - QUERY_STRING_OFFSET];
+	int			found = QUERY_INDEX_EMPTY, matches = 0;
+	size_t			length, used;
+
+	/* Take a copy of the query string, in case it isn't terminated. */
+
+	if (message->size > QUERY_MESSAGE_HEADER_LEN + QUERY_STRING_OFFSET)
+		length = message->size - QUERY_MESSAGE_HEADER_LEN - QUERY_STRING_OFFSET;
+	else
+		length = 0;
+
+	if (length >= sizeof(text))
+		length = sizeof(text) - 1;
+
+	memcpy(text, message->data.reserved + QUERY_STRING_OFFSET, length);
+	text[length] = '\0';
+
+	/* Answer the query from the indexes, building them if required. If
+	 * the catalogue hasn't been read yet, start it loading and report that
+	 * we're busy.
+	 */
+
+	paper_ensure_loaded();
+
+	if (paper_get_load_stage(NULL, NULL) != PAPER_LOAD_STAGE_IDLE || paper_rescan_pending()) {
+		result = QUERY_RESULT_BUSY;
+	} else if (!query_valid && !query_build_indexes()) {
+		result = QUERY_RESULT_BUSY;
+	} else {
+		switch (message->data.words[0]) {
+		case QUERY_TYPE_NAME:
+			found = query_find_hashed(query_name_index, text, FALSE, &matches);
+			result = QUERY_RESULT_NOT_FOUND;
+			break;
+		case QUERY_TYPE_FILE:
+			found = query_find_hashed(query_file_index, text, TRUE, &matches);
+			result = QUERY_RESULT_NOT_FOUND;
+			break;
+		case QUERY_TYPE_SIZE:
+			found = query_find_size(message->data.words[1], message->data.words[2], &matches);
+			result = QUERY_RESULT_NOT_FOUND;
+			break;
+		default:
+			result = QUERY_RESULT_BAD_QUERY;
+			break;
+		}
+
+		if (found != QUERY_INDEX_EMPTY)
+			result = QUERY_RESULT_FOUND;
+	}
+
+	/* Build the reply in the same block. */
+
+	memset(message->data.reserved, 0, QUERY_REPLY_STRING_OFFSET);
+
+	message->data.words[0] = result;
+	message->data.words[1] = matches;
+
+	used = QUERY_REPLY_STRING_OFFSET;
+
+	if (found != QUERY_INDEX_EMPTY) {
+		paper = paper_get_definitions() + found;
+
+		message->data.words[2] = paper->width;
+		message->data.words[3] = paper->height;
+		message->data.words[4] = paper->size_status;
+		message->data.words[5] = paper->ps2_file_status;
+		message->data.words[6] = paper->standard_match;
+		message->data.words[7] = paper->root;
+
+		string_copy(message->data.reserved + used, paper->ps2_file, QUERY_MESSAGE_DATA_LEN - used);
+		used += strlen(message->data.reserved + used) + 1;
+
+		if (used < QUERY_MESSAGE_DATA_LEN) {
+			string_copy(message->data.reserved + used, paper->name, QUERY_MESSAGE_DATA_LEN - used);
+			used += strlen(message->data.reserved + used) + 1;
+		}
+	}
+
+	message->size = (QUERY_MESSAGE_HEADER_LEN + used + 3) & ~3;
+	message->your_ref = message->my_ref;
+	message->action = query_message + 1;
+
+	xwimp_send_message(wimp_USER_MESSAGE, message, message->sender);
+
+	return TRUE;
+}
+
+
+/**
+ * Build the name, filename and size indexes from the current paper
+ * definitions.
+ *
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool query_build_indexes(void)
+{
+	struct paper_size	*papers;
+	unsigned		size, slot;
+	size_t			paper;
+
+	query_reset();
+
+	query_count = paper_get_definition_count();
+
+	/* Keep the hash indexes no more than half full. */
+
+	for (size = QUERY_INDEX_MIN_SIZE; size < query_count * 2; size *= 2);
+
+	query_name_index = malloc(size * sizeof(int));
+	query_file_index = malloc(size * sizeof(int));
+	query_size_order = malloc(((query_count > 0) ? query_count : 1) * sizeof(int));
+
+	if (query_name_index == NULL || query_file_index == NULL || query_size_order == NULL) {
+		query_reset();
+		return FALSE;
+	}
+
+	query_index_size = size;
+
+	for (slot = 0; slot < size; slot++) {
+		query_name_index[slot] = QUERY_INDEX_EMPTY;
+		query_file_index[slot] = QUERY_INDEX_EMPTY;
+	}
+
+	/* The definitions are in a flex block, but nothing from here on can
+	 * cause the heap to shift.
+	 */
+
+	papers = paper_get_definitions();
+
+	for (paper = 0; paper < query_count; paper++) {
+		query_insert_hashed(query_name_index, paper, papers[paper].name);
+		query_insert_hashed(query_file_index, paper, papers[paper].ps2_file);
+
+		query_size_order[paper] = paper;
+	}
+
+	query_sort_papers = papers;
+	qsort(query_size_order, query_count, sizeof(int), query_compare_sizes);
+
+	query_valid = TRUE;
+
+	return TRUE;
+}
+
+
+/**
+ * Insert a paper definition into one of the hash indexes, which must have
+ * space for it. Definitions must be inserted in order, so that the first
+ * match found by a lookup is the first in the catalogue.
+ *
+ * \param *index		The index to insert into.
+ * \param definition		The definition to insert.
+ * \param *text			The name or filename to index the definition by.
+ */
+
+static void query_insert_hashed(int *index, int definition, char *text)
+{
+	unsigned	slot;
+
+	slot = dircache_hash_name(text) & (query_index_size - 1);
+
+	while (index[slot] != QUERY_INDEX_EMPTY)
+		slot = (slot + 1) & (query_index_size - 1);
+
+	index[slot] = definition;
+}
+
+
+/**
+ * Remove a paper definition from one of the hash indexes, closing up any
+ * entries further down the probe run so that they can still be found. The
+ * definitions sharing a name keep their order.
+ *
+ * \param *index		The index to remove from.
+ * \param definition		The definition to remove.
+ * \param file			TRUE for the filename index; FALSE for the name index.
+ */
+
+static void query_remove_hashed(int *index, int definition, osbool file)
+{
+	struct paper_size	*papers;
+	unsigned		slot, gap, home, mask;
+	int			test;
+
+	papers = paper_get_definitions();
+	mask = query_index_size - 1;
+
+	slot = dircache_hash_name((file) ? papers[definition].ps2_file : papers[definition].name) & mask;
+
+	while (index[slot] != definition) {
+		if (index[slot] == QUERY_INDEX_EMPTY)
+			return;
+
+		slot = (slot + 1) & mask;
+	}
+
+	index[slot] = QUERY_INDEX_EMPTY;
+
+	for (gap = slot, slot = (slot + 1) & mask; index[slot] != QUERY_INDEX_EMPTY; slot = (slot + 1) & mask) {
+		test = index[slot];
+		home = dircache_hash_name((file) ? papers[test].ps2_file : papers[test].name) & mask;
+
+		if (((slot - home) & mask) >= ((slot - gap) & mask)) {
+			index[gap] = test;
+			index[slot] = QUERY_INDEX_EMPTY;
+			gap = slot;
+		}
+	}
+}
+
+
+/**
+ * Insert a paper definition into its place in the sorted size order, which
+ * must have space for it.
+ *
+ * \param definition		The definition to insert.
+ * \param count			The number of definitions already in the order.
+ */
+
+static void query_insert_size(int definition, size_t count)
+{
+	size_t	low, high, middle;
+
+	query_sort_papers = paper_get_definitions();
+
+	low = 0;
+	high = count;
+
+	while (low < high) {
+		middle = (low + high) / 2;
+
+		if (query_compare_sizes(query_size_order + middle, &definition) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	memmove(query_size_order + low + 1, query_size_order + low, (count - low) * sizeof(int));
+	query_size_order[low] = definition;
+}
+
+
+/**
+ * Look up a paper name or snippet filename in one of the hash indexes.
+ * The definitions were added in order, so the first match found is the
+ * first in the catalogue.
+ *
+ * \param *index		The index to search.
+ * \param *text			The name or filename to look for.
+ * \param file			TRUE to compare filenames; FALSE to compare names.
+ * \param *matches		Pointer to a variable to take the number of matches.
+ * \return			The first matching definition, or QUERY_INDEX_EMPTY.
+ */
+
+static int query_find_hashed(int *index, char *text, osbool file, int *matches)
+{
+	struct paper_size	*papers;
+	unsigned		slot;
+	int			found = QUERY_INDEX_EMPTY;
+
+	*matches = 0;
+
+	papers = paper_get_definitions();
+
+	slot = dircache_hash_name(text) & (query_index_size - 1);
+
+	while (index[slot] != QUERY_INDEX_EMPTY) {
+		if (string_nocase_strcmp((file) ? papers[index[slot]].ps2_file : papers[index[slot]].name, text) == 0) {
+			if (found == QUERY_INDEX_EMPTY)
+				found = index[slot];
+
+			(*matches)++;
+		}
+
+		slot = (slot + 1) & (query_index_size - 1);
+	}
+
+	return found;
+}
+
+
+/**
+ * Look up a paper size in the sorted size index, using a binary search.
+ *
+ * \param width			The width to look for, in millipoints.
+ * \param height		The height to look for, in millipoints.
+ * \param *matches		Pointer to a variable to take the number of matches.
+ * \return			The first matching definition, or QUERY_INDEX_EMPTY.
+ */
+
+static int query_find_size(int width, int height, int *matches)
+{
+	struct paper_size	*papers;
+	int			low, high, middle, short_side, long_side, test_short, test_long, found = QUERY_INDEX_EMPTY;
+
+	*matches = 0;
+
+	papers = paper_get_definitions();
+
+	short_side = (width < height) ? width : height;
+	long_side = (width < height) ? height : width;
+
+	/* Find the first definition whose short side is within tolerance. */
+
+	low = 0;
+	high = query_count;
+
+	while (low < high) {
+		middle = (low + high) / 2;
+
+		query_get_sides(papers + query_size_order[middle], &test_short, &test_long);
+
+		if (test_short < short_side - QUERY_TOLERANCE)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	/* Check the definitions with a matching short side, reporting the
+	 * earliest in the catalogue.
+	 */
+
+	for (; low < query_count; low++) {
+		query_get_sides(papers + query_size_order[low], &test_short, &test_long);
+
+		if (test_short > short_side + QUERY_TOLERANCE)
+			break;
+
+		if (abs(test_long - long_side) > QUERY_TOLERANCE)
+			continue;
+
+		if (found == QUERY_INDEX_EMPTY || query_size_order[low] < found)
+			found = query_size_order[low];
+
+		(*matches)++;
+	}
+
+	return found;
+}
+
+
+/**
+ * Compare two definitions by their short and then long sides, for qsort().
+ *
+ * \param *a			Pointer to the first definition index.
+ * \param *b			Pointer to the second definition index.
+ * \return			The result of the comparison.
+ */
+
+static int query_compare_sizes(const void *a, const void *b)
+{
+	int	a_short, a_long, b_short, b_long;
+
+	query_get_sides(query_sort_papers + *((const int *) a), &a_short, &a_long);
+	query_get_sides(query_sort_papers + *((const int *) b), &b_short, &b_long);
+
+	if (a_short != b_short)
+		return (a_short < b_short) ? -1 : 1;
+
+	if (a_long != b_long)
+		return (a_long < b_long) ? -1 : 1;
+
+	return *((const int *) a) - *((const int *) b);
+}
+
+
+/**
+ * Find the short and long sides of a paper definition.
+ *
+ * \param *paper		The definition to measure.
+ * \param *short_side		Pointer to a variable to take the short side.
+ * \param *long_side		Pointer to a variable to take the long side.
+ */
+
+static void query_get_sides(struct paper_size *paper, int *short_side, int *long_side)
+{
+	*short_side = (paper->width < paper->height) ? paper->width : paper->height;
+	*long_side = (paper->width < paper->height) ? paper->height : paper->width;
+}
@@ -0,0 +1,114 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: query.h
+ *
+ * Paper status query service interface.
+ *
+ * Other tasks can ask about the paper definitions by sending a
+ * Message_PS2PaperQuery, with the query type in word 0 of the message
+ * data, a width and height in millipoints in words 1 and 2 for dimension
+ * queries, and a zero-terminated name or filename from byte 12 onwards.
+ * A Message_PS2PaperReply is returned with the result in word 0, the
+ * number of matching definitions in word 1, and then the first match's
+ * width, height, size status, snippet status, standard size relationship
+ * and root in words 2 to 7, followed by its snippet filename and name as
+ * zero-terminated strings.
+ *
+ * No message numbers are built in: the service only runs if the QueryMessage
+ * choice holds the first of a block of message numbers allocated for it,
+ * with the query using that number and the reply the one after.
+ */
+
+#ifndef PS2PAPER_QUERY
+#define PS2PAPER_QUERY
+
+/**
+ * The types of query which can be made.
+ */
+
+enum query_type {
+	QUERY_TYPE_NAME = 0,					/**< Find a definition by its paper name.			*/
+	QUERY_TYPE_FILE = 1,					/**< Find a definition by its snippet filename.			*/
+	QUERY_TYPE_SIZE = 2					/**< Find a definition by its dimensions, in either orientation.	*/
+};
+
+/**
+ * The possible results of a query.
+ */
+
+enum query_result {
+	QUERY_RESULT_NOT_FOUND = 0,				/**< No matching definition was found.				*/
+	QUERY_RESULT_FOUND = 1,					/**< A matching definition was found.				*/
+	QUERY_RESULT_BUSY = 2,					/**< The definitions are being loaded; try again later.		*/
+	QUERY_RESULT_BAD_QUERY = 3				/**< The query wasn't understood.				*/
+};
+
+
+/**
+ * Initialise the query service.
+ */
+
+void query_initialise(void);
+
+
+/**
+ * Discard the query indexes, because the paper definitions have changed.
+ * The indexes are rebuilt when the next query arrives.
+ */
+
+void query_reset(void);
+
+
+/**
+ * Add a paper definition which has just been added to the end of the
+ * catalogue to the query indexes.
+ *
+ * \param definition		The index of the new definition.
+ */
+
+void query_add_definition(size_t definition);
+
+
+/**
+ * Update the query indexes following a change to the size of a paper
+ * definition.
+ *
+ * \param definition		The index of the definition which has changed.
+ */
+
+void query_update_definition(size_t definition);
+
+
+/**
+ * Remove a paper definition from the query indexes, before it is removed
+ * from the catalogue.
+ *
+ * \param definition		The index of the definition to remove.
+ */
+
+void query_remove_definition(size_t definition);
+
+#endif
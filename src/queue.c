@@ -0,0 +1,377 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: queue.c
+ *
+ * Write-behind queue for snippet files implementation.
+ */
+
+/* ANSI C header files */
+
+#include <string.h>
+#include <stdlib.h>
+
+/* OSLib header files */
+
+#include "oslib/fileswitch.h"
+#include "oslib/os.h"
+#include "oslib/osfile.h"
+#include "oslib/osfscontrol.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/string.h"
+
+/* Application header files */
+
+#include "queue.h"
+
+#include "scheduler.h"
+
+/**
+ * The maximum length of a queued filename.
+ */
+
+#define QUEUE_MAX_FILENAME_LEN 1024
+
+/**
+ * The leafname used for temporary files while writing.
+ */
+
+#define QUEUE_TEMP_LEAFNAME "~PS2Paper"
+
+/**
+ * The leafname used to hold the previous contents of a file while it is
+ * being replaced.
+ */
+
+#define QUEUE_BACKUP_LEAFNAME "~PS2Backup"
+
+/**
+ * A queued file write.
+ */
+
+struct queue_entry {
+	char			*filename;			/**< The name of the file to be written.			*/
+	char			*data;				/**< The data to be written to the file.			*/
+	int			length;				/**< The length of the data.					*/
+	bits			file_type;			/**< The filetype to give the file.				*/
+
+	struct queue_entry	*next;				/**< The next entry in the queue, or NULL.			*/
+};
+
+static struct queue_entry	*queue_head = NULL;		/**< The first entry in the queue, or NULL.			*/
+static struct queue_entry	*queue_tail = NULL;		/**< The last entry in the queue, or NULL.			*/
+static size_t			queue_count = 0;		/**< The number of entries in the queue.			*/
+
+static struct queue_report	queue_report;			/**< The results of the current batch of writes.		*/
+static queue_callback		queue_complete = NULL;		/**< The callback for when the queue is emptied.		*/
+
+static osbool	queue_flush_poll(os_t end_time, void *data);
+static void	queue_write_entry(struct queue_entry *entry);
+static osbool	queue_file_unchanged(struct queue_entry *entry);
+static void	queue_free_entry(struct queue_entry *entry);
+
+
+/**
+ * Initialise the write-behind queue.
+ *
+ * \param callback		The function to be called each time that the
+ *				queue has been emptied, or NULL.
+ */
+
+void queue_initialise(queue_callback callback)
+{
+	queue_complete = callback;
+}
+
+
+/**
+ * Add a file write to the queue. If a write to the same file is already
+ * waiting, its contents are replaced by the new data so that only the
+ * most recent version gets written.
+ *
+ * \param *filename		The name of the file to be written.
+ * \param *data			The data to be written to the file.
+ * \param length		The length of the data.
+ * \param file_type		The filetype to be given to the file.
+ * \return			TRUE if the write was queued; else FALSE.
+ */
+
+osbool queue_add_write(char *filename, char *data, int length, bits file_type)
+{
+	struct queue_entry	*entry;
+	char			*copy;
+
+	if (filename == NULL || data == NULL || length < 0)
+		return FALSE;
+
+	copy = malloc(length);
+	if (copy == NULL)
+		return FALSE;
+
+	memcpy(copy, data, length);
+
+	/* If there's already a write pending for the file, replace its data. */
+
+	for (entry = queue_head; entry != NULL; entry = entry->next) {
+		if (string_nocase_strcmp(entry->filename, filename) == 0) {
+			free(entry->data);
+			entry->data = copy;
+			entry->length = length;
+			entry->file_type = file_type;
+			return TRUE;
+		}
+	}
+
+	/* Otherwise, add a new entry to the end of the queue. */
+
+	entry = malloc(sizeof(struct queue_entry));
+	if (entry == NULL) {
+		free(copy);
+		return FALSE;
+	}
+
+	entry->filename = malloc(strlen(filename) + 1);
+	if (entry->filename == NULL) {
+		free(copy);
+		free(entry);
+		return FALSE;
+	}
+
+	strcpy(entry->filename, filename);
+	entry->data = copy;
+	entry->length = length;
+	entry->file_type = file_type;
+	entry->next = NULL;
+
+	if (!scheduler_add_task(queue_flush_poll, NULL)) {
+		queue_free_entry(entry);
+		return FALSE;
+	}
+
+	/* If this is the start of a new batch, reset the results. */
+
+	if (queue_head == NULL) {
+		queue_report.written = 0;
+		queue_report.unchanged = 0;
+		queue_report.failed = 0;
+	}
+
+	if (queue_tail != NULL)
+		queue_tail->next = entry;
+	else
+		queue_head = entry;
+
+	queue_tail = entry;
+	queue_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Return the number of writes waiting in the queue.
+ *
+ * \return			The number of writes outstanding.
+ */
+
+size_t queue_get_pending_count(void)
+{
+	return queue_count;
+}
+
+
+/**
+ * Write entries from the queue for one time slice, as a scheduler task.
+ *
+ * \param end_time		The monotonic time by which the slice should end.
+ * \param *data			Unused.
+ * \return			TRUE if there is more to do; FALSE on completion.
+ */
+
+static osbool queue_flush_poll(os_t end_time, void *data)
+{
+	struct queue_entry	*entry;
+
+	while (queue_head != NULL) {
+		entry = queue_head;
+
+		queue_head = entry->next;
+		if (queue_head == NULL)
+			queue_tail = NULL;
+
+		queue_count--;
+
+		queue_write_entry(entry);
+		queue_free_entry(entry);
+
+		if (os_read_monotonic_time() >= end_time)
+			break;
+	}
+
+	if (queue_head != NULL)
+		return TRUE;
+
+	if (queue_complete != NULL)
+		queue_complete(&queue_report);
+
+	return FALSE;
+}
+
+
+/**
+ * Write a queued entry to disc, via a temporary file in the same folder
+ * which is then renamed into place. Any existing file is renamed out of
+ * the way first, and only deleted once the new one is in place, so that
+ * a failure never leaves the target without either copy. Files which
+ * already hold the correct data are left alone.
+ *
+ * \param *entry		The entry to be written.
+ */
+
+static void queue_write_entry(struct queue_entry *entry)
+{
+	char			temp[QUEUE_MAX_FILENAME_LEN], backup[QUEUE_MAX_FILENAME_LEN], *leaf;
+	osbool			replace = FALSE;
+	os_error		*error;
+	fileswitch_object_type	type;
+
+	if (queue_file_unchanged(entry)) {
+		queue_report.unchanged++;
+		return;
+	}
+
+	/* Find the folder holding the target, and build the temporary filename. */
+
+	string_copy(temp, entry->filename, QUEUE_MAX_FILENAME_LEN);
+
+	leaf = strrchr(temp, '.');
+	if (leaf == NULL) {
+		queue_report.failed++;
+		return;
+	}
+
+	string_copy(backup, temp, QUEUE_MAX_FILENAME_LEN);
+
+	string_copy(leaf + 1, QUEUE_TEMP_LEAFNAME, QUEUE_MAX_FILENAME_LEN - (leaf + 1 - temp));
+	string_copy(backup + (leaf + 1 - temp), QUEUE_BACKUP_LEAFNAME, QUEUE_MAX_FILENAME_LEN - (leaf + 1 - temp));
+
+	/* Save the data, then move any existing target out of the way. If
+	 * either step fails, the target is still intact.
+	 */
+
+	error = xosfile_save_stamped(temp, entry->file_type, (byte *) entry->data, (byte *) (entry->data + entry->length));
+
+	if (error == NULL) {
+		error = xosfile_read_no_path(entry->filename, &type, NULL, NULL, NULL, NULL);
+
+		if (error == NULL && type == fileswitch_IS_FILE) {
+			replace = TRUE;
+
+			/* A backup left over while the target exists is stale. */
+
+			xosfile_delete(backup, NULL, NULL, NULL, NULL, NULL);
+			error = xosfscontrol_rename(entry->filename, backup);
+		}
+	}
+
+	if (error != NULL) {
+		xosfile_delete(temp, NULL, NULL, NULL, NULL, NULL);
+		queue_report.failed++;
+		return;
+	}
+
+	/* Move the new file into place. On failure, put the original back and
+	 * leave the new data in the temporary file.
+	 */
+
+	error = xosfscontrol_rename(temp, entry->filename);
+
+	if (error != NULL) {
+		if (replace)
+			xosfscontrol_rename(backup, entry->filename);
+
+		queue_report.failed++;
+		return;
+	}
+
+	if (replace)
+		xosfile_delete(backup, NULL, NULL, NULL, NULL, NULL);
+
+	queue_report.written++;
+}
+
+
+/**
+ * Test whether the file for a queued entry already holds the queued data,
+ * checking the size and type before comparing the bytes.
+ *
+ * \param *entry		The entry to be tested.
+ * \return			TRUE if the file exists and is identical; else FALSE.
+ */
+
+static osbool queue_file_unchanged(struct queue_entry *entry)
+{
+	char			*existing;
+	int			size;
+	bits			file_type;
+	osbool			unchanged;
+	os_error		*error;
+	fileswitch_object_type	type;
+
+	error = xosfile_read_stamped_no_path(entry->filename, &type, NULL, NULL, &size, NULL, &file_type);
+	if (error != NULL || type != fileswitch_IS_FILE || size != entry->length || file_type != entry->file_type)
+		return FALSE;
+
+	existing = malloc(size + 1);
+	if (existing == NULL)
+		return FALSE;
+
+	error = xosfile_load_stamped_no_path(entry->filename, (byte *) existing, NULL, NULL, NULL, NULL, NULL);
+
+	unchanged = (error == NULL && memcmp(existing, entry->data, entry->length) == 0) ? TRUE : FALSE;
+
+	free(existing);
+
+	return unchanged;
+}
+
+
+/**
+ * Free the memory used by a queue entry.
+ *
+ * \param *entry		The entry to be freed.
+ */
+
+static void queue_free_entry(struct queue_entry *entry)
+{
+	if (entry == NULL)
+		return;
+
+	free(entry->filename);
+	free(entry->data);
+	free(entry);
+}
@@ -0,0 +1,87 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: queue.h
+ *
+ * Write-behind queue for snippet files interface.
+ */
+
+#ifndef PS2PAPER_QUEUE
+#define PS2PAPER_QUEUE
+
+#include "oslib/types.h"
+
+/**
+ * The results of flushing a batch of writes from the queue.
+ */
+
+struct queue_report {
+	unsigned		written;			/**< The number of files which were written.			*/
+	unsigned		unchanged;			/**< The number of files which were already up to date.		*/
+	unsigned		failed;				/**< The number of files which could not be written.		*/
+};
+
+/**
+ * A callback to be informed when the queue has been flushed.
+ *
+ * \param *report		The results of the batch of writes.
+ */
+
+typedef void (*queue_callback)(struct queue_report *report);
+
+
+/**
+ * Initialise the write-behind queue.
+ *
+ * \param callback		The function to be called each time that the
+ *				queue has been emptied, or NULL.
+ */
+
+void queue_initialise(queue_callback callback);
+
+
+/**
+ * Add a file write to the queue. If a write to the same file is already
+ * waiting, its contents are replaced by the new data so that only the
+ * most recent version gets written.
+ *
+ * \param *filename		The name of the file to be written.
+ * \param *data			The data to be written to the file.
+ * \param length		The length of the data.
+ * \param file_type		The filetype to be given to the file.
+ * \return			TRUE if the write was queued; else FALSE.
+ */
+
+osbool queue_add_write(char *filename, char *data, int length, bits file_type);
+
+
+/**
+ * Return the number of writes waiting in the queue.
+ *
+ * \return			The number of writes outstanding.
+ */
+
+size_t queue_get_pending_count(void);
+
+#endif
@@ -0,0 +1,183 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: scheduler.c
+ *
+ * Cooperative background task scheduler implementation.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+
+/* OSLib header files */
+
+#include "oslib/os.h"
+
+/* Application header files */
+
+#include "scheduler.h"
+
+/**
+ * The maximum number of tasks which can be scheduled at once.
+ */
+
+#define SCHEDULER_MAX_TASKS 8
+
+/**
+ * The length of time, in centiseconds, that the scheduled tasks can run
+ * for on each Null Event before control is returned to the Wimp.
+ */
+
+#define SCHEDULER_TIME_SLICE 5
+
+/**
+ * A scheduled task.
+ */
+
+struct scheduler_task {
+	scheduler_callback	callback;			/**< The task callback, or NULL if the slot is free.		*/
+	void			*data;				/**< The client data for the callback.				*/
+};
+
+static struct scheduler_task	scheduler_tasks[SCHEDULER_MAX_TASKS];	/**< The scheduled tasks.				*/
+static int			scheduler_task_count = 0;		/**< The number of scheduled tasks.			*/
+static int			scheduler_next_task = 0;		/**< The task to be run first on the next poll.		*/
+
+
+/**
+ * Add a task to the scheduler, to be called on Null Events until it
+ * reports that it has completed. If the task is already registered, it
+ * will not be added a second time.
+ *
+ * \param callback		The task callback function.
+ * \param *data			Client data to be passed to the callback.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool scheduler_add_task(scheduler_callback callback, void *data)
+{
+	int	task, free = -1;
+
+	if (callback == NULL)
+		return FALSE;
+
+	for (task = 0; task < SCHEDULER_MAX_TASKS; task++) {
+		if (scheduler_tasks[task].callback == callback && scheduler_tasks[task].data == data)
+			return TRUE;
+
+		if (free == -1 && scheduler_tasks[task].callback == NULL)
+			free = task;
+	}
+
+	if (free == -1)
+		return FALSE;
+
+	scheduler_tasks[free].callback = callback;
+	scheduler_tasks[free].data = data;
+	scheduler_task_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Remove a task from the scheduler.
+ *
+ * \param callback		The task callback function.
+ * \param *data			The client data supplied when the task was added.
+ */
+
+void scheduler_remove_task(scheduler_callback callback, void *data)
+{
+	int	task;
+
+	for (task = 0; task < SCHEDULER_MAX_TASKS; task++) {
+		if (scheduler_tasks[task].callback == callback && scheduler_tasks[task].data == data) {
+			scheduler_tasks[task].callback = NULL;
+			scheduler_tasks[task].data = NULL;
+			scheduler_task_count--;
+			return;
+		}
+	}
+}
+
+
+/**
+ * Test whether there are any tasks waiting to run, and hence whether the
+ * poll loop needs to request Null Events.
+ *
+ * \return			TRUE if there are tasks scheduled; else FALSE.
+ */
+
+osbool scheduler_tasks_pending(void)
+{
+	return (scheduler_task_count > 0) ? TRUE : FALSE;
+}
+
+
+/**
+ * Run the scheduled tasks for one time slice. This should be called on
+ * receipt of each Null Event from the Wimp.
+ *
+ * The tasks are visited in round-robin order, starting from the one after
+ * the last task to run on the previous poll, so that a single busy task
+ * can not starve the others of time.
+ */
+
+void scheduler_poll(void)
+{
+	int			i, task;
+	os_t			end_time;
+	scheduler_callback	callback;
+	void			*data;
+
+	if (scheduler_task_count == 0)
+		return;
+
+	end_time = os_read_monotonic_time() + SCHEDULER_TIME_SLICE;
+
+	for (i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+		task = (scheduler_next_task + i) % SCHEDULER_MAX_TASKS;
+
+		callback = scheduler_tasks[task].callback;
+		data = scheduler_tasks[task].data;
+
+		if (callback == NULL)
+			continue;
+
+		/* Remove the task if it reports completion. The callback may
+		 * have removed itself in the meantime, so check that the slot
+		 * still holds the same task first.
+		 */
+
+		if (!callback(end_time, data) && scheduler_tasks[task].callback == callback && scheduler_tasks[task].data == data)
+			scheduler_remove_task(callback, data);
+
+		if (os_read_monotonic_time() >= end_time) {
+			scheduler_next_task = (task + 1) % SCHEDULER_MAX_TASKS;
+			return;
+		}
+	}
+}
@@ -0,0 +1,88 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: scheduler.h
+ *
+ * Cooperative background task scheduler interface.
+ */
+
+#ifndef PS2PAPER_SCHEDULER
+#define PS2PAPER_SCHEDULER
+
+#include "oslib/os.h"
+
+/**
+ * A scheduled task callback. The task should carry out as much work as it
+ * can before the end time is reached, and then return.
+ *
+ * \param end_time		The monotonic time by which the task should return.
+ * \param *data			The client data supplied when the task was added.
+ * \return			TRUE if the task has more work to do; FALSE if
+ *				it has completed and should be removed.
+ */
+
+typedef osbool (*scheduler_callback)(os_t end_time, void *data);
+
+
+/**
+ * Add a task to the scheduler, to be called on Null Events until it
+ * reports that it has completed. If the task is already registered, it
+ * will not be added a second time.
+ *
+ * \param callback		The task callback function.
+ * \param *data			Client data to be passed to the callback.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool scheduler_add_task(scheduler_callback callback, void *data);
+
+
+/**
+ * Remove a task from the scheduler.
+ *
+ * \param callback		The task callback function.
+ * \param *data			The client data supplied when the task was added.
+ */
+
+void scheduler_remove_task(scheduler_callback callback, void *data);
+
+
+/**
+ * Test whether there are any tasks waiting to run, and hence whether the
+ * poll loop needs to request Null Events.
+ *
+ * \return			TRUE if there are tasks scheduled; else FALSE.
+ */
+
+osbool scheduler_tasks_pending(void);
+
+
+/**
+ * Run the scheduled tasks for one time slice. This should be called on
+ * receipt of each Null Event from the Wimp.
+ */
+
+void scheduler_poll(void);
+
+#endif
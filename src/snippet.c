@@ -0,0 +1,583 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: snippet.c
+ *
+ * Snippet template engine implementation.
+ *
+ * Each snippet format is described by a template, in which fields from the
+ * paper definition are given by their names in braces -- {name}, {file},
+ * {width}, {height} and {orientation}. The templates are compiled once, on
+ * initialisation, into a list of literal and field pieces; rendering a
+ * snippet is then just a walk through the pieces.
+ */
+
+/* ANSI C header files */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/* OSLib header files */
+
+#include "oslib/osfile.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/errors.h"
+
+/* Application header files */
+
+#include "snippet.h"
+
+#include "paper.h"
+
+/**
+ * The maximum number of pieces in a compiled template.
+ */
+
+#define SNIPPET_MAX_PIECES 24
+
+/**
+ * The maximum length of a rendered dimension: ten digits for a 32-bit
+ * value, plus the decimal point.
+ */
+
+#define SNIPPET_POINTS_LEN 11
+
+/**
+ * The size of the output buffer used when streaming snippets to a file.
+ */
+
+#define SNIPPET_OUTPUT_BUFFER_LEN 16384
+
+/**
+ * The template used to head each definition in a catalogue file.
+ */
+
+#define SNIPPET_TEMPLATE_HEADER SNIPPET_FORMAT_COUNT
+
+/**
+ * The number of sections in a PPD file: *PageSize, *PageRegion,
+ * *ImageableArea and *PaperDimension.
+ */
+
+#define SNIPPET_PPD_SECTIONS 4
+
+/**
+ * The templates used to write PPD files: an entry for each definition in
+ * each section, plus a head and tail for each section.
+ */
+
+#define SNIPPET_TEMPLATE_PPD_ENTRY (SNIPPET_TEMPLATE_HEADER + 1)
+#define SNIPPET_TEMPLATE_PPD_HEAD (SNIPPET_TEMPLATE_PPD_ENTRY + SNIPPET_PPD_SECTIONS)
+#define SNIPPET_TEMPLATE_PPD_TAIL (SNIPPET_TEMPLATE_PPD_HEAD + SNIPPET_PPD_SECTIONS)
+
+/**
+ * The fields which can be inserted into a template.
+ */
+
+enum snippet_field {
+	SNIPPET_FIELD_NONE,					/**< The piece is a literal.					*/
+	SNIPPET_FIELD_NAME,					/**< The paper name.						*/
+	SNIPPET_FIELD_FILE,					/**< The PS2 snippet filename.					*/
+	SNIPPET_FIELD_WIDTH,					/**< The paper width, in points.				*/
+	SNIPPET_FIELD_HEIGHT,					/**< The paper height, in points.				*/
+	SNIPPET_FIELD_ORIENTATION				/**< The PostScript orientation of the paper.			*/
+};
+
+/**
+ * A field name which can appear in a template.
+ */
+
+struct snippet_field_name {
+	char			*name;				/**< The name of the field, as it appears in braces.		*/
+	enum snippet_field	field;				/**< The field that the name refers to.				*/
+};
+
+/**
+ * A piece of a compiled template.
+ */
+
+struct snippet_piece {
+	enum snippet_field	field;				/**< The field to insert, or SNIPPET_FIELD_NONE for a literal.	*/
+	char			*text;				/**< Pointer to the literal text in the template source.	*/
+	size_t			length;				/**< The length of the literal text.				*/
+};
+
+/**
+ * A snippet template.
+ */
+
+struct snippet_template {
+	char			*source;			/**< The template source text.					*/
+	int			piece_count;			/**< The number of compiled pieces.				*/
+	struct snippet_piece	pieces[SNIPPET_MAX_PIECES];	/**< The compiled pieces.					*/
+};
+
+/**
+ * The field names which are recognised in templates.
+ */
+
+static struct snippet_field_name snippet_field_names[] = {
+	{"name", SNIPPET_FIELD_NAME},
+	{"file", SNIPPET_FIELD_FILE},
+	{"width", SNIPPET_FIELD_WIDTH},
+	{"height", SNIPPET_FIELD_HEIGHT},
+	{"orientation", SNIPPET_FIELD_ORIENTATION}
+};
+
+#define SNIPPET_FIELD_NAME_COUNT (sizeof(snippet_field_names) / sizeof(struct snippet_field_name))
+
+/**
+ * The initial state of a template's compiled pieces, which are filled in
+ * by snippet_compile().
+ */
+
+#define SNIPPET_UNCOMPILED 0, {{SNIPPET_FIELD_NONE, NULL, 0}}
+
+/**
+ * The snippet templates, in snippet_format order, followed by the
+ * catalogue header and then the PPD entries, heads and tails.
+ */
+
+static struct snippet_template snippet_templates[] = {
+	{	"% Created by PS2Paper\n"
+		"%%BeginFeature: PageSize {name}\n"
+		"<< /PageSize [ {width} {height} ] >> setpagedevice\n"
+		"%%EndFeature\n", SNIPPET_UNCOMPILED	},
+	{	"%%BeginFeature: ImagingBBox {name}\n"
+		"<< /ImagingBBox [ 0 0 {width} {height} ] >> setpagedevice\n"
+		"%%EndFeature\n", SNIPPET_UNCOMPILED	},
+	{	"%%BeginFeature: Orientation {name}\n"
+		"<< /Orientation {orientation} >> setpagedevice\n"
+		"%%EndFeature\n", SNIPPET_UNCOMPILED	},
+	{	"%%BeginFeature: *PageSize {file}\n"
+		"<< /PageSize [ {width} {height} ] /ImagingBBox null >> setpagedevice\n"
+		"%%EndFeature\n", SNIPPET_UNCOMPILED	},
+	{	"/MediaBox [ 0 0 {width} {height} ]\n", SNIPPET_UNCOMPILED	},
+	{	"\n% {name} ({file})\n\n", SNIPPET_UNCOMPILED	},
+	{	"*PageSize {file}/{name}: \"<</PageSize[{width} {height}]/ImagingBBox null>>setpagedevice\"\n", SNIPPET_UNCOMPILED	},
+	{	"*PageRegion {file}/{name}: \"<</PageSize[{width} {height}]/ImagingBBox null>>setpagedevice\"\n", SNIPPET_UNCOMPILED	},
+	{	"*ImageableArea {file}/{name}: \"0 0 {width} {height}\"\n", SNIPPET_UNCOMPILED	},
+	{	"*PaperDimension {file}/{name}: \"{width} {height}\"\n", SNIPPET_UNCOMPILED	},
+	{	"*% Created by PS2Paper\n\n"
+		"*OpenUI *PageSize/Media Size: PickOne\n"
+		"*OrderDependency: 10 AnySetup *PageSize\n"
+		"*DefaultPageSize: {file}\n", SNIPPET_UNCOMPILED	},
+	{	"*OpenUI *PageRegion: PickOne\n"
+		"*OrderDependency: 10 AnySetup *PageRegion\n"
+		"*DefaultPageRegion: {file}\n", SNIPPET_UNCOMPILED	},
+	{	"*DefaultImageableArea: {file}\n", SNIPPET_UNCOMPILED	},
+	{	"*DefaultPaperDimension: {file}\n", SNIPPET_UNCOMPILED	},
+	{	"*CloseUI: *PageSize\n\n", SNIPPET_UNCOMPILED	},
+	{	"*CloseUI: *PageRegion\n\n", SNIPPET_UNCOMPILED	},
+	{	"\n", SNIPPET_UNCOMPILED	},
+	{	"", SNIPPET_UNCOMPILED	}
+};
+
+#define SNIPPET_TEMPLATE_COUNT (sizeof(snippet_templates) / sizeof(struct snippet_template))
+
+static void	snippet_compile(struct snippet_template *template);
+static size_t	snippet_render_template(struct snippet_template *template, struct paper_size *paper, char *buffer);
+static size_t	snippet_render_points(unsigned millipoints, char *buffer);
+static osbool	snippet_stream_template(FILE *out, char *buffer, size_t *used, struct snippet_template *template, struct paper_size *paper);
+
+
+/**
+ * Initialise the snippet templates, compiling them ready for use.
+ */
+
+void snippet_initialise(void)
+{
+	int	template;
+
+	for (template = 0; template < SNIPPET_TEMPLATE_COUNT; template++)
+		snippet_compile(snippet_templates + template);
+}
+
+
+/**
+ * Render a snippet for a paper definition into a buffer.
+ *
+ * \param format		The snippet format to render.
+ * \param *paper		The paper definition to render.
+ * \param *buffer		Pointer to the buffer to take the snippet.
+ * \param length		The length of the buffer.
+ * \return			The length of the snippet, or -1 on failure.
+ */
+
+int snippet_render(enum snippet_format format, struct paper_size *paper, char *buffer, size_t length)
+{
+	size_t	size;
+
+	if (format < 0 || format >= SNIPPET_FORMAT_COUNT || paper == NULL || buffer == NULL || length < SNIPPET_MAX_LEN)
+		return -1;
+
+	size = snippet_render_template(snippet_templates + format, paper, buffer);
+	buffer[size] = '\0';
+
+	return size;
+}
+
+
+/**
+ * Render snippets in one or more formats for every paper definition in
+ * the catalogue, streaming them into a single text file.
+ *
+ * \param *filename		The name of the file to be written.
+ * \param formats		The snippet formats to include, as flags.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool snippet_write_catalogue(char *filename, unsigned formats)
+{
+	FILE			*out;
+	char			*buffer;
+	size_t			used, paper_count, paper;
+	int			format;
+	osbool			success = TRUE;
+	struct paper_size	*papers;
+
+	buffer = malloc(SNIPPET_OUTPUT_BUFFER_LEN);
+	if (buffer == NULL)
+		return FALSE;
+
+	out = fopen(filename, "w");
+	if (out == NULL) {
+		free(buffer);
+		return FALSE;
+	}
+
+	used = 0;
+
+	/* The definitions are in a flex block, but nothing in the sweep can
+	 * cause the heap to shift.
+	 */
+
+	paper_count = paper_get_definition_count();
+	papers = paper_get_definitions();
+
+	for (paper = 0; paper < paper_count && success; paper++) {
+		for (format = -1; format < SNIPPET_FORMAT_COUNT && success; format++) {
+			if (format >= 0 && !(formats & SNIPPET_FORMAT_FLAG(format)))
+				continue;
+
+			/* Each definition is headed by a comment before its snippets. */
+
+			success = snippet_stream_template(out, buffer, &used,
+					snippet_templates + ((format >= 0) ? format : SNIPPET_TEMPLATE_HEADER), papers + paper);
+		}
+	}
+
+	if (success && used > 0 && fwrite(buffer, 1, used, out) != used)
+		success = FALSE;
+
+	if (fclose(out) != 0)
+		success = FALSE;
+
+	free(buffer);
+
+	osfile_set_type(filename, osfile_TYPE_TEXT);
+
+	return success;
+}
+
+
+/**
+ * Write the *PageSize, *PageRegion, *ImageableArea and *PaperDimension
+ * entries for the paper definitions in the catalogue out to a PPD file
+ * fragment, with one entry per snippet filename.
+ *
+ * \param *filename		The name of the file to be written.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool snippet_write_ppd(char *filename)
+{
+	FILE			*out;
+	char			*buffer;
+	size_t			*unique, unique_count, used, paper_count, paper, i;
+	int			section;
+	osbool			success = TRUE;
+	struct paper_size	*papers;
+
+	paper_count = paper_get_definition_count();
+
+	buffer = malloc(SNIPPET_OUTPUT_BUFFER_LEN);
+	unique = malloc(((paper_count > 0) ? paper_count : 1) * sizeof(size_t));
+
+	if (buffer == NULL || unique == NULL) {
+		free(buffer);
+		free(unique);
+		return FALSE;
+	}
+
+	/* Make a single pass through the catalogue, using the filename index
+	 * to pick out the first definition to use each snippet filename.
+	 */
+
+	unique_count = 0;
+
+	for (paper = 0; paper < paper_count; paper++) {
+		if (paper_is_first_file_use(paper))
+			unique[unique_count++] = paper;
+	}
+
+	out = fopen(filename, "w");
+	if (out == NULL) {
+		free(buffer);
+		free(unique);
+		return FALSE;
+	}
+
+	used = 0;
+
+	/* The definitions are in a flex block, but nothing in the sweep can
+	 * cause the heap to shift. The first definition is the default.
+	 */
+
+	papers = paper_get_definitions();
+
+	for (section = 0; section < SNIPPET_PPD_SECTIONS && unique_count > 0 && success; section++) {
+		success = snippet_stream_template(out, buffer, &used,
+				snippet_templates + SNIPPET_TEMPLATE_PPD_HEAD + section, papers + unique[0]);
+
+		for (i = 0; i < unique_count && success; i++)
+			success = snippet_stream_template(out, buffer, &used,
+					snippet_templates + SNIPPET_TEMPLATE_PPD_ENTRY + section, papers + unique[i]);
+
+		if (success)
+			success = snippet_stream_template(out, buffer, &used,
+					snippet_templates + SNIPPET_TEMPLATE_PPD_TAIL + section, papers + unique[0]);
+	}
+
+	if (success && used > 0 && fwrite(buffer, 1, used, out) != used)
+		success = FALSE;
+
+	if (fclose(out) != 0)
+		success = FALSE;
+
+	free(buffer);
+	free(unique);
+
+	osfile_set_type(filename, osfile_TYPE_TEXT);
+
+	return success;
+}
+
+
+/**
+ * Compile a template from its source text into a list of literal and
+ * field pieces.
+ *
+ * \param *template		The template to be compiled.
+ */
+
+static void snippet_compile(struct snippet_template *template)
+{
+	char	*text, *start, *end;
+	int	field;
+
+	template->piece_count = 0;
+
+	text = template->source;
+	start = text;
+
+	while (*text != '\0' && template->piece_count < SNIPPET_MAX_PIECES - 1) {
+		if (*text != '{') {
+			text++;
+			continue;
+		}
+
+		/* Look for a recognised field name up to the closing brace. */
+
+		end = strchr(text, '}');
+		if (end == NULL)
+			break;
+
+		for (field = 0; field < SNIPPET_FIELD_NAME_COUNT; field++) {
+			if (strlen(snippet_field_names[field].name) == (end - text - 1) &&
+					strncmp(snippet_field_names[field].name, text + 1, end - text - 1) == 0)
+				break;
+		}
+
+		if (field >= SNIPPET_FIELD_NAME_COUNT) {
+			text++;
+			continue;
+		}
+
+		/* Add any literal text before the field, and then the field itself. */
+
+		if (text > start) {
+			template->pieces[template->piece_count].field = SNIPPET_FIELD_NONE;
+			template->pieces[template->piece_count].text = start;
+			template->pieces[template->piece_count].length = text - start;
+			template->piece_count++;
+		}
+
+		template->pieces[template->piece_count].field = snippet_field_names[field].field;
+		template->pieces[template->piece_count].text = NULL;
+		template->pieces[template->piece_count].length = 0;
+		template->piece_count++;
+
+		text = end + 1;
+		start = text;
+	}
+
+	/* Add whatever remains as a final literal. */
+
+	if (*start != '\0' && template->piece_count < SNIPPET_MAX_PIECES) {
+		template->pieces[template->piece_count].field = SNIPPET_FIELD_NONE;
+		template->pieces[template->piece_count].text = start;
+		template->pieces[template->piece_count].length = strlen(start);
+		template->piece_count++;
+	}
+}
+
+
+/**
+ * Render a compiled template for a paper definition. The buffer must have
+ * at least SNIPPET_MAX_LEN bytes free; the output is not terminated.
+ *
+ * \param *template		The template to be rendered.
+ * \param *paper		The paper definition to render.
+ * \param *buffer		Pointer to the buffer to take the output.
+ * \return			The number of bytes written to the buffer.
+ */
+
+static size_t snippet_render_template(struct snippet_template *template, struct paper_size *paper, char *buffer)
+{
+	int			piece;
+	size_t			used = 0, length;
+	char			*text;
+	struct snippet_piece	*current;
+
+	for (piece = 0; piece < template->piece_count; piece++) {
+		current = template->pieces + piece;
+
+		switch (current->field) {
+		case SNIPPET_FIELD_NONE:
+			text = current->text;
+			length = current->length;
+			break;
+		case SNIPPET_FIELD_NAME:
+			text = paper->name;
+			length = strlen(text);
+			break;
+		case SNIPPET_FIELD_FILE:
+			text = paper->ps2_file;
+			length = strlen(text);
+			break;
+		case SNIPPET_FIELD_WIDTH:
+			if (used + SNIPPET_POINTS_LEN < SNIPPET_MAX_LEN)
+				used += snippet_render_points(paper->width, buffer + used);
+			continue;
+		case SNIPPET_FIELD_HEIGHT:
+			if (used + SNIPPET_POINTS_LEN < SNIPPET_MAX_LEN)
+				used += snippet_render_points(paper->height, buffer + used);
+			continue;
+		case SNIPPET_FIELD_ORIENTATION:
+			text = (paper->width > paper->height) ? "1" : "0";
+			length = 1;
+			break;
+		default:
+			continue;
+		}
+
+		if (used >= SNIPPET_MAX_LEN - 1)
+			length = 0;
+		else if (used + length >= SNIPPET_MAX_LEN)
+			length = SNIPPET_MAX_LEN - used - 1;
+
+		memcpy(buffer + used, text, length);
+		used += length;
+	}
+
+	return used;
+}
+
+
+/**
+ * Render a dimension in millipoints as a decimal number of points, to
+ * three decimal places.
+ *
+ * \param millipoints		The dimension to render.
+ * \param *buffer		Pointer to the buffer to take the output.
+ * \return			The number of bytes written to the buffer.
+ */
+
+static size_t snippet_render_points(unsigned millipoints, char *buffer)
+{
+	char	digits[16];
+	size_t	count = 0, used = 0;
+
+	/* Build the digits in reverse, padding to at least four so that
+	 * there's always a units digit ahead of the decimal point.
+	 */
+
+	do {
+		digits[count++] = '0' + (millipoints % 10);
+		millipoints /= 10;
+	} while (millipoints > 0 || count < 4);
+
+	while (count > 3)
+		buffer[used++] = digits[--count];
+
+	buffer[used++] = '.';
+
+	while (count > 0)
+		buffer[used++] = digits[--count];
+
+	return used;
+}
+
+
+/**
+ * Render a compiled template for a paper definition into an output buffer,
+ * first flushing the buffer to a file if there might not be room.
+ *
+ * \param *out			The file to flush the buffer to.
+ * \param *buffer		Pointer to the output buffer.
+ * \param *used			Pointer to the number of bytes used in the buffer,
+ *				to be updated.
+ * \param *template		The template to be rendered.
+ * \param *paper		The paper definition to render.
+ * \return			TRUE if successful; FALSE if the flush failed.
+ */
+
+static osbool snippet_stream_template(FILE *out, char *buffer, size_t *used, struct snippet_template *template, struct paper_size *paper)
+{
+	if (SNIPPET_OUTPUT_BUFFER_LEN - *used < SNIPPET_MAX_LEN) {
+		if (fwrite(buffer, 1, *used, out) != *used)
+			return FALSE;
+
+		*used = 0;
+	}
+
+	*used += snippet_render_template(template, paper, buffer + *used);
+
+	return TRUE;
+}
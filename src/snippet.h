@@ -0,0 +1,107 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: snippet.h
+ *
+ * Snippet template engine interface.
+ */
+
+#ifndef PS2PAPER_SNIPPET
+#define PS2PAPER_SNIPPET
+
+#include "oslib/types.h"
+
+#include "paper.h"
+
+/**
+ * The maximum size of a single rendered snippet.
+ */
+
+#define SNIPPET_MAX_LEN 1024
+
+/**
+ * The snippet formats which can be generated.
+ */
+
+enum snippet_format {
+	SNIPPET_FORMAT_PAGESIZE = 0,				/**< The Level 2 driver PageSize snippet.			*/
+	SNIPPET_FORMAT_IMAGING_BBOX,				/**< An ImagingBBox page device snippet.			*/
+	SNIPPET_FORMAT_ORIENTATION,				/**< An Orientation page device hint.				*/
+	SNIPPET_FORMAT_LEVEL3,					/**< A Level 3 driver PageSize snippet.				*/
+	SNIPPET_FORMAT_MEDIABOX,				/**< A PDF MediaBox fragment.					*/
+	SNIPPET_FORMAT_COUNT					/**< The number of snippet formats; not a format itself.	*/
+};
+
+/**
+ * Flags to select snippet formats in batch operations.
+ */
+
+#define SNIPPET_FORMAT_FLAG(format) (1u << (format))
+#define SNIPPET_FORMAT_FLAGS_ALL ((1u << SNIPPET_FORMAT_COUNT) - 1u)
+
+
+/**
+ * Initialise the snippet templates, compiling them ready for use.
+ */
+
+void snippet_initialise(void);
+
+
+/**
+ * Render a snippet for a paper definition into a buffer.
+ *
+ * \param format		The snippet format to render.
+ * \param *paper		The paper definition to render.
+ * \param *buffer		Pointer to the buffer to take the snippet.
+ * \param length		The length of the buffer.
+ * \return			The length of the snippet, or -1 on failure.
+ */
+
+int snippet_render(enum snippet_format format, struct paper_size *paper, char *buffer, size_t length);
+
+
+/**
+ * Render snippets in one or more formats for every paper definition in
+ * the catalogue, streaming them into a single text file.
+ *
+ * \param *filename		The name of the file to be written.
+ * \param formats		The snippet formats to include, as flags.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool snippet_write_catalogue(char *filename, unsigned formats);
+
+
+/**
+ * Write the *PageSize, *PageRegion, *ImageableArea and *PaperDimension
+ * entries for the paper definitions in the catalogue out to a PPD file
+ * fragment, with one entry per snippet filename.
+ *
+ * \param *filename		The name of the file to be written.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool snippet_write_ppd(char *filename);
+
+#endif
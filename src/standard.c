@@ -0,0 +1,364 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: standard.c
+ *
+ * Standard paper size reference table implementation.
+ *
+ * The table holds the ISO A, B and C series, the JIS B series and the
+ * common US and ANSI sizes, sorted by their short and then their long
+ * sides. Names are looked up through a perfect hash of their normalised
+ * form, and dimensions by a binary search of the sorted table.
+ */
+
+/* ANSI C header files */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Application header files */
+
+#include "standard.h"
+
+/**
+ * Convert millimetres and inches into millipoints.
+ */
+
+#define STANDARD_MM(x) ((int) ((x) * 2834.6457 + 0.5))
+#define STANDARD_INCH(x) ((int) ((x) * 72000 + 0.5))
+
+/**
+ * The difference, in millipoints, within which dimensions are taken to
+ * match a standard size. This allows for rounding to the nearest point.
+ */
+
+#define STANDARD_TOLERANCE 500
+
+/**
+ * The maximum length of a normalised name.
+ */
+
+#define STANDARD_KEY_LEN 32
+
+/**
+ * The size of the perfect hash table, which must be a power of two, and
+ * the seed which gives a collision-free hash for the names in the table.
+ */
+
+#define STANDARD_HASH_SIZE 256
+#define STANDARD_HASH_SEED 26
+
+/**
+ * A standard paper size.
+ */
+
+struct standard_size {
+	char			*name;				/**< The display name of the size.				*/
+	char			*key;				/**< The normalised name of the size.				*/
+	int			short_side;			/**< The length of the short side, in millipoints.		*/
+	int			long_side;			/**< The length of the long side, in millipoints.		*/
+};
+
+/**
+ * The standard sizes, sorted by short and then long side. Where two sizes
+ * share dimensions, the first is reported when matching on size alone.
+ */
+
+static struct standard_size standard_sizes[] = {
+	{"ISO A10", "a10", STANDARD_MM(26), STANDARD_MM(37)},
+	{"ISO C10", "c10", STANDARD_MM(28), STANDARD_MM(40)},
+	{"ISO B10", "b10", STANDARD_MM(31), STANDARD_MM(44)},
+	{"JIS B10", "jisb10", STANDARD_MM(32), STANDARD_MM(45)},
+	{"ISO A9", "a9", STANDARD_MM(37), STANDARD_MM(52)},
+	{"ISO C9", "c9", STANDARD_MM(40), STANDARD_MM(57)},
+	{"ISO B9", "b9", STANDARD_MM(44), STANDARD_MM(62)},
+	{"JIS B9", "jisb9", STANDARD_MM(45), STANDARD_MM(64)},
+	{"ISO A8", "a8", STANDARD_MM(52), STANDARD_MM(74)},
+	{"ISO C8", "c8", STANDARD_MM(57), STANDARD_MM(81)},
+	{"ISO B8", "b8", STANDARD_MM(62), STANDARD_MM(88)},
+	{"JIS B8", "jisb8", STANDARD_MM(64), STANDARD_MM(91)},
+	{"ISO A7", "a7", STANDARD_MM(74), STANDARD_MM(105)},
+	{"ISO C7", "c7", STANDARD_MM(81), STANDARD_MM(114)},
+	{"ISO B7", "b7", STANDARD_MM(88), STANDARD_MM(125)},
+	{"JIS B7", "jisb7", STANDARD_MM(91), STANDARD_MM(128)},
+	{"ISO A6", "a6", STANDARD_MM(105), STANDARD_MM(148)},
+	{"ISO DL", "dl", STANDARD_MM(110), STANDARD_MM(220)},
+	{"ISO C6", "c6", STANDARD_MM(114), STANDARD_MM(162)},
+	{"ISO B6", "b6", STANDARD_MM(125), STANDARD_MM(176)},
+	{"US Junior Legal", "juniorlegal", STANDARD_INCH(5), STANDARD_INCH(8)},
+	{"JIS B6", "jisb6", STANDARD_MM(128), STANDARD_MM(182)},
+	{"US Statement", "statement", STANDARD_INCH(5.5), STANDARD_INCH(8.5)},
+	{"US Half Letter", "halfletter", STANDARD_INCH(5.5), STANDARD_INCH(8.5)},
+	{"ISO A5", "a5", STANDARD_MM(148), STANDARD_MM(210)},
+	{"ISO C5", "c5", STANDARD_MM(162), STANDARD_MM(229)},
+	{"ISO B5", "b5", STANDARD_MM(176), STANDARD_MM(250)},
+	{"JIS B5", "jisb5", STANDARD_MM(182), STANDARD_MM(257)},
+	{"US Executive", "executive", STANDARD_INCH(7.25), STANDARD_INCH(10.5)},
+	{"ISO A4", "a4", STANDARD_MM(210), STANDARD_MM(297)},
+	{"US Letter", "letter", STANDARD_INCH(8.5), STANDARD_INCH(11)},
+	{"ANSI A", "ansia", STANDARD_INCH(8.5), STANDARD_INCH(11)},
+	{"US Folio", "folio", STANDARD_INCH(8.5), STANDARD_INCH(13)},
+	{"US Legal", "legal", STANDARD_INCH(8.5), STANDARD_INCH(14)},
+	{"ISO C4", "c4", STANDARD_MM(229), STANDARD_MM(324)},
+	{"ISO B4", "b4", STANDARD_MM(250), STANDARD_MM(353)},
+	{"JIS B4", "jisb4", STANDARD_MM(257), STANDARD_MM(364)},
+	{"US Tabloid", "tabloid", STANDARD_INCH(11), STANDARD_INCH(17)},
+	{"US Ledger", "ledger", STANDARD_INCH(11), STANDARD_INCH(17)},
+	{"ANSI B", "ansib", STANDARD_INCH(11), STANDARD_INCH(17)},
+	{"ISO A3", "a3", STANDARD_MM(297), STANDARD_MM(420)},
+	{"ISO C3", "c3", STANDARD_MM(324), STANDARD_MM(458)},
+	{"ISO B3", "b3", STANDARD_MM(353), STANDARD_MM(500)},
+	{"JIS B3", "jisb3", STANDARD_MM(364), STANDARD_MM(515)},
+	{"ISO A2", "a2", STANDARD_MM(420), STANDARD_MM(594)},
+	{"ANSI C", "ansic", STANDARD_INCH(17), STANDARD_INCH(22)},
+	{"ISO C2", "c2", STANDARD_MM(458), STANDARD_MM(648)},
+	{"ISO B2", "b2", STANDARD_MM(500), STANDARD_MM(707)},
+	{"JIS B2", "jisb2", STANDARD_MM(515), STANDARD_MM(728)},
+	{"ANSI D", "ansid", STANDARD_INCH(22), STANDARD_INCH(34)},
+	{"ISO A1", "a1", STANDARD_MM(594), STANDARD_MM(841)},
+	{"ISO C1", "c1", STANDARD_MM(648), STANDARD_MM(917)},
+	{"ISO B1", "b1", STANDARD_MM(707), STANDARD_MM(1000)},
+	{"JIS B1", "jisb1", STANDARD_MM(728), STANDARD_MM(1030)},
+	{"ISO A0", "a0", STANDARD_MM(841), STANDARD_MM(1189)},
+	{"ANSI E", "ansie", STANDARD_INCH(34), STANDARD_INCH(44)},
+	{"ISO C0", "c0", STANDARD_MM(917), STANDARD_MM(1297)},
+	{"ISO B0", "b0", STANDARD_MM(1000), STANDARD_MM(1414)},
+	{"JIS B0", "jisb0", STANDARD_MM(1030), STANDARD_MM(1456)},
+};
+
+#define STANDARD_SIZE_COUNT ((int) (sizeof(standard_sizes) / sizeof(struct standard_size)))
+
+/**
+ * The perfect hash table, mapping the hash of each normalised name to its
+ * index in the standard_sizes table, or -1 if the slot is empty. The table
+ * and seed were generated together, and must be regenerated if the list of
+ * sizes changes: run tools/stdhash.pl from the root of the source tree, and
+ * paste its output over STANDARD_HASH_SEED and this table.
+ */
+
+static signed char standard_hash_table[STANDARD_HASH_SIZE] = {
+	10, 6, 2, -1, -1, -1, -1, -1, 57, 52, 47, 42, 35, 26, 19, 14,
+	-1, -1, -1, -1, -1, -1, -1, 28, -1, -1, -1, -1, -1, -1, 38, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 3, -1, -1, 37, -1, -1,
+	-1, -1, -1, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	32, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	5, 9, -1, -1, -1, -1, -1, -1, 51, 56, 41, 46, 25, 34, 13, 18,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 31, 39, 45, 49, 55, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, 17, -1, 7, 11, -1, -1, 27, 36, 15, 21, 53, 58, 43, 48,
+	-1, 20, 4, 8, -1, 23, -1, -1, 40, 44, 50, 54, 12, 16, 24, 29,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 33, -1, -1, -1,
+	-1, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 30, -1, -1, -1,
+	-1, -1, 22, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/**
+ * The prefixes which are dropped from the front of names before lookup.
+ */
+
+static char *standard_prefixes[] = {"iso", "din", "us"};
+
+#define STANDARD_PREFIX_COUNT (sizeof(standard_prefixes) / sizeof(char *))
+
+static int		standard_find_name(char *name);
+static int		standard_find_size(int short_side, int long_side);
+static unsigned		standard_hash(char *key);
+
+
+/**
+ * Classify a paper definition against the table of standard sizes, first
+ * by its name and then by its dimensions. Orientation is ignored.
+ *
+ * \param *name			The name of the paper.
+ * \param width			The width of the paper, in millipoints.
+ * \param height		The height of the paper, in millipoints.
+ * \param *standard		Pointer to a variable to take the index of the
+ *				related standard size, or STANDARD_NONE.
+ * \param *error		Pointer to a variable to take the largest
+ *				difference from the standard, in millipoints.
+ * \return			The relationship to the standard size.
+ */
+
+enum standard_match standard_classify(char *name, int width, int height, int *standard, int *error)
+{
+	int	short_side, long_side, index, short_error, long_error;
+
+	short_side = (width < height) ? width : height;
+	long_side = (width < height) ? height : width;
+
+	*standard = STANDARD_NONE;
+	*error = 0;
+
+	/* If the name is a standard one, report how far out the size is. */
+
+	index = standard_find_name(name);
+
+	if (index != STANDARD_NONE) {
+		short_error = abs(short_side - standard_sizes[index].short_side);
+		long_error = abs(long_side - standard_sizes[index].long_side);
+
+		*standard = index;
+		*error = (short_error > long_error) ? short_error : long_error;
+
+		return (*error <= STANDARD_TOLERANCE) ? STANDARD_MATCH_EXACT : STANDARD_MATCH_NAME;
+	}
+
+	/* Otherwise, see if the size is a standard one. */
+
+	index = standard_find_size(short_side, long_side);
+
+	if (index != STANDARD_NONE) {
+		*standard = index;
+		return STANDARD_MATCH_SIZE;
+	}
+
+	return STANDARD_MATCH_NONE;
+}
+
+
+/**
+ * Return the display name of a standard size.
+ *
+ * \param standard		The index of the standard size.
+ * \return			Pointer to the name, or "" if the index is invalid.
+ */
+
+char *standard_get_name(int standard)
+{
+	if (standard < 0 || standard >= STANDARD_SIZE_COUNT)
+		return "";
+
+	return standard_sizes[standard].name;
+}
+
+
+/**
+ * Find a standard size by name. The name is normalised by dropping all
+ * but letters and digits, and any recognised prefix, before lookup.
+ *
+ * \param *name			The name to look up.
+ * \return			The index of the standard size, or STANDARD_NONE.
+ */
+
+static int standard_find_name(char *name)
+{
+	char	key[STANDARD_KEY_LEN], *start;
+	size_t	length = 0, prefix;
+	int	index;
+
+	if (name == NULL)
+		return STANDARD_NONE;
+
+	for (; *name != '\0'; name++) {
+		if (!isalnum((unsigned char) *name))
+			continue;
+
+		if (length >= STANDARD_KEY_LEN - 1)
+			return STANDARD_NONE;
+
+		key[length++] = tolower((unsigned char) *name);
+	}
+
+	key[length] = '\0';
+
+	start = key;
+
+	for (prefix = 0; prefix < STANDARD_PREFIX_COUNT; prefix++) {
+		if (strncmp(key, standard_prefixes[prefix], strlen(standard_prefixes[prefix])) == 0 &&
+				key[strlen(standard_prefixes[prefix])] != '\0') {
+			start = key + strlen(standard_prefixes[prefix]);
+			break;
+		}
+	}
+
+	/* The hash is perfect, so there's only one slot to check. */
+
+	index = standard_hash_table[standard_hash(start) & (STANDARD_HASH_SIZE - 1)];
+
+	if (index < 0 || strcmp(standard_sizes[index].key, start) != 0)
+		return STANDARD_NONE;
+
+	return index;
+}
+
+
+/**
+ * Find a standard size by its dimensions, using a binary search of the
+ * sorted table.
+ *
+ * \param short_side		The length of the short side, in millipoints.
+ * \param long_side		The length of the long side, in millipoints.
+ * \return			The index of the standard size, or STANDARD_NONE.
+ */
+
+static int standard_find_size(int short_side, int long_side)
+{
+	int	low, high, middle;
+
+	/* Find the first size whose short side is within tolerance. */
+
+	low = 0;
+	high = STANDARD_SIZE_COUNT;
+
+	while (low < high) {
+		middle = (low + high) / 2;
+
+		if (standard_sizes[middle].short_side < short_side - STANDARD_TOLERANCE)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	/* Check the sizes with a matching short side for a long side match. */
+
+	for (; low < STANDARD_SIZE_COUNT && standard_sizes[low].short_side <= short_side + STANDARD_TOLERANCE; low++) {
+		if (abs(standard_sizes[low].long_side - long_side) <= STANDARD_TOLERANCE)
+			return low;
+	}
+
+	return STANDARD_NONE;
+}
+
+
+/**
+ * Calculate the hash of a normalised name, for the perfect hash table.
+ *
+ * \param *key			The normalised name to hash.
+ * \return			The hash value.
+ */
+
+static unsigned standard_hash(char *key)
+{
+	unsigned	hash = STANDARD_HASH_SEED;
+
+	while (*key != '\0')
+		hash = (hash * 33) ^ (unsigned char) *key++;
+
+	return hash ^ (hash >> 15);
+}
@@ -0,0 +1,78 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: standard.h
+ *
+ * Standard paper size reference table interface.
+ */
+
+#ifndef PS2PAPER_STANDARD
+#define PS2PAPER_STANDARD
+
+/**
+ * The ways in which a paper definition can relate to a standard size.
+ */
+
+enum standard_match {
+	STANDARD_MATCH_NONE = 0,				/**< The definition isn't related to a standard size.		*/
+	STANDARD_MATCH_EXACT,					/**< The name and dimensions both match a standard size.	*/
+	STANDARD_MATCH_NAME,					/**< The name matches a standard size, but the dimensions don't.	*/
+	STANDARD_MATCH_SIZE					/**< The dimensions match a standard size with another name.	*/
+};
+
+/**
+ * The value used to indicate that there is no related standard size.
+ */
+
+#define STANDARD_NONE -1
+
+
+/**
+ * Classify a paper definition against the table of standard sizes, first
+ * by its name and then by its dimensions. Orientation is ignored.
+ *
+ * \param *name			The name of the paper.
+ * \param width			The width of the paper, in millipoints.
+ * \param height		The height of the paper, in millipoints.
+ * \param *standard		Pointer to a variable to take the index of the
+ *				related standard size, or STANDARD_NONE.
+ * \param *error		Pointer to a variable to take the largest
+ *				difference from the standard, in millipoints.
+ * \return			The relationship to the standard size.
+ */
+
+enum standard_match standard_classify(char *name, int width, int height, int *standard, int *error);
+
+
+/**
+ * Return the display name of a standard size.
+ *
+ * \param standard		The index of the standard size.
+ * \return			Pointer to the name, or "" if the index is invalid.
+ */
+
+char *standard_get_name(int standard);
+
+#endif
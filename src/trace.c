@@ -0,0 +1,165 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: trace.c
+ *
+ * Event trace buffer implementation.
+ *
+ * This is only linked in to builds made with TRACE=1.
+ */
+
+/* ANSI C header files */
+
+#include <stdio.h>
+
+/* OSLib header files */
+
+#include "oslib/os.h"
+#include "oslib/osfile.h"
+#include "oslib/types.h"
+
+/* Application header files */
+
+#include "trace.h"
+
+#ifdef TRACE
+
+/**
+ * The number of events held in the trace buffer. This must be a power
+ * of two, so that the index can wrap with a mask.
+ */
+
+#define TRACE_BUFFER_SIZE 1024
+
+/**
+ * A recorded event.
+ */
+
+struct trace_record {
+	os_t			time;				/**< The monotonic time of the event.				*/
+	enum trace_event	event;				/**< The event type.						*/
+	int			a;				/**< The first event parameter.					*/
+	int			b;				/**< The second event parameter.				*/
+};
+
+/**
+ * The trace buffer, which is allocated statically so that recording an
+ * event never needs to claim memory.
+ */
+
+static struct trace_record	trace_buffer[TRACE_BUFFER_SIZE];
+
+/**
+ * The total number of events recorded since the application started.
+ */
+
+static unsigned			trace_count = 0;
+
+/**
+ * The names of the events, as written to the dump file.
+ */
+
+static char			*trace_event_names[TRACE_EVENT_COUNT] = {
+	"Poll",
+	"Redraw",
+	"ParseStart",
+	"ParseEnd",
+	"VerifyStart",
+	"VerifyEnd",
+	"Flex",
+	"Rescan",
+	"FieldRejected"
+};
+
+
+/**
+ * Record an event in the trace buffer. This should be called via the
+ * TRACE_EVENT() macro, so that it disappears from untraced builds.
+ *
+ * \param event			The event to record.
+ * \param a			The first event parameter.
+ * \param b			The second event parameter.
+ */
+
+void trace_record(enum trace_event event, int a, int b)
+{
+	struct trace_record	*record;
+
+	record = trace_buffer + (trace_count++ & (TRACE_BUFFER_SIZE - 1));
+
+	record->time = os_read_monotonic_time();
+	record->event = event;
+	record->a = a;
+	record->b = b;
+}
+
+
+/**
+ * Write the contents of the trace buffer out to a text file, oldest
+ * event first.
+ *
+ * \param *filename		The name of the file to be written.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool trace_dump(char *filename)
+{
+	FILE			*out;
+	struct trace_record	*record;
+	unsigned		i, first;
+	os_t			start;
+	osbool			success;
+
+	out = fopen(filename, "w");
+	if (out == NULL)
+		return FALSE;
+
+	/* Once the buffer has wrapped, the oldest record is the one which
+	 * will be overwritten next.
+	 */
+
+	first = (trace_count > TRACE_BUFFER_SIZE) ? trace_count - TRACE_BUFFER_SIZE : 0;
+	start = trace_buffer[first & (TRACE_BUFFER_SIZE - 1)].time;
+
+	fprintf(out, "%u events recorded, %u shown\n\n", trace_count, trace_count - first);
+
+	for (i = first; i < trace_count; i++) {
+		record = trace_buffer + (i & (TRACE_BUFFER_SIZE - 1));
+
+		fprintf(out, "%8u %8u  %-12s %d %d\n", i, (unsigned) (record->time - start),
+				(record->event < TRACE_EVENT_COUNT) ? trace_event_names[record->event] : "?",
+				record->a, record->b);
+	}
+
+	success = (ferror(out) == 0) ? TRUE : FALSE;
+
+	if (fclose(out) != 0)
+		success = FALSE;
+
+	osfile_set_type(filename, osfile_TYPE_TEXT);
+
+	return success;
+}
+
+#endif
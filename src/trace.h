@@ -0,0 +1,99 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: trace.h
+ *
+ * Event trace buffer interface.
+ *
+ * The trace buffer is only built in if TRACE is defined at compile time
+ * (by building with TRACE=1); otherwise the TRACE_EVENT() macro compiles
+ * away to nothing, trace.o isn't linked and the other calls aren't
+ * available.
+ */
+
+#ifndef PS2PAPER_TRACE
+#define PS2PAPER_TRACE
+
+#include "oslib/types.h"
+
+/**
+ * The events which can be recorded in the trace buffer.
+ */
+
+enum trace_event {
+	TRACE_EVENT_POLL = 0,		/**< Wimp_Poll returned; a is the reason code.			*/
+	TRACE_EVENT_REDRAW,		/**< A redraw pass; a is the rectangles, b the lines plotted.	*/
+	TRACE_EVENT_PARSE_START,	/**< Parsing started; a is the number of roots.			*/
+	TRACE_EVENT_PARSE_END,		/**< Parsing ended; a is the number of definitions.		*/
+	TRACE_EVENT_VERIFY_START,	/**< Verification started; a is the number of definitions.	*/
+	TRACE_EVENT_VERIFY_END,		/**< Verification ended; a is the snippets checked.		*/
+	TRACE_EVENT_FLEX,		/**< A flex block was resized; a is the size, b non-zero if moved.	*/
+	TRACE_EVENT_RESCAN,		/**< A deferred rescan started; a is the requests merged.	*/
+	TRACE_EVENT_FIELD_REJECTED,	/**< A field couldn't be stored; a is the root, b the file.	*/
+	TRACE_EVENT_COUNT		/**< The number of trace events; must be last.			*/
+};
+
+#ifdef TRACE
+
+/**
+ * Record an event in the trace buffer.
+ *
+ * \param event			The event to record.
+ * \param a			The first event parameter.
+ * \param b			The second event parameter.
+ */
+
+#define TRACE_EVENT(event, a, b) trace_record((event), (int) (a), (int) (b))
+
+
+
+/**
+ * Record an event in the trace buffer. This should be called via the
+ * TRACE_EVENT() macro, so that it disappears from untraced builds.
+ *
+ * \param event			The event to record.
+ * \param a			The first event parameter.
+ * \param b			The second event parameter.
+ */
+
+void trace_record(enum trace_event event, int a, int b);
+
+
+/**
+ * Write the contents of the trace buffer out to a text file, oldest
+ * event first.
+ *
+ * \param *filename		The name of the file to be written.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool trace_dump(char *filename);
+
+#else
+
+#define TRACE_EVENT(event, a, b) do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,563 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: userdef.c
+ *
+ * User paper definition file editing implementation.
+ *
+ * Changes are made to the definitions file as a set of patches to byte
+ * ranges within the original contents. If the file is being written back
+ * to where it was read from, only the part of the file from the first patch
+ * onwards is written; if the length of the file doesn't change, only the
+ * bytes up to the end of the last patch are written. Otherwise the whole of
+ * the patched file is saved to its new location.
+ *
+ * An in-place write is read back to check it; if it fails, the file may
+ * have been left part-written, so the whole of the patched contents are
+ * saved over it instead. If that fails too, the original contents, which
+ * are still held in memory, are put back.
+ */
+
+/* ANSI C header files */
+
+#include <string.h>
+#include <stdlib.h>
+
+/* OSLib header files */
+
+#include "oslib/fileswitch.h"
+#include "oslib/osargs.h"
+#include "oslib/osfile.h"
+#include "oslib/osfind.h"
+#include "oslib/osfscontrol.h"
+#include "oslib/osgbpb.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/string.h"
+
+/* Application header files */
+
+#include "userdef.h"
+
+#include "paper.h"
+
+/**
+ * The maximum number of patches which can be applied to a file at once.
+ */
+
+#define USERDEF_MAX_PATCHES 2
+
+/**
+ * The length of the buffers used to hold canonical filenames.
+ */
+
+#define USERDEF_PATH_LEN 1024
+
+/**
+ * The length of the buffer used to hold the text of a patch.
+ */
+
+#define USERDEF_TEXT_LEN (PAPER_NAME_LEN + 64)
+
+/**
+ * A change to a range of bytes in a file.
+ */
+
+struct userdef_patch {
+	int			start;				/**< The offset of the first byte to be replaced.		*/
+	int			end;				/**< The offset after the last byte to be replaced.		*/
+	char			text[USERDEF_TEXT_LEN];		/**< The text to replace the bytes with.			*/
+};
+
+/**
+ * The location of a paper definition within a file.
+ */
+
+struct userdef_block {
+	int			start;				/**< The offset of the start of the pn: line.			*/
+	int			name_end;			/**< The offset after the end of the pn: line.			*/
+	int			end;				/**< The offset after the end of the block's last line.		*/
+	int			width_start;			/**< The offset of the pw: value, or -1.			*/
+	int			width_end;			/**< The offset after the pw: value.				*/
+	int			height_start;			/**< The offset of the ph: value, or -1.			*/
+	int			height_end;			/**< The offset after the ph: value.				*/
+};
+
+static char	*userdef_load(char *source, char *target, int *size, osbool *in_place);
+static osbool	userdef_find(char *data, int size, char *name, struct userdef_block *block);
+static int	userdef_split_line(char *data, int size, int line, int *key, int *key_length, int *value, int *value_length);
+static osbool	userdef_canonicalise(char *filename, char *buffer, int length);
+static osbool	userdef_write(char *target, osbool in_place, char *data, int size, struct userdef_patch *patches, int count);
+static osbool	userdef_patch_file(char *target, char *data, int start, int length, int size, int old_size);
+
+
+/**
+ * Set the size of a paper in a user definitions file. If the paper is
+ * already defined, its width and height values are replaced where they
+ * stand; if not, a new definition is added to the end of the file. The
+ * rest of the file, including any comments, is left untouched.
+ *
+ * \param *source		The name of the user definitions file to read.
+ * \param *target		The name of the user definitions file to write.
+ * \param *name			The name of the paper.
+ * \param width			The new width of the paper, in millipoints.
+ * \param height		The new height of the paper, in millipoints.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool userdef_set_size(char *source, char *target, char *name, int width, int height)
+{
+	struct userdef_block	block;
+	struct userdef_patch	patches[USERDEF_MAX_PATCHES], swap;
+	char			*data, *newline;
+	int			size, count;
+	osbool			in_place, success;
+
+	data = userdef_load(source, target, &size, &in_place);
+	if (data == NULL)
+		return FALSE;
+
+	newline = (size > 0 && data[size - 1] != '\n') ? "\n" : "";
+
+	if (userdef_find(data, size, name, &block)) {
+		/* Replace the existing values, or add new lines straight after
+		 * the name if there aren't any.
+		 */
+
+		if (block.width_start != -1) {
+			patches[0].start = block.width_start;
+			patches[0].end = block.width_end;
+			string_printf(patches[0].text, USERDEF_TEXT_LEN, "%d", width);
+		} else {
+			patches[0].start = block.name_end;
+			patches[0].end = block.name_end;
+			string_printf(patches[0].text, USERDEF_TEXT_LEN, "%spw: %d\n", (block.name_end == size) ? newline : "", width);
+		}
+
+		if (block.height_start != -1) {
+			patches[1].start = block.height_start;
+			patches[1].end = block.height_end;
+			string_printf(patches[1].text, USERDEF_TEXT_LEN, "%d", height);
+		} else {
+			patches[1].start = block.name_end;
+			patches[1].end = block.name_end;
+			string_printf(patches[1].text, USERDEF_TEXT_LEN, "ph: %d\n", height);
+		}
+
+		count = 2;
+
+		/* The patches must be applied in order through the file. */
+
+		if (patches[1].start < patches[0].start) {
+			swap = patches[0];
+			patches[0] = patches[1];
+			patches[1] = swap;
+		}
+	} else {
+		patches[0].start = size;
+		patches[0].end = size;
+		string_printf(patches[0].text, USERDEF_TEXT_LEN, "%spn: %s\npw: %d\nph: %d\n", newline, name, width, height);
+
+		count = 1;
+	}
+
+	success = userdef_write(target, in_place, data, size, patches, count);
+
+	free(data);
+
+	return success;
+}
+
+
+/**
+ * Remove the definition of a paper from a user definitions file, leaving
+ * the rest of the file untouched.
+ *
+ * \param *source		The name of the user definitions file to read.
+ * \param *target		The name of the user definitions file to write.
+ * \param *name			The name of the paper.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool userdef_delete(char *source, char *target, char *name)
+{
+	struct userdef_block	block;
+	struct userdef_patch	patch;
+	char			*data;
+	int			size;
+	osbool			in_place, success;
+
+	data = userdef_load(source, target, &size, &in_place);
+	if (data == NULL)
+		return FALSE;
+
+	if (!userdef_find(data, size, name, &block)) {
+		free(data);
+		return FALSE;
+	}
+
+	patch.start = block.start;
+	patch.end = block.end;
+	*patch.text = '\0';
+
+	success = userdef_write(target, in_place, data, size, &patch, 1);
+
+	free(data);
+
+	return success;
+}
+
+
+/**
+ * Load the contents of a user definitions file into memory, with a
+ * terminator after the last byte. If the file doesn't exist, an empty
+ * buffer is returned.
+ *
+ * \param *source		The name of the file to load, which may be on
+ *				a path.
+ * \param *target		The name of the file to be written back to.
+ * \param *size			Pointer to a variable to take the size of the file.
+ * \param *in_place		Pointer to a variable to take TRUE if the file
+ *				exists and is the same as the target; else FALSE.
+ * \return			Pointer to the file contents, to be freed by the
+ *				caller, or NULL on failure.
+ */
+
+static char *userdef_load(char *source, char *target, int *size, osbool *in_place)
+{
+	char			*data, source_path[USERDEF_PATH_LEN], target_path[USERDEF_PATH_LEN];
+	int			length;
+	osbool			exists;
+	os_error		*error;
+	fileswitch_object_type	type;
+
+	/* Resolve the source in the same way as the parser, so that the
+	 * definitions are read from the file which was loaded. If the path
+	 * can't be resolved, there is no file to read.
+	 */
+
+	if (userdef_canonicalise(source, source_path, USERDEF_PATH_LEN)) {
+		error = xosfile_read_stamped_no_path(source_path, &type, NULL, NULL, &length, NULL, NULL);
+		if (error != NULL || (type != fileswitch_IS_FILE && type != fileswitch_NOT_FOUND))
+			return NULL;
+	} else {
+		type = fileswitch_NOT_FOUND;
+	}
+
+	exists = (type == fileswitch_IS_FILE) ? TRUE : FALSE;
+
+	if (!exists)
+		length = 0;
+
+	/* The file can only be patched in place if the target is the same. */
+
+	*in_place = (exists && userdef_canonicalise(target, target_path, USERDEF_PATH_LEN) &&
+			string_nocase_strcmp(source_path, target_path) == 0) ? TRUE : FALSE;
+
+	data = malloc(length + 1);
+	if (data == NULL)
+		return NULL;
+
+	if (exists && xosfile_load_stamped_no_path(source_path, (byte *) data, NULL, NULL, NULL, NULL, NULL) != NULL) {
+		free(data);
+		return NULL;
+	}
+
+	data[length] = '\0';
+	*size = length;
+
+	return data;
+}
+
+
+/**
+ * Convert a filename into its canonical form, resolving any path variables
+ * or other system variables that it contains.
+ *
+ * \param *filename		The filename to convert.
+ * \param *buffer		Pointer to a buffer to take the canonical name.
+ * \param length		The length of the buffer.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool userdef_canonicalise(char *filename, char *buffer, int length)
+{
+	int	spare;
+
+	if (xosfscontrol_canonicalise_path(filename, buffer, NULL, NULL, length, &spare) != NULL || spare <= 0)
+		return FALSE;
+
+	return TRUE;
+}
+
+
+/**
+ * Find the first definition of a paper in the contents of a definitions
+ * file. The definition runs from its pn: line up to the last line with a
+ * key before the next pn: line, so that any comments ahead of the next
+ * definition are left with it.
+ *
+ * \param *data			The contents of the file.
+ * \param size			The size of the file.
+ * \param *name			The name of the paper to find.
+ * \param *block		Pointer to a block to take the location.
+ * \return			TRUE if the paper was found; else FALSE.
+ */
+
+static osbool userdef_find(char *data, int size, char *name, struct userdef_block *block)
+{
+	int	line, next, key, key_length, value, value_length;
+	osbool	found = FALSE;
+
+	for (line = 0; line < size; line = next) {
+		next = userdef_split_line(data, size, line, &key, &key_length, &value, &value_length);
+
+		if (key_length != 2)
+			continue;
+
+		if (strncmp(data + key, "pn", 2) == 0) {
+			if (found)
+				break;
+
+			if (value_length == strlen(name) && strncmp(data + value, name, value_length) == 0) {
+				found = TRUE;
+				block->start = line;
+				block->name_end = next;
+				block->end = next;
+				block->width_start = -1;
+				block->height_start = -1;
+			}
+
+			continue;
+		}
+
+		if (!found)
+			continue;
+
+		block->end = next;
+
+		if (strncmp(data + key, "pw", 2) == 0) {
+			block->width_start = value;
+			block->width_end = value + value_length;
+		} else if (strncmp(data + key, "ph", 2) == 0) {
+			block->height_start = value;
+			block->height_end = value + value_length;
+		}
+	}
+
+	return found;
+}
+
+
+/**
+ * Split a line from a definitions file into its key and value, ignoring
+ * any surrounding whitespace.
+ *
+ * \param *data			The contents of the file.
+ * \param size			The size of the file.
+ * \param line			The offset of the start of the line.
+ * \param *key			Pointer to a variable to take the key offset.
+ * \param *key_length		Pointer to a variable to take the key length,
+ *				which is zero if the line has no key.
+ * \param *value		Pointer to a variable to take the value offset.
+ * \param *value_length		Pointer to a variable to take the value length.
+ * \return			The offset of the start of the next line.
+ */
+
+static int userdef_split_line(char *data, int size, int line, int *key, int *key_length, int *value, int *value_length)
+{
+	int	end, next, colon;
+
+	for (end = line; end < size && data[end] != '\n'; end++);
+	next = (end < size) ? end + 1 : size;
+
+	*key_length = 0;
+	*value_length = 0;
+
+	while (line < end && (data[line] == ' ' || data[line] == '\t'))
+		line++;
+
+	if (line >= end || data[line] == '#')
+		return next;
+
+	for (colon = line; colon < end && data[colon] != ':'; colon++);
+	if (colon >= end)
+		return next;
+
+	*key = line;
+	for (*key_length = colon - line; *key_length > 0 && (data[line + *key_length - 1] == ' ' || data[line + *key_length - 1] == '\t'); (*key_length)--);
+
+	for (*value = colon + 1; *value < end && (data[*value] == ' ' || data[*value] == '\t'); (*value)++);
+	for (*value_length = end - *value; *value_length > 0 && (unsigned char) data[*value + *value_length - 1] <= ' '; (*value_length)--);
+
+	return next;
+}
+
+
+/**
+ * Apply a set of patches to the contents of a file, and write the changed
+ * part of the file back to disc.
+ *
+ * \param *target		The name of the file to write.
+ * \param in_place		TRUE if the contents were read from the target
+ *				file; FALSE to save the whole file afresh.
+ * \param *data			The original contents of the file.
+ * \param size			The original size of the file.
+ * \param *patches		The patches to apply, in order through the file.
+ * \param count			The number of patches.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool userdef_write(char *target, osbool in_place, char *data, int size, struct userdef_patch *patches, int count)
+{
+	char		*tail, *whole;
+	int		patch, first, new_size, used, position, length, write_length;
+	osbool		success;
+
+	if (count <= 0)
+		return TRUE;
+
+	/* Build the new contents of the file from the first patch onwards, or
+	 * from the start if the whole file is to be saved.
+	 */
+
+	first = (in_place) ? patches[0].start : 0;
+	new_size = size;
+
+	for (patch = 0; patch < count; patch++)
+		new_size += strlen(patches[patch].text) - (patches[patch].end - patches[patch].start);
+
+	tail = malloc(new_size - first + 1);
+	if (tail == NULL)
+		return FALSE;
+
+	used = 0;
+	position = first;
+
+	for (patch = 0; patch < count; patch++) {
+		memcpy(tail + used, data + position, patches[patch].start - position);
+		used += patches[patch].start - position;
+
+		length = strlen(patches[patch].text);
+		memcpy(tail + used, patches[patch].text, length);
+		used += length;
+
+		position = patches[patch].end;
+	}
+
+	/* If the length hasn't changed, nothing after the last patch moves. */
+
+	write_length = (new_size == size) ? used : new_size - first;
+
+	memcpy(tail + used, data + position, size - position);
+
+	/* A file in a new location is saved in full; otherwise, just the
+	 * changed bytes are written and the file is truncated if it has got
+	 * shorter.
+	 */
+
+	if (!in_place) {
+		success = (xosfile_save_stamped(target, osfile_TYPE_TEXT, (byte *) tail, (byte *) (tail + new_size)) == NULL) ? TRUE : FALSE;
+	} else {
+		success = userdef_patch_file(target, tail, first, write_length, new_size, size);
+
+		/* If the file couldn't be patched where it stands, save the whole
+		 * of the new contents over it; failing that, put the original
+		 * contents back.
+		 */
+
+		if (!success) {
+			whole = malloc(new_size + 1);
+
+			if (whole != NULL) {
+				memcpy(whole, data, first);
+				memcpy(whole + first, tail, new_size - first);
+
+				success = (xosfile_save_stamped(target, osfile_TYPE_TEXT, (byte *) whole, (byte *) (whole + new_size)) == NULL) ? TRUE : FALSE;
+
+				free(whole);
+			}
+
+			if (!success)
+				xosfile_save_stamped(target, osfile_TYPE_TEXT, (byte *) data, (byte *) (data + size));
+		}
+	}
+
+	free(tail);
+
+	return success;
+}
+
+
+/**
+ * Write a range of bytes into an existing file where it stands, truncating
+ * the file if it has got shorter, and then read the range back to check
+ * that it was written correctly.
+ *
+ * \param *target		The name of the file to patch.
+ * \param *data			The bytes to write.
+ * \param start			The offset into the file at which to write.
+ * \param length		The number of bytes to write.
+ * \param size			The new size of the file.
+ * \param old_size		The original size of the file.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool userdef_patch_file(char *target, char *data, int start, int length, int size, int old_size)
+{
+	char		*check;
+	int		remaining, extent;
+	os_fw		file;
+	os_error	*error;
+
+	check = malloc(length + 1);
+	if (check == NULL)
+		return FALSE;
+
+	error = xosfind_openupw(osfind_NO_PATH | osfind_ERROR_IF_ABSENT | osfind_ERROR_IF_DIR, target, NULL, &file);
+
+	if (error == NULL) {
+		error = xosgbpb_write_atw(file, (byte *) data, length, start, &remaining);
+
+		if (error == NULL && remaining == 0 && size < old_size)
+			error = xosargs_set_extw(file, size);
+
+		if (error == NULL && remaining == 0)
+			error = xosgbpb_read_atw(file, (byte *) check, length, start, &remaining);
+
+		if (error == NULL && remaining == 0)
+			error = xosargs_read_extw(file, &extent);
+
+		if (error == NULL && (remaining != 0 || extent != size || memcmp(check, data, length) != 0))
+			remaining = -1;
+
+		xosfind_closew(file);
+	}
+
+	free(check);
+
+	return (error == NULL && remaining == 0) ? TRUE : FALSE;
+}
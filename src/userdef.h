@@ -0,0 +1,69 @@
+/* Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of PS2Paper:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: userdef.h
+ *
+ * User paper definition file editing interface.
+ */
+
+#ifndef PS2PAPER_USERDEF
+#define PS2PAPER_USERDEF
+
+#include "oslib/types.h"
+
+
+/**
+ * Set the size of a paper in a user definitions file. If the paper is
+ * already defined, its width and height values are replaced where they
+ * stand; if not, a new definition is added to the end of the file. The
+ * rest of the file, including any comments, is left untouched.
+ *
+ * The file is read from the location that the definitions were loaded
+ * from, and written to the location where changes must be saved. If these
+ * are different, the whole of the updated file is saved to the new place.
+ *
+ * \param *source		The name of the user definitions file to read.
+ * \param *target		The name of the user definitions file to write.
+ * \param *name			The name of the paper.
+ * \param width			The new width of the paper, in millipoints.
+ * \param height		The new height of the paper, in millipoints.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool userdef_set_size(char *source, char *target, char *name, int width, int height);
+
+
+/**
+ * Remove the definition of a paper from a user definitions file, leaving
+ * the rest of the file untouched.
+ *
+ * \param *source		The name of the user definitions file to read.
+ * \param *target		The name of the user definitions file to write.
+ * \param *name			The name of the paper.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool userdef_delete(char *source, char *target, char *name);
+
+#endif
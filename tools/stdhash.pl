@@ -0,0 +1,110 @@
+#!/usr/bin/perl -w
+#
+# Copyright 2016-2020, Stephen Fryatt (info@stevefryatt.org.uk)
+#
+# This file is part of PS2Paper:
+#
+#   http://www.stevefryatt.org.uk/software/
+#
+# Licensed under the EUPL, Version 1.2 only (the "Licence");
+# You may not use this work except in compliance with the
+# Licence.
+#
+# You may obtain a copy of the Licence at:
+#
+#   http://joinup.ec.europa.eu/software/page/eupl
+#
+# Unless required by applicable law or agreed to in
+# writing, software distributed under the Licence is
+# distributed on an "AS IS" basis, WITHOUT WARRANTIES
+# OR CONDITIONS OF ANY KIND, either express or implied.
+#
+# See the Licence for the specific language governing
+# permissions and limitations under the Licence.
+
+# Generate the perfect hash table for the standard paper sizes.
+#
+# Usage: stdhash.pl [<path to standard.c>]
+#
+# The normalised keys are read, in order, from the standard_sizes[] table
+# in standard.c, and the lowest seed which gives every key its own slot is
+# found using the same hash as standard_hash(). The STANDARD_HASH_SEED value
+# and the standard_hash_table[] initialiser are written to stdout, ready to
+# be pasted back into standard.c.
+
+use strict;
+
+my $source = shift || "src/standard.c";
+
+# The table size must match STANDARD_HASH_SIZE.
+
+my $size = 256;
+my $max_seed = 1000000;
+
+# Read the keys from the standard sizes table.
+
+open(my $in, "<", $source) or die "Can't open $source: $!\n";
+
+my @keys;
+my $in_table = 0;
+
+while (my $line = <$in>) {
+	$in_table = 1 if ($line =~ /^static struct standard_size standard_sizes\[\]/);
+	next if (!$in_table);
+	last if ($line =~ /^\};/);
+
+	push(@keys, $1) if ($line =~ /^\s*\{"[^"]*",\s*"([^"]*)"/);
+}
+
+close($in);
+
+die "No keys found in $source\n" if (scalar(@keys) == 0);
+die "Too many keys for a table of $size\n" if (scalar(@keys) > $size);
+
+# Find the first seed which gives a collision-free table.
+
+for (my $seed = 0; $seed < $max_seed; $seed++) {
+	my @table = (-1) x $size;
+	my $clash = 0;
+
+	for (my $index = 0; $index < scalar(@keys); $index++) {
+		my $slot = hash($seed, $keys[$index]) & ($size - 1);
+
+		if ($table[$slot] != -1) {
+			$clash = 1;
+			last;
+		}
+
+		$table[$slot] = $index;
+	}
+
+	next if ($clash);
+
+	print "#define STANDARD_HASH_SEED $seed\n\n";
+	print "static signed char standard_hash_table[STANDARD_HASH_SIZE] = {\n";
+
+	for (my $row = 0; $row < $size; $row += 16) {
+		print "\t" . join(", ", @table[$row .. $row + 15]) . (($row + 16 < $size) ? ",\n" : "\n");
+	}
+
+	print "};\n";
+
+	exit 0;
+}
+
+die "No seed found below $max_seed; try a larger table.\n";
+
+# Calculate the hash of a key, exactly as standard_hash() does with 32-bit
+# unsigned arithmetic.
+
+sub hash {
+	my ($seed, $key) = @_;
+
+	my $hash = $seed;
+
+	foreach my $char (split(//, $key)) {
+		$hash = ((($hash * 33) & 0xffffffff) ^ ord($char)) & 0xffffffff;
+	}
+
+	return ($hash ^ ($hash >> 15)) & 0xffffffff;
+}